@@ -88,6 +88,28 @@ char *fatGetDefaultCwd(void);
 ///     Returns a string with the path.
 const char *fatGetDefaultDrive(void);
 
+/// Formats a FAT drive, erasing all its contents.
+///
+/// The data area of the new filesystem is aligned to the allocation unit (erase
+/// block) size reported by the device, and the size of the clusters is picked
+/// so that it divides that alignment.
+///
+/// All files and directories of the drive must be closed before calling this
+/// function. If any of them is still open, the drive isn't formatted and errno
+/// is set to EBUSY.
+///
+/// Only the internal SD card of the DSi can be formatted at the moment. DLDI
+/// drivers have no way to report the size of the device.
+///
+/// On error, this function sets errno to an error code.
+///
+/// @param drive
+///     The drive to format ("sd:/" or "fat:/").
+///
+/// @return
+///     0 on success, -1 on error.
+int fatFormat(const char *drive);
+
 /// This function initializes a lookup cache on a given FAT file.
 /// For NitroFS, use @see nitrofsInitLookupCache instead.
 ///
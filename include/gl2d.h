@@ -101,8 +101,49 @@ void glBegin2D(void);
 /// Issue this after drawing 2d so that we don't mess the matrix stack.
 ///
 /// The compliment of glBegin2D().
+///
+/// If batch mode is active, all pending quads are drawn.
 void glEnd2D(void);
 
+/// Flag of glBatchBegin2D() that groups quads by texture before drawing them.
+///
+/// Quads that use the same texture are drawn in the order they were added, but
+/// quads with different textures may be reordered. Each quad keeps the depth
+/// that it would have in immediate mode, so opaque quads are still layered in
+/// the right order. Overlapping translucent quads with different textures may
+/// be blended in a different order.
+#define GL2D_BATCH_SORT     BIT(0)
+
+/// Enables batch mode.
+///
+/// In batch mode glSprite(), glSpriteOnQuad(), glBoxFilled() and
+/// glBoxFilledGradient() don't send commands to the GPU right away. The quads
+/// are stored in a buffer, and they are sent as one packed display list with
+/// DMA when the buffer is full, when glBatchFlush2D() or glEnd2D() are called,
+/// or before any other GL2D drawing function. The texture is only changed
+/// when it is different from the texture of the previous quad.
+///
+/// The color and polygon format used by batched sprites are the ones active
+/// when the batch is flushed. Call glBatchFlush2D() before calling glColor()
+/// or glPolyFmt() between sprites.
+///
+/// Batch mode stays active until glBatchEnd2D() is called.
+///
+/// @param max_quads
+///     Maximum number of quads stored before flushing the batch.
+/// @param flags
+///     0 to keep the order of the calls, or GL2D_BATCH_SORT.
+///
+/// @return
+///     It returns true on success, false if there isn't enough memory.
+bool glBatchBegin2D(int max_quads, u32 flags);
+
+/// Draws all the quads stored in the batch buffer.
+void glBatchFlush2D(void);
+
+/// Draws all pending quads, disables batch mode and frees its buffers.
+void glBatchEnd2D(void);
+
 /// Returns the active texture. Use with care.
 ///
 /// Needed to achieve some effects since libnds 1.5.0.
@@ -24,6 +24,10 @@
 /// @section video_3D_api 3D engine API
 /// - @ref nds/arm9/videoGL.h "OpenGL (ish)"
 /// - @ref nds/arm9/boxtest.h "Box Test"
+/// - @ref nds/arm9/displaylist.h "Display list recorder"
+/// - @ref nds/arm9/mesh.h "Mesh loader"
+/// - @ref nds/arm9/meshcull.h "Mesh culling"
+/// - @ref nds/arm9/multipass.h "Multipass 3D rendering"
 /// - @ref nds/arm9/postest.h "Position test"
 /// - @ref gl2d.h "Simple DS 2D rendering using the 3D core"
 ///
@@ -59,6 +63,8 @@
 ///
 /// @section multithreading_api Multithreading
 /// - @ref nds/cothread.h "Cooperative multithreading"
+/// - @ref nds/cojob.h "Job system"
+/// - @ref nds/arm7task.h "Running tasks on the ARM7"
 ///
 /// @section user_io_api User Input/ouput
 /// - @ref nds/arm9/input.h "Keypad and touch pad"
@@ -128,9 +134,11 @@
 extern "C" {
 #endif
 
+#include <nds/arm7task.h>
 #include <nds/bios.h>
 #include <nds/camera.h>
 #include <nds/card.h>
+#include <nds/cojob.h>
 #include <nds/cothread.h>
 #include <nds/cpu.h>
 #include <nds/debug.h>
@@ -158,6 +166,7 @@ extern "C" {
 #    include <nds/arm9/cache.h>
 #    include <nds/arm9/camera.h>
 #    include <nds/arm9/console.h>
+#    include <nds/arm9/displaylist.h>
 #    include <nds/arm9/dynamicArray.h>
 #    include <nds/arm9/guitarGrip.h>
 #    include <nds/arm9/image.h>
@@ -165,6 +174,9 @@ extern "C" {
 #    include <nds/arm9/keyboard.h>
 #    include <nds/arm9/linkedlist.h>
 #    include <nds/arm9/math.h>
+#    include <nds/arm9/mesh.h>
+#    include <nds/arm9/meshcull.h>
+#    include <nds/arm9/multipass.h>
 #    include <nds/arm9/ndsmotion.h>
 #    include <nds/arm9/paddle.h>
 #    include <nds/arm9/grf.h>
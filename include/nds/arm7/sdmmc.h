@@ -48,7 +48,8 @@ enum
     SDMMC_ERR_SET_BLOCKLEN     = 24u, // SET_BLOCKLEN CMD error.
     SDMMC_ERR_LOCK_UNLOCK      = 25u, // LOCK_UNLOCK CMD error.
     SDMMC_ERR_LOCK_UNLOCK_FAIL = 26u, // Lock/unlock operation failed (R1 status).
-    SDMMC_ERR_SLEEP_AWAKE      = 27u  // (e)MMC SLEEP_AWAKE CMD error.
+    SDMMC_ERR_SLEEP_AWAKE      = 27u, // (e)MMC SLEEP_AWAKE CMD error.
+    SDMMC_ERR_ERASE            = 28u  // ERASE_WR_BLK_START/END or ERASE CMD error.
 };
 
 // (e)MMC/SD device numbers.
@@ -219,6 +220,19 @@ u8 SDMMC_getDiskStatus(const u8 devNum);
 ///     Returns the number of sectors or 0 on failure.
 u32 SDMMC_getSectors(const u8 devNum);
 
+/// Returns the erase block size of a (e)MMC/SD card device.
+///
+/// For SD cards this is the allocation unit (AU) size read from the SD status.
+/// Writes that are aligned to it and cover whole blocks are the fastest ones.
+///
+/// @param devNum
+///     The device.
+///
+/// @return
+///     Returns the size in 512 byte units, 1 if it isn't known (like for (e)MMC
+///     devices) or 0 on failure.
+u32 SDMMC_getEraseBlockSize(const u8 devNum);
+
 /// Reads one or more sectors from a (e)MMC/SD card device.
 ///
 /// @param devNum
@@ -252,6 +266,24 @@ u32 SDMMC_readSectors(const u8 devNum, u32 sect, void *const buf, const u16 coun
 u32 SDMMC_writeSectors(const u8 devNum, u32 sect, const void *const buf,
                        const u16 count);
 
+/// Erases one or more sectors of a SD card device.
+///
+/// This lets the card know that the sectors don't hold valid data anymore.
+/// (e)MMC devices aren't supported because they erase whole erase groups, which
+/// may be bigger than the requested range.
+///
+/// @param devNum
+///     The device.
+/// @param sect
+///     The start sector.
+/// @param count
+///     The number of sectors to erase.
+///
+/// @return
+///     Returns SDMMC_ERR_NONE on success or one of the errors listed above on
+///     failure.
+u32 SDMMC_eraseSectors(const u8 devNum, u32 sect, const u32 count);
+
 /// Sends a custom command to a (e)MMC/SD card device.
 ///
 /// @param devNum
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef LIBNDS_NDS_ARM7TASK_H__
+#define LIBNDS_NDS_ARM7TASK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @file nds/arm7task.h
+///
+/// @brief Run functions of the ARM7 binary from the ARM9
+///
+/// The ARM7 registers functions with arm7TaskRegister(), and the ARM9 calls
+/// them with arm7TaskCallAsync() or arm7TaskCall(). Arguments are passed in a
+/// buffer in main RAM, and the 32-bit result is sent back to the ARM9 over the
+/// FIFO system.
+///
+/// Tasks run in the FIFO interrupt handler of the ARM7 with the FIFO interrupts
+/// disabled, like storage requests. Other interrupts (like VBlank or sound
+/// timers) can still happen while a task runs. Tasks should be reasonably
+/// short and avoid using a lot of stack, as they use the IRQ stack, and other
+/// FIFO messages (like storage accesses) are delayed until they end.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <nds/ndstypes.h>
+
+/// Maximum number of tasks that can be registered in the ARM7.
+#define ARM7_TASK_MAX       16
+
+/// Maximum number of tasks that the ARM9 can have in progress at a time.
+#define ARM7_TASK_PENDING   16
+
+#ifdef ARM7
+
+/// Function run by a task.
+///
+/// @param args
+///     Pointer to the arguments buffer passed by the ARM9.
+/// @param size
+///     Size of the arguments buffer.
+///
+/// @return
+///     Result of the task, it is sent to the ARM9.
+typedef u32 (*Arm7TaskFn)(void *args, size_t size);
+
+/// Registers a function that the ARM9 can run.
+///
+/// @param id
+///     ID of the task (0 to ARM7_TASK_MAX - 1).
+/// @param fn
+///     Function to register, or NULL to unregister the task.
+///
+/// @return
+///     It returns true on success, false if the ID is out of range.
+bool arm7TaskRegister(u32 id, Arm7TaskFn fn);
+
+#endif // ARM7
+
+#ifdef ARM9
+
+/// Asks the ARM7 to run a task, without waiting for it to end.
+///
+/// The arguments buffer is flushed from the data cache before sending the
+/// request, and it's invalidated by arm7TaskWait(). The ARM9 must not access
+/// the buffer until arm7TaskWait() returns. If the buffer contains pointers to
+/// other buffers, they must be flushed or invalidated by the caller.
+///
+/// The address and size of the buffer must be multiples of the cache line size
+/// (32 bytes, use ALIGN(32)). If the buffer shared a cache line with other data,
+/// using that data from the ARM9 while the task runs could overwrite the
+/// results of the ARM7 or make the ARM9 read old values.
+///
+/// @param id
+///     ID of the task (0 to ARM7_TASK_MAX - 1).
+/// @param args
+///     Pointer to the arguments buffer, in main RAM. It can be NULL.
+/// @param size
+///     Size of the arguments buffer.
+///
+/// @return
+///     On success, it returns a ticket to be used with arm7TaskIsDone() and
+///     arm7TaskWait(). If the ID is out of range or there are too many tasks in
+///     progress, it returns -1.
+int arm7TaskCallAsync(u32 id, void *args, size_t size);
+
+/// Checks if a task has ended.
+///
+/// @param ticket
+///     Ticket returned by arm7TaskCallAsync().
+///
+/// @return
+///     It returns true if the task has ended, false otherwise.
+bool arm7TaskIsDone(int ticket);
+
+/// Waits for a task to end and releases its ticket.
+///
+/// Other threads keep running while the current thread waits.
+///
+/// @param ticket
+///     Ticket returned by arm7TaskCallAsync().
+/// @param result
+///     Pointer where the result of the task is stored. It can be NULL.
+///
+/// @return
+///     It returns 0 on success, -1 if the task isn't registered in the ARM7.
+int arm7TaskWait(int ticket, u32 *result);
+
+/// Asks the ARM7 to run a task and waits for it to end.
+///
+/// The requirements of the arguments buffer are the same as in
+/// arm7TaskCallAsync().
+///
+/// @param id
+///     ID of the task (0 to ARM7_TASK_MAX - 1).
+/// @param args
+///     Pointer to the arguments buffer, in main RAM. It can be NULL.
+/// @param size
+///     Size of the arguments buffer.
+/// @param result
+///     Pointer where the result of the task is stored. It can be NULL.
+///
+/// @return
+///     It returns 0 on success, -1 on error.
+int arm7TaskCall(u32 id, void *args, size_t size, u32 *result);
+
+#endif // ARM9
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_ARM7TASK_H__
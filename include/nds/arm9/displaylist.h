@@ -0,0 +1,410 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef LIBNDS_NDS_ARM9_DISPLAYLIST_H__
+#define LIBNDS_NDS_ARM9_DISPLAYLIST_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @file nds/arm9/displaylist.h
+///
+/// @brief Recorder of packed display lists.
+///
+/// The functions of videoGL write each command to its own register, which
+/// needs one bus write for the command and one for each parameter. This
+/// recorder captures the same commands in a buffer in RAM using the packed
+/// format of the geometry engine (up to 4 commands per header word). The result
+/// can be sent to the GPU with glCallList(), and it can be sent again every
+/// frame without recording it again.
+///
+/// Example:
+///
+/// ```
+/// static u32 buffer[256];
+/// GLDisplayList list;
+///
+/// glListInit(&list, buffer, sizeof(buffer));
+/// glListBegin(&list, GL_TRIANGLES);
+/// glListColor(&list, RGB15(31, 0, 0));
+/// glListVertex3v16(&list, inttov16(-1), inttov16(-1), 0);
+/// glListVertex3v16(&list, inttov16(1), inttov16(-1), 0);
+/// glListVertex3v16(&list, inttov16(0), inttov16(1), 0);
+/// glListEnd(&list);
+///
+/// const void *dl = glListFinish(&list);
+/// if (dl != NULL)
+///     glCallList(dl);
+/// ```
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <nds/arm9/video.h>
+#include <nds/arm9/videoGL.h>
+#include <nds/ndstypes.h>
+
+/// State of a display list being recorded.
+typedef struct
+{
+    /// Buffer of the list. The first word holds the number of words of the
+    /// list after it, as expected by glCallList().
+    u32 *data;
+    u32 capacity; ///< Size of the buffer in words
+    u32 size; ///< Number of words used, including the size word
+    u32 header; ///< Index of the current command header word
+    u32 commands; ///< Number of commands in the current header word (0 to 4)
+    bool overflow; ///< Set if a command didn't fit in the buffer
+} GLDisplayList;
+
+/// Callback used by glListDecode() for each command of a list.
+///
+/// @param command
+///     Command ID (like FIFO_VERTEX16).
+/// @param params
+///     Parameters of the command.
+/// @param num_params
+///     Number of parameters.
+/// @param userdata
+///     Value passed to glListDecode().
+typedef void (*GLListDecodeFn)(u8 command, const u32 *params, u32 num_params,
+                               void *userdata);
+
+/// Initializes a display list using the provided buffer.
+///
+/// @param list
+///     Display list to initialize.
+/// @param buffer
+///     Buffer for the commands. It must be aligned to 4 bytes.
+/// @param size
+///     Size of the buffer in bytes.
+///
+/// @return
+///     It returns true on success, false if the buffer is too small.
+bool glListInit(GLDisplayList *list, u32 *buffer, size_t size);
+
+/// Removes all commands from a display list so that it can be recorded again.
+///
+/// @param list
+///     Display list.
+void glListReset(GLDisplayList *list);
+
+/// Adds a command to a display list.
+///
+/// @param list
+///     Display list.
+/// @param command
+///     Command ID (like FIFO_VERTEX16).
+/// @param params
+///     Parameters of the command.
+/// @param num_params
+///     Number of parameters. It must match the number of parameters that the
+///     command takes, see glListCommandParams().
+///
+/// @return
+///     It returns true on success, false if there isn't enough space left.
+bool glListCommand(GLDisplayList *list, u8 command, const u32 *params,
+                   u32 num_params);
+
+/// Finishes a display list and returns a pointer that can be passed to
+/// glCallList().
+///
+/// More commands can be added after calling this function, but it has to be
+/// called again before sending the list to the GPU.
+///
+/// @param list
+///     Display list.
+///
+/// @return
+///     Pointer to the list, or NULL if any command didn't fit in the buffer.
+const void *glListFinish(GLDisplayList *list);
+
+/// Returns the number of parameters that a command takes.
+///
+/// @param command
+///     Command ID (like FIFO_VERTEX16).
+///
+/// @return
+///     Number of parameters, or -1 if the command isn't valid.
+int glListCommandParams(u8 command);
+
+/// Decodes a packed display list and calls a function for each command.
+///
+/// This doesn't access any hardware register, so it can be used to inspect
+/// lists or to test code that generates them.
+///
+/// @param list
+///     Display list in the format used by glCallList().
+/// @param callback
+///     Function called for each command. NOP commands are skipped.
+/// @param userdata
+///     Value passed to the callback.
+///
+/// @return
+///     Number of commands decoded, or -1 if the list is malformed.
+int glListDecode(const void *list, GLListDecodeFn callback, void *userdata);
+
+/// Maximum number of display lists that can be queued with glCallListAsync().
+#define GL_LIST_QUEUE_SIZE  16
+
+/// Callback called when a display list sent with glCallListAsync() has been
+/// copied to the geometry FIFO.
+///
+/// The DMA interrupt handler defers it with cothread_defer(), so it runs from
+/// the scheduler before the next thread is resumed. It can wake up threads, but
+/// it must not block (see cothread_defer()). If the queue of deferred work is
+/// full, it is called from the interrupt handler instead.
+///
+/// @param list
+///     Display list that has been sent.
+/// @param userdata
+///     Value passed to glCallListAsync().
+typedef void (*GLListDoneFn)(const void *list, void *userdata);
+
+/// Two display lists used alternately.
+///
+/// The CPU records commands in one list while the other one is being sent to
+/// the GPU.
+typedef struct
+{
+    GLDisplayList lists[2]; ///< The two display lists
+    u32 fences[2]; ///< Fence of the last submission of each list
+    int current; ///< Index of the list being recorded
+} GLDisplayListPair;
+
+/// Sends a display list to the geometry FIFO without waiting for it to end.
+///
+/// The list is added to a queue, and lists are sent one after the other with
+/// DMA channel 0. The DMA interrupt is used to start the next list, so the CPU
+/// is free while the GPU consumes the commands.
+///
+/// The buffer of the list must not be modified until its fence has been
+/// reached. Also, no other geometry commands (including glFlush()) can be sent
+/// until the queue is idle, as they would be mixed with the commands of the
+/// list. Use glListQueueWaitIdle() before that. glCallList() waits for the
+/// queue to be idle.
+///
+/// Other DMA channels must not be used while the queue is busy, for the same
+/// reason that glCallList() waits for them to be idle. If another channel is
+/// active when a list ends, the interrupt handler doesn't wait for it. The next
+/// list is started by the next call to glCallListAsync(), glListFenceWait() or
+/// glListQueueWaitIdle() instead, so the queue can stall until then.
+///
+/// The queue uses the DMA 0 interrupt. When the queue starts after being idle,
+/// this function sets the handler of IRQ_DMA0 with irqSet() and enables the
+/// interrupt, replacing any handler set by the application. If the handler is
+/// replaced while the queue is busy, fences are never reached and
+/// glListQueueWaitIdle() never returns. The DMA 0 interrupt can only be used by
+/// the application while the queue is idle.
+///
+/// @param list
+///     Display list in the format used by glCallList().
+/// @param callback
+///     Function called when the list has been sent. It can be NULL.
+/// @param userdata
+///     Value passed to the callback.
+///
+/// @return
+///     A fence to be used with glListFenceDone() and glListFenceWait(). On
+///     error (the queue is full or the list is empty) it returns 0. Entries of
+///     the queue are released after their callback has run, so yield before
+///     trying again if the queue is full.
+u32 glCallListAsync(const void *list, GLListDoneFn callback, void *userdata);
+
+/// Checks if a display list sent with glCallListAsync() has been sent.
+///
+/// @param fence
+///     Fence returned by glCallListAsync().
+///
+/// @return
+///     It returns true if the list has been sent to the GPU.
+bool glListFenceDone(u32 fence);
+
+/// Waits until a display list sent with glCallListAsync() has been sent.
+///
+/// Other threads keep running while the current thread waits.
+///
+/// @param fence
+///     Fence returned by glCallListAsync().
+void glListFenceWait(u32 fence);
+
+/// Checks if all display lists sent with glCallListAsync() have been sent.
+///
+/// @return
+///     It returns true if the queue is empty.
+bool glListQueueIdle(void);
+
+/// Waits until all display lists sent with glCallListAsync() have been sent.
+void glListQueueWaitIdle(void);
+
+/// Initializes a pair of display lists.
+///
+/// @param pair
+///     Pair to initialize.
+/// @param buffer0
+///     Buffer of the first list.
+/// @param buffer1
+///     Buffer of the second list.
+/// @param size
+///     Size of each buffer in bytes.
+///
+/// @return
+///     It returns true on success, false if the buffers are too small.
+bool glListPairInit(GLDisplayListPair *pair, u32 *buffer0, u32 *buffer1,
+                    size_t size);
+
+/// Returns the list of a pair that has to be recorded next.
+///
+/// If the list is still being sent to the GPU this function waits for it to
+/// end. The list is reset before returning it.
+///
+/// @param pair
+///     Pair of lists.
+///
+/// @return
+///     Display list to record commands in.
+GLDisplayList *glListPairBegin(GLDisplayListPair *pair);
+
+/// Sends the list returned by glListPairBegin() with glCallListAsync() and
+/// switches to the other list of the pair.
+///
+/// @param pair
+///     Pair of lists.
+/// @param callback
+///     Function called when the list has been sent. It can be NULL.
+/// @param userdata
+///     Value passed to the callback.
+///
+/// @return
+///     The fence returned by glCallListAsync(), or 0 on error.
+u32 glListPairSubmit(GLDisplayListPair *pair, GLListDoneFn callback,
+                     void *userdata);
+
+/// Adds a command without parameters to a display list.
+static inline bool glListCommand0(GLDisplayList *list, u8 command)
+{
+    return glListCommand(list, command, NULL, 0);
+}
+
+/// Adds a command with one parameter to a display list.
+static inline bool glListCommand1(GLDisplayList *list, u8 command, u32 param)
+{
+    return glListCommand(list, command, &param, 1);
+}
+
+/// Display list version of glBegin().
+static inline void glListBegin(GLDisplayList *list, GL_GLBEGIN_ENUM mode)
+{
+    glListCommand1(list, FIFO_BEGIN, mode);
+}
+
+/// Display list version of glEnd().
+static inline void glListEnd(GLDisplayList *list)
+{
+    glListCommand0(list, FIFO_END);
+}
+
+/// Display list version of glColor().
+static inline void glListColor(GLDisplayList *list, rgb color)
+{
+    glListCommand1(list, FIFO_COLOR, color);
+}
+
+/// Display list version of glNormal().
+static inline void glListNormal(GLDisplayList *list, u32 normal)
+{
+    glListCommand1(list, FIFO_NORMAL, normal);
+}
+
+/// Display list version of glTexCoord2t16().
+static inline void glListTexCoord2t16(GLDisplayList *list, t16 u, t16 v)
+{
+    glListCommand1(list, FIFO_TEX_COORD, TEXTURE_PACK(u, v));
+}
+
+/// Display list version of glVertex3v16().
+static inline void glListVertex3v16(GLDisplayList *list, v16 x, v16 y, v16 z)
+{
+    u32 params[2] = { ((u32)(u16)y << 16) | (x & 0xFFFF), (u16)z };
+    glListCommand(list, FIFO_VERTEX16, params, 2);
+}
+
+/// Display list version of glVertex3v10().
+static inline void glListVertex3v10(GLDisplayList *list, v10 x, v10 y, v10 z)
+{
+    glListCommand1(list, FIFO_VERTEX10, NORMAL_PACK(x, y, z));
+}
+
+/// Display list version of glVertex2v16().
+static inline void glListVertex2v16(GLDisplayList *list, v16 x, v16 y)
+{
+    glListCommand1(list, FIFO_VERTEX_XY, ((u32)(u16)y << 16) | (x & 0xFFFF));
+}
+
+/// Display list version of glPolyFmt().
+static inline void glListPolyFmt(GLDisplayList *list, u32 params)
+{
+    glListCommand1(list, FIFO_POLY_FORMAT, params);
+}
+
+/// Adds a command to set the texture format to a display list.
+///
+/// @param list
+///     Display list.
+/// @param format
+///     Value of the GFX_TEX_FORMAT register.
+static inline void glListTexFormat(GLDisplayList *list, u32 format)
+{
+    glListCommand1(list, FIFO_TEX_FORMAT, format);
+}
+
+/// Adds a command to set the palette base address to a display list.
+///
+/// @param list
+///     Display list.
+/// @param format
+///     Value of the GFX_PAL_FORMAT register.
+static inline void glListPalFormat(GLDisplayList *list, u32 format)
+{
+    glListCommand1(list, FIFO_PAL_FORMAT, format);
+}
+
+/// Display list version of glPushMatrix().
+static inline void glListPushMatrix(GLDisplayList *list)
+{
+    glListCommand0(list, REG2ID(MATRIX_PUSH));
+}
+
+/// Display list version of glPopMatrix().
+static inline void glListPopMatrix(GLDisplayList *list, int num)
+{
+    glListCommand1(list, REG2ID(MATRIX_POP), num);
+}
+
+/// Display list version of glLoadIdentity().
+static inline void glListLoadIdentity(GLDisplayList *list)
+{
+    glListCommand0(list, REG2ID(MATRIX_IDENTITY));
+}
+
+/// Display list version of glTranslatef32().
+static inline void glListTranslatef32(GLDisplayList *list, int x, int y, int z)
+{
+    u32 params[3] = { x, y, z };
+    glListCommand(list, REG2ID(MATRIX_TRANSLATE), params, 3);
+}
+
+/// Display list version of glScalef32().
+static inline void glListScalef32(GLDisplayList *list, int x, int y, int z)
+{
+    u32 params[3] = { x, y, z };
+    glListCommand(list, REG2ID(MATRIX_SCALE), params, 3);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_ARM9_DISPLAYLIST_H__
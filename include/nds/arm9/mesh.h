@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef LIBNDS_NDS_ARM9_MESH_H__
+#define LIBNDS_NDS_ARM9_MESH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @file nds/arm9/mesh.h
+///
+/// @brief Loader of meshes stored as packed display lists.
+///
+/// Meshes are stored in a RIFF container that holds display lists ready to be
+/// sent to the GPU. Positions, normals and texture coordinates are already
+/// quantized and packed as geometry commands, so the loader doesn't need to
+/// parse vertices: the lists are read directly into the buffer that is sent
+/// with glCallList(). The textures of the mesh are loaded with glTexImage2D()
+/// and glColorTableEXT().
+///
+/// File structure (all values are little endian, all chunk sizes must be
+/// multiples of 4 bytes):
+///
+/// ```
+/// "RIFF" # {
+///     "NMSH" # {
+///         "HDRX" # { GLMeshHeader }
+///         "TEX " # { GLMeshTextureInfo, texture data, palette } (one per texture)
+///         "MTRL" # { GLMeshMaterialInfo[num_materials] }
+///         "DLST" # { display lists }
+///     }
+/// }
+/// ```
+///
+/// "HDRX" must be the first chunk. Each material has one display list in the
+/// format used by glCallList(): the number of words of the list followed by
+/// the packed commands. All lists are stored one after the other in "DLST",
+/// and each material has the offset of its list inside the chunk.
+///
+/// Example:
+///
+/// ```
+/// GLMesh mesh;
+///
+/// if (glMeshLoadFile("nitro:/models/ship.bin", &mesh) == GL_MESH_NO_ERROR)
+/// {
+///     glMeshDraw(&mesh);
+///     glMeshFree(&mesh);
+/// }
+/// ```
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <nds/arm9/videoGL.h>
+#include <nds/ndstypes.h>
+
+/// Version of the mesh format supported by this loader.
+#define GL_MESH_VERSION 1
+
+/// Possible errors of the mesh loader.
+typedef enum
+{
+    GL_MESH_NO_ERROR            = 0,  ///< No error happened
+    GL_MESH_NULL_POINTER        = -1, ///< NULL pointer passed as argument
+    GL_MESH_FILE_NOT_OPENED     = -2, ///< Failed to open file with fopen()
+    GL_MESH_FILE_NOT_READ       = -3, ///< Failed to read file
+    GL_MESH_FILE_NOT_CLOSED     = -4, ///< Failed to close file with fclose()
+    GL_MESH_INVALID_FORMAT      = -5, ///< The file isn't a valid mesh
+    GL_MESH_INVALID_VERSION     = -6, ///< Unsupported version of the format
+    GL_MESH_NOT_ENOUGH_MEMORY   = -7, ///< Not enough memory for malloc()
+    GL_MESH_TEXTURE_FAILED      = -8, ///< Failed to load a texture to VRAM
+} GLMeshError;
+
+/// Header of a mesh ("HDRX" chunk).
+typedef struct
+{
+    u16 version; ///< GL_MESH_VERSION
+    u16 num_materials; ///< Number of materials (and display lists)
+    u16 num_textures; ///< Number of "TEX " chunks
+    u16 flags; ///< Reserved, must be 0
+    v16 bounds[6]; ///< Bounding box (x, y, z, width, height, depth)
+} GLMeshHeader;
+
+/// Information of a texture ("TEX " chunk).
+///
+/// It is followed by the texture data and the palette. The size of the data
+/// must match the format and size of the texture. GL_COMPRESSED textures are
+/// followed by their extra data (half the size of the texel data).
+typedef struct
+{
+    u8 type; ///< Format (GL_TEXTURE_TYPE_ENUM)
+    u8 size_x; ///< Width (TEXTURE_SIZE_ENUM)
+    u8 size_y; ///< Height (TEXTURE_SIZE_ENUM)
+    u8 reserved; ///< Reserved, must be 0
+    u32 param; ///< Parameters passed to glTexImage2D()
+    u32 data_size; ///< Size of the texture data in bytes
+    u16 num_colors; ///< Number of colors of the palette (0 if there isn't one)
+    u16 reserved2; ///< Reserved, must be 0
+} GLMeshTextureInfo;
+
+/// Information of a material ("MTRL" chunk).
+typedef struct
+{
+    u32 poly_fmt; ///< Polygon format passed to glPolyFmt()
+    s16 texture; ///< Index of the texture in the file (-1 if not textured)
+    u16 reserved; ///< Reserved, must be 0
+    u32 list_offset; ///< Offset of the display list in "DLST" in words
+} GLMeshMaterialInfo;
+
+/// Mesh loaded in RAM.
+typedef struct
+{
+    GLMeshHeader header; ///< Header of the mesh
+    const GLMeshMaterialInfo *materials; ///< Materials
+    const u32 *lists; ///< Display lists of all materials
+    size_t lists_words; ///< Size of the display lists in words
+    int *textures; ///< Texture names (one per texture of the file)
+    void **texture_data; ///< Data kept until deferred uploads are done
+    size_t *texture_data_size; ///< Size of each buffer in texture_data
+    bool owns_data; ///< Materials and lists have been allocated by the loader
+} GLMesh;
+
+/// Loads a mesh from a file opened with fopen().
+///
+/// The display lists are read directly from the file to their final buffer.
+/// Textures are loaded to VRAM as they are found. If texture uploads are
+/// deferred (see glTexUploadsDefer()) the texture data is kept in RAM until
+/// glMeshFree() is called.
+///
+/// @param file
+///     FILE handle to the mesh file.
+/// @param mesh
+///     Mesh structure to fill.
+///
+/// @return
+///     GL_MESH_NO_ERROR on success, a negative number on error.
+GLMeshError glMeshLoadFileEx(FILE *file, GLMesh *mesh);
+
+/// Loads a mesh from a file in the filesystem (FAT or NitroFS).
+///
+/// @param path
+///     Path to the file.
+/// @param mesh
+///     Mesh structure to fill.
+///
+/// @return
+///     GL_MESH_NO_ERROR on success, a negative number on error.
+GLMeshError glMeshLoadFile(const char *path, GLMesh *mesh);
+
+/// Loads a mesh from a file that is already in RAM.
+///
+/// The display lists and texture data aren't copied, so the buffer must stay
+/// valid until glMeshFree() is called. It must be aligned to 4 bytes.
+///
+/// @param src
+///     Pointer to the mesh file in RAM.
+/// @param size
+///     Size of the file.
+/// @param mesh
+///     Mesh structure to fill.
+///
+/// @return
+///     GL_MESH_NO_ERROR on success, a negative number on error.
+GLMeshError glMeshLoadMem(const void *src, size_t size, GLMesh *mesh);
+
+/// Deletes the textures of a mesh and frees all the memory used by it.
+///
+/// If uploads are deferred and some of them still read from texture data of
+/// the mesh (for example, a palette shared with another texture with
+/// glAssignColorTable()), that data is copied to VRAM before it is freed with
+/// glTexUploadsFlushBuffer().
+///
+/// @param mesh
+///     Mesh to free.
+void glMeshFree(GLMesh *mesh);
+
+/// Returns the display list of a material of a mesh.
+///
+/// It can be sent with glCallList() or glCallListAsync().
+///
+/// @param mesh
+///     Mesh.
+/// @param material
+///     Index of the material.
+///
+/// @return
+///     Pointer to the display list, or NULL if the index isn't valid.
+const void *glMeshGetList(const GLMesh *mesh, int material);
+
+/// Draws all the materials of a mesh with the current matrices.
+///
+/// For each material it sets the polygon format, binds the texture and sends
+/// the display list with glCallList().
+///
+/// @param mesh
+///     Mesh to draw.
+void glMeshDraw(const GLMesh *mesh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_ARM9_MESH_H__
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef LIBNDS_NDS_ARM9_MESHCULL_H__
+#define LIBNDS_NDS_ARM9_MESHCULL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @file nds/arm9/meshcull.h
+///
+/// @brief CPU culling of meshes before sending them to the GPU.
+///
+/// The geometry engine can only store 2048 polygons and 6144 vertices per
+/// frame, and polygons that are culled by the hardware (because they face away
+/// from the camera or because they are outside of the screen) still use part
+/// of that budget. The functions in this file remove those polygons before
+/// they are sent, so that denser scenes fit in the limits of the hardware.
+///
+/// Whole meshes are tested against the view frustum with BoxTest(). The
+/// vertices of visible meshes are transformed with the position test of the
+/// geometry engine (so the result is the same as when the GPU draws them) and
+/// projected with the hardware divider. Then, triangles that are outside of the
+/// frustum or face the wrong way are skipped, and the rest are written to a
+/// packed display list.
+///
+/// Example:
+///
+/// ```
+/// static u32 buffer[4096];
+/// static GLCullVertex workspace[MAX_VERTICES];
+/// GLDisplayList list;
+///
+/// glListInit(&list, buffer, sizeof(buffer));
+///
+/// // Set up the matrices that will be used to draw the mesh
+/// glPushMatrix();
+/// glTranslatef32(x, y, z);
+///
+/// if (glCullMeshEmit(&list, &mesh, workspace, POLY_CULL_BACK) > 0)
+/// {
+///     glPolyFmt(POLY_ALPHA(31) | POLY_CULL_NONE);
+///     glCallList(glListFinish(&list));
+/// }
+///
+/// glPopMatrix(1);
+/// ```
+
+#include <stdbool.h>
+
+#include <nds/arm9/displaylist.h>
+#include <nds/arm9/videoGL.h>
+#include <nds/ndstypes.h>
+
+/// Indexed triangle mesh that can be culled by the CPU.
+typedef struct
+{
+    const v16 *positions; ///< Vertex positions (3 values per vertex)
+    const u32 *texcoords; ///< Packed with TEXTURE_PACK() (NULL if not used)
+    const u32 *normals; ///< Packed with NORMAL_PACK() (NULL if not used)
+    const rgb *colors; ///< Vertex colors (NULL if not used)
+    const u16 *indices; ///< Vertex indices (3 per triangle)
+    u32 num_vertices; ///< Number of vertices
+    u32 num_triangles; ///< Number of triangles
+
+    /// Bounding box of the mesh: x, y, z, width, height and depth, as used by
+    /// BoxTest().
+    v16 bounds[6];
+} GLCullMesh;
+
+/// Transformed vertex. Used internally by glCullMeshEmit().
+typedef struct
+{
+    s32 sx, sy; ///< Projected position, only valid if "projected" is set
+    u8 outcode; ///< Frustum planes the vertex is outside of
+    bool projected; ///< The projected position is valid
+} GLCullVertex;
+
+/// Checks if any part of the bounding box of a mesh is inside the view frustum.
+///
+/// This uses the current modelview and projection matrices. Like BoxTest(), it
+/// changes the polygon format.
+///
+/// @param mesh
+///     Mesh to test.
+///
+/// @return
+///     It returns true if the mesh may be visible.
+bool glCullMeshVisible(const GLCullMesh *mesh);
+
+/// Adds the triangles of a mesh that may be visible to a display list.
+///
+/// The mesh is culled with glCullMeshVisible() first. Then, each triangle is
+/// skipped if all its vertices are outside of the same plane of the view
+/// frustum, or if it faces the side selected by the "cull" argument. The other
+/// triangles are added as a GL_TRIANGLES group.
+///
+/// The vertices are transformed with the current modelview and projection
+/// matrices, so the list must be drawn with the same matrices. This function
+/// sends commands to the geometry engine, so it waits for any display list
+/// sent with glCallListAsync() to finish first.
+///
+/// Triangles are only culled by their orientation if all their vertices are in
+/// front of the camera and not too far from the frustum, the rest are left for
+/// the hardware to clip. Note that the polygon format isn't added to the list,
+/// and that BoxTest() changes it, so it has to be set after calling this
+/// function.
+///
+/// @param list
+///     Display list to add commands to.
+/// @param mesh
+///     Mesh to draw.
+/// @param workspace
+///     Buffer with space for mesh->num_vertices vertices.
+/// @param cull
+///     POLY_CULL_BACK, POLY_CULL_FRONT or POLY_CULL_NONE.
+///
+/// @return
+///     Number of triangles added to the list (0 if the mesh isn't visible), or
+///     -1 if the list has run out of space.
+int glCullMeshEmit(GLDisplayList *list, const GLCullMesh *mesh,
+                   GLCullVertex *workspace, u32 cull);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_ARM9_MESHCULL_H__
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef LIBNDS_NDS_ARM9_MULTIPASS_H__
+#define LIBNDS_NDS_ARM9_MULTIPASS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @file nds/arm9/multipass.h
+///
+/// @brief Multipass 3D rendering using display capture.
+///
+/// The 3D engine can only draw 2048 polygons per frame. This helper splits the
+/// rendering of a scene over several frames, and it uses display capture to
+/// keep showing the parts that aren't redrawn in the current frame. There are
+/// two modes:
+///
+/// - GL_MULTIPASS_STRIPS: The screen is split in horizontal strips, and only
+///   one strip is drawn every frame. Each strip can have up to 2048 polygons,
+///   but the scene is refreshed at 60 / passes frames per second. The
+///   projection matrix and viewport are adjusted automatically so that the
+///   scene can be drawn the same way in all passes, and polygons outside of
+///   the strip are clipped by the hardware (and don't count towards the limit).
+///
+///   The main engine uses mode 5, with the 3D output in layer 0 and the result
+///   of the last capture in layer 3. The clear color is made transparent so
+///   that layer 3 is visible outside of the strip. Inside the strip, a
+///   polygon with the backdrop color is drawn behind the scene to hide the
+///   previous image.
+///
+/// - GL_MULTIPASS_DUAL_SCREEN: The 3D output is shown on both screens at 30
+///   frames per second. Pass 0 is drawn on the top screen and pass 1 on the
+///   bottom screen. The sub engine shows the last capture of the other screen
+///   with a bitmap background (VRAM C) or 12 bitmap sprites (VRAM D).
+///
+/// Both modes use VRAM banks C and D to store captured images, so they can't
+/// be used for textures.
+///
+/// Example:
+///
+/// ```
+/// glMultipassInit(GL_MULTIPASS_STRIPS, 2);
+///
+/// while (1)
+/// {
+///     // Set the projection and camera for the whole scene
+///     glMatrixMode(GL_PROJECTION);
+///     glLoadIdentity();
+///     gluPerspective(70, 256.0 / 192.0, 0.1, 40);
+///     glMatrixMode(GL_MODELVIEW);
+///     glLoadIdentity();
+///
+///     int pass = glMultipassBegin();
+///     if (pass >= 0)
+///     {
+///         // Draw the whole scene (or only the objects of this pass)
+///     }
+///     glMultipassEnd();
+///
+///     glFlush(0);
+///     swiWaitForVBlank();
+///     glMultipassVBlank();
+/// }
+/// ```
+
+#include <stdbool.h>
+
+#include <nds/arm9/videoGL.h>
+#include <nds/ndstypes.h>
+
+/// Maximum number of passes in GL_MULTIPASS_STRIPS mode.
+#define GL_MULTIPASS_MAX_PASSES 4
+
+/// Multipass rendering modes.
+typedef enum
+{
+    GL_MULTIPASS_STRIPS, ///< Split the screen in horizontal strips
+    GL_MULTIPASS_DUAL_SCREEN, ///< Show the 3D output on both screens
+} GLMultipassMode;
+
+/// Sets up the video modes, VRAM banks and display capture for multipass
+/// rendering.
+///
+/// glInit() must have been called before. VRAM banks C and D are cleared and
+/// used to store captured images.
+///
+/// @param mode
+///     Multipass mode.
+/// @param passes
+///     Number of strips in GL_MULTIPASS_STRIPS mode (from 2 to
+///     GL_MULTIPASS_MAX_PASSES). It is ignored in GL_MULTIPASS_DUAL_SCREEN mode.
+///
+/// @return
+///     It returns true on success, false if the arguments are invalid.
+bool glMultipassInit(GLMultipassMode mode, int passes);
+
+/// Stops multipass rendering.
+///
+/// Display capture is stopped, the viewport is reset and the main engine is
+/// moved to the top screen. The video modes and VRAM banks need to be set up
+/// again by the caller.
+void glMultipassExit(void);
+
+/// Sets the color used to fill the current strip in GL_MULTIPASS_STRIPS mode.
+///
+/// It replaces the clear color, which is made transparent by this helper.
+///
+/// @param color
+///     Backdrop color.
+void glMultipassSetBackdrop(rgb color);
+
+/// Prepares the geometry engine to draw the next pass.
+///
+/// In GL_MULTIPASS_STRIPS mode this reads the current projection matrix,
+/// adjusts it to the strip of this pass, sets the viewport and draws the
+/// backdrop. The polygon format and texture format are changed, so they need
+/// to be set after calling this function.
+///
+/// @return
+///     Index of the pass (in GL_MULTIPASS_DUAL_SCREEN mode, 0 for the top
+///     screen and 1 for the bottom screen), or -1 if multipass rendering isn't
+///     active.
+int glMultipassBegin(void);
+
+/// Ends the current pass.
+///
+/// This restores the projection matrix and viewport changed by
+/// glMultipassBegin(). Call it before glFlush().
+void glMultipassEnd(void);
+
+/// Updates the display for the pass drawn in the last frame.
+///
+/// Call it right after the vertical blank interrupt (after swiWaitForVBlank(),
+/// for example). It rotates the capture banks, starts the capture of the
+/// current frame and, in GL_MULTIPASS_DUAL_SCREEN mode, selects the screen
+/// that shows the 3D output.
+void glMultipassVBlank(void);
+
+/// Returns the number of polygons shown on the screen, added for all passes.
+///
+/// In GL_MULTIPASS_STRIPS mode, polygons that cross the border between strips
+/// are counted once per strip.
+///
+/// @return
+///     Number of polygons.
+int glMultipassPolygonCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_ARM9_MULTIPASS_H__
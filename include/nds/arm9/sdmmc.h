@@ -55,6 +55,15 @@ u32 nand_GetSectors(void);
 ///     Returns the number of sectors or 0 on failure.
 u32 sdmmc_GetSectors(void);
 
+/// Outputs the erase block size of the SD card.
+///
+/// This is the allocation unit (AU) size reported by the card. Writes that are
+/// aligned to it and cover whole blocks are the fastest ones.
+///
+/// @return
+///     Returns the size in sectors, 1 if it isn't known, or 0 on failure.
+u32 sdmmc_GetEraseBlockSize(void);
+
 /// Reads one or more sectors from the eMMC NAND.
 ///
 /// @param[in] sector
@@ -81,6 +90,35 @@ bool nand_ReadSectors(sec_t sector, sec_t numSectors, void *buffer);
 ///     Returns true on success or false on failure.
 bool nand_WriteSectors(sec_t sector, sec_t numSectors, const void *buffer);
 
+/// Writes to the SD card any sectors still pending in the write-combining
+/// buffer.
+///
+/// Writes to the SD card that are adjacent to previous writes are merged and
+/// sent to the card as a single multi-block write. Pending sectors are also
+/// written after a few frames without new writes. This function acts as a
+/// barrier: after it returns, all previous writes have reached the card.
+///
+/// If the pending sectors can't be written they are kept in the buffer, so
+/// calling this function again retries the write.
+///
+/// @return
+///     Returns true on success or false on failure.
+bool sdmmc_Flush(void);
+
+/// Tells the SD card that some sectors don't hold valid data anymore.
+///
+/// The sectors are erased, which lets the card reuse them for future writes
+/// without having to preserve their contents.
+///
+/// @param[in] sector
+///     The start sector.
+/// @param[in] numSectors
+///     The number of sectors to trim.
+///
+/// @return
+///     Returns true on success or false on failure.
+bool sdmmc_TrimSectors(sec_t sector, sec_t numSectors);
+
 // Compatibility macros.
 #define nand_GetSize nand_GetSectors
 
@@ -23,6 +23,8 @@ extern "C" {
 #error 3D hardware is only available from the ARM9
 #endif
 
+#include <stddef.h>
+
 #include <nds/arm9/cache.h>
 #include <nds/arm9/dynamicArray.h>
 #include <nds/arm9/math.h>
@@ -685,6 +687,182 @@ int glLockVRAMBank(uint16_t *addr);
 ///     1 on success, 0 on failure.
 int glUnlockVRAMBank(uint16_t *addr);
 
+/// Moves some textures and palettes to lower VRAM addresses to join free space.
+///
+/// After a lot of calls to glTexImage2D() and glDeleteTextures() the free VRAM
+/// may be split in small areas, and big textures may fail to be allocated even
+/// if there is enough free space in total. This function moves textures and
+/// palettes to the lowest free spot where they fit, so that the free space
+/// ends up at the end of the banks.
+///
+/// The work is split in steps so that it can be done over several frames. Call
+/// it during the vertical blanking period, as it maps the texture and palette
+/// banks as LCD while it copies the data with DMA. At least one texture or
+/// palette is moved in each call, even if it is bigger than the limit.
+///
+/// Compressed textures and data in locked banks aren't moved. The active
+/// texture and palette registers are updated, but display lists that set the
+/// texture format or palette address need to be generated again. Pointers
+/// returned by glGetTexturePointer() are no longer valid.
+///
+/// @param max_bytes
+///     Maximum number of bytes to copy in this call.
+///
+/// @return
+///     It returns true when there is nothing else to move, false otherwise.
+bool glCompactVRAMStep(size_t max_bytes);
+
+/// Moves all textures and palettes to lower VRAM addresses to join free space.
+///
+/// This calls glCompactVRAMStep() until there is nothing else to move.
+void glCompactVRAM(void);
+
+/// Loads a texture to the active texture name and lets the residency manager
+/// evict it from VRAM when space is needed.
+///
+/// The arguments are the same as for glTexImage2D(). The texture data is kept
+/// in RAM (or in Slot-2 RAM) so that it can be copied to VRAM again after it
+/// has been evicted. When a new texture doesn't fit in VRAM (or when the
+/// budget set with glTexResidencySetBudget() is exceeded) the managed texture
+/// that has gone the longest without being bound is evicted. Textures bound in
+/// the current frame and the active texture are never evicted.
+///
+/// An evicted texture is drawn without texture until it is loaded again. When
+/// it is bound it is marked to be loaded during the next call to
+/// glTexResidencyUpdate(). Palettes always stay in VRAM.
+///
+/// Calling glTexImage2D() or glDeleteTextures() for this texture stops the
+/// residency manager from handling it.
+///
+/// @param target
+///     Ignored, only here for OpenGL compatibility.
+/// @param empty1
+///     Ignored, only here for OpenGL compatibility.
+/// @param type
+///     The format of the texture (see glTexImage2D()).
+/// @param sizeX
+///     The horizontal size of the texture.
+/// @param sizeY
+///     The vertical size of the texture.
+/// @param empty2
+///     Ignored, only here for OpenGL compatibility.
+/// @param param
+///     Parameters for the texture (see glTexImage2D()).
+/// @param texture
+///     Pointer to the texture data.
+/// @param copy
+///     If true, the data is copied to a buffer allocated with malloc() that is
+///     freed when the texture is deleted. GL_RGB textures are converted to
+///     GL_RGBA when they are copied. If false, the buffer is used directly, and
+///     it must stay valid until the texture is deleted.
+///
+/// @return
+///     1 on success, 0 on failure.
+int glTexImage2DResident(int target, int empty1, GL_TEXTURE_TYPE_ENUM type,
+                         int sizeX, int sizeY, int empty2, int param,
+                         const void *texture, bool copy);
+
+/// Updates the state of the residency manager and loads evicted textures that
+/// have been bound since the last call.
+///
+/// Call it once per frame, during the vertical blanking period. Textures are
+/// loaded in order of texture name until the limit is reached. At least one
+/// texture is loaded in each call, even if it is bigger than the limit.
+///
+/// @param max_bytes
+///     Maximum number of bytes to copy to VRAM in this call.
+void glTexResidencyUpdate(size_t max_bytes);
+
+/// Sets the maximum amount of VRAM that textures handled by the residency
+/// manager can use.
+///
+/// Textures are evicted right away if the current usage is over the budget.
+///
+/// @param bytes
+///     Budget in bytes. If it is 0 (the default) textures are only evicted when
+///     VRAM is full.
+void glTexResidencySetBudget(size_t bytes);
+
+/// Returns the amount of VRAM used by textures handled by the residency manager.
+///
+/// @return
+///     Size in bytes.
+size_t glTexResidencyGetUsage(void);
+
+/// Checks if a texture is currently loaded in VRAM.
+///
+/// @param name
+///     Texture name.
+///
+/// @return
+///     It returns true if the texture is in VRAM.
+bool glTexIsResident(int name);
+
+/// Marks an evicted texture to be loaded during the next call to
+/// glTexResidencyUpdate() without having to bind it.
+///
+/// @param name
+///     Texture name.
+///
+/// @return
+///     1 on success, 0 if the texture isn't handled by the residency manager.
+int glTexPrefetch(int name);
+
+/// Enables or disables deferred texture and palette uploads.
+///
+/// Normally, glTexImage2D() and glColorTableEXT() map the VRAM banks as LCD,
+/// copy the data and restore the banks right away, once per texture. When
+/// uploads are deferred they only allocate VRAM, and the copies are added to a
+/// queue. glTexUploadsFlush() copies them with DMA mapping each bank only once
+/// for the whole batch. This is useful to load many textures at once, like
+/// when a level starts, and to spread the work over several frames.
+///
+/// The data passed to the functions must stay valid until it has been copied.
+/// Textures that haven't been copied yet are drawn with whatever data was in
+/// VRAM before.
+///
+/// Disabling deferred uploads copies all pending data.
+///
+/// @param defer
+///     True to defer uploads, false to copy data right away.
+void glTexUploadsDefer(bool defer);
+
+/// Copies textures and palettes queued while uploads are deferred to VRAM.
+///
+/// Call it during the vertical blanking period, as the banks are mapped as LCD
+/// while the data is copied. Data is copied in the same order as it was
+/// queued. At least one texture or palette is copied in each call, even if it
+/// is bigger than the limit.
+///
+/// @param max_bytes
+///     Maximum number of bytes to copy in this call.
+///
+/// @return
+///     It returns true when there is nothing else to copy, false otherwise.
+bool glTexUploadsFlush(size_t max_bytes);
+
+/// Copies the deferred uploads that read from a buffer in RAM to VRAM.
+///
+/// Call it before freeing or reusing a buffer that has been passed to
+/// glTexImage2D() or glColorTableEXT() while uploads are deferred. Other
+/// entries of the queue aren't copied. Like glTexUploadsFlush(), it should be
+/// called during the vertical blanking period.
+///
+/// @param src
+///     Start of the buffer.
+/// @param size
+///     Size of the buffer in bytes.
+///
+/// @return
+///     It returns true if any data has been copied, false otherwise.
+bool glTexUploadsFlushBuffer(const void *src, size_t size);
+
+/// Returns the amount of data waiting to be copied by glTexUploadsFlush().
+///
+/// @return
+///     Size in bytes.
+size_t glTexUploadsPending(void);
+
 /// Sets texture coordinates for following vertices (fixed point version).
 ///
 /// @param u
@@ -706,6 +884,9 @@ void glMaterialf(GL_MATERIALS_ENUM mode, rgb color);
 /// The first 32 bits is the length of the packed command list, followed by the
 /// packed list.
 ///
+/// Before sending the list it waits for any list queued with glCallListAsync()
+/// to be sent.
+///
 /// @param list
 ///     Pointer to the packed list.
 void glCallList(const void *list);
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef LIBNDS_NDS_COJOB_H__
+#define LIBNDS_NDS_COJOB_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @file nds/cojob.h
+///
+/// @brief Job system built on top of cooperative multithreading
+///
+/// Jobs are functions that are run by a fixed pool of worker threads. Every
+/// submitted job returns a future that can be used to wait for the job to end
+/// and to get its return value. Jobs can be chained so that a job is only
+/// started when a previous one has ended, which makes it possible to build
+/// pipelines (like file read, decompression and VRAM upload) without writing
+/// state machines.
+///
+/// Workers are regular cothreads, so jobs must yield (or block on a FIFO
+/// message, mutex, etc) from time to time to let other threads run.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Default stack size of worker threads.
+#define COJOB_DEFAULT_STACK_SIZE    (4 * 1024)
+
+/// Function run by a job. It returns the result of the job.
+typedef int (*cojob_fn_t)(void *arg);
+
+/// Future of a job.
+typedef struct cojob_future cojob_future_t;
+
+/// Function run by a job created with cojob_then().
+///
+/// It gets the future of the job that had to end first, which is valid while
+/// the function runs even if it has been freed with cojob_future_free(). Its
+/// result can be read with cojob_future_get().
+typedef int (*cojob_then_fn_t)(cojob_future_t *previous, void *arg);
+
+/// Description of a job, used for batched submission.
+typedef struct
+{
+    cojob_fn_t fn; ///< Function to run
+    void *arg; ///< Argument passed to the function
+} cojob_desc_t;
+
+/// Creates the worker threads of the job system.
+///
+/// @param workers
+///     Number of worker threads. This is the maximum number of jobs that can be
+///     in progress at the same time.
+/// @param stack_size
+///     Stack size of the workers. If it is set to zero it will use
+///     COJOB_DEFAULT_STACK_SIZE. It must be aligned to 64 bit.
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno.
+int cojob_init(unsigned int workers, size_t stack_size);
+
+/// Waits for all workers to finish their current jobs and deletes them.
+///
+/// Workers don't start any other job after this function is called. Jobs that
+/// haven't been started yet are left in the queue, and they will be run if
+/// cojob_init() is called again. This includes jobs submitted by the jobs that
+/// were running when this function was called, and their continuations.
+///
+/// It must not be called from a job, as the worker running the job would wait
+/// for itself to exit.
+void cojob_exit(void);
+
+/// Adds a job to the queue of the job system.
+///
+/// @param fn
+///     Function to run.
+/// @param arg
+///     Argument passed to the function.
+///
+/// @return
+///     On success, it returns the future of the job. On failure, it returns
+///     NULL and sets errno.
+cojob_future_t *cojob_submit(cojob_fn_t fn, void *arg);
+
+/// Adds several jobs to the queue of the job system.
+///
+/// All jobs are added before any worker is woken up.
+///
+/// @param jobs
+///     Array of job descriptions.
+/// @param count
+///     Number of jobs.
+/// @param futures
+///     Array where the futures of the jobs are stored. It can be NULL if the
+///     caller doesn't need them, in which case they are freed automatically.
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno. If
+///     it fails, no job is submitted.
+int cojob_submit_batch(const cojob_desc_t *jobs, size_t count,
+                       cojob_future_t **futures);
+
+/// Creates a job that is only started after another job has ended.
+///
+/// If several jobs depend on the same job, they are queued in the same order
+/// as they were created. The previous future isn't freed until all the jobs
+/// that depend on it have ended, so it's possible to call cojob_future_free()
+/// right after calling this function.
+///
+/// @param future
+///     Future of the job that has to end first.
+/// @param fn
+///     Function to run. It gets the future of the previous job.
+/// @param arg
+///     Argument passed to the function.
+///
+/// @return
+///     On success, it returns the future of the new job. On failure, it returns
+///     NULL and sets errno.
+cojob_future_t *cojob_then(cojob_future_t *future, cojob_then_fn_t fn,
+                           void *arg);
+
+/// Returns true if the job of a future has ended.
+///
+/// @param future
+///     Future of the job.
+///
+/// @return
+///     It returns true if the job has ended, false otherwise.
+bool cojob_future_is_ready(const cojob_future_t *future);
+
+/// Blocks the current thread until the job of a future has ended.
+///
+/// @param future
+///     Future of the job.
+///
+/// @return
+///     Value returned by the job.
+int cojob_future_wait(cojob_future_t *future);
+
+/// Returns the result of a job that has ended.
+///
+/// @param future
+///     Future of the job. The job must have ended.
+///
+/// @return
+///     Value returned by the job.
+int cojob_future_get(const cojob_future_t *future);
+
+/// Frees a future.
+///
+/// If the job hasn't ended yet, the future will be freed when it ends. This
+/// can be used to submit jobs whose result isn't needed. Don't use the future
+/// after calling this function.
+///
+/// @param future
+///     Future to free.
+void cojob_future_free(cojob_future_t *future);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_COJOB_H__
@@ -19,10 +19,18 @@ extern "C" {
 #include <stdint.h>
 #include <stddef.h>
 
+#ifdef ARM9
+#include <nds/arm9/sassert.h>
+#endif
+
 /// Thread ID
 typedef int cothread_t;
 /// Mutex
 typedef int comutex_t;
+/// Semaphore
+typedef int cosema_t;
+/// Condition variable
+typedef int cocond_t;
 /// Thread entrypoint
 typedef int (*cothread_entrypoint_t)(void *);
 
@@ -32,9 +40,59 @@ typedef int (*cothread_entrypoint_t)(void *);
 /// cothread_has_joined() or cothread_get_exit_code() isn't allowed.
 #define COTHREAD_DETACHED   (1 << 0)
 
+/// Number of priority levels supported by the scheduler.
+#define COTHREAD_PRIORITY_LEVELS    8
+/// Highest priority a thread can have.
+#define COTHREAD_PRIORITY_HIGHEST   0
+/// Default priority of new threads.
+#define COTHREAD_PRIORITY_NORMAL    4
+/// Lowest priority a thread can have.
+#define COTHREAD_PRIORITY_LOWEST    (COTHREAD_PRIORITY_LEVELS - 1)
+
+/// Bit shift of the priority field in the flags of cothread_create().
+#define COTHREAD_PRIORITY_SHIFT     8
+/// Mask of the priority field in the flags of cothread_create().
+#define COTHREAD_PRIORITY_MASK      (0xF << COTHREAD_PRIORITY_SHIFT)
+
+/// Flag that sets the priority of a new thread in cothread_create().
+///
+/// Lower values mean higher priorities. If this flag isn't used, the thread
+/// uses COTHREAD_PRIORITY_NORMAL.
+///
+/// The scheduler always resumes the highest priority thread that is ready, and
+/// threads of the same priority are resumed in round-robin order. A thread that
+/// never waits for an interrupt (it only calls cothread_yield()) will prevent
+/// all lower priority threads from running.
+#define COTHREAD_PRIORITY(n)        ((((n) & 7) + 1) << COTHREAD_PRIORITY_SHIFT)
+
+/// Value of the deadline of a thread that doesn't have a deadline.
+#define COTHREAD_NO_DEADLINE        0xFFFF
+
+/// Maximum number of stack slabs kept in the pool by cothread_create().
+#define COTHREAD_POOL_MAX_SLABS     8
+
+/// Value written at the bottom of the stack of threads to detect overflows.
+#define COTHREAD_STACK_CANARY       0x5354434BU
+/// Value used to fill the stack of threads to measure the stack usage.
+#define COTHREAD_STACK_FILL_BYTE    0xA5
+
+#ifdef ARM9
+/// Maximum number of work items that can be deferred with cothread_defer().
+#define COTHREAD_DEFERRED_MAX       32
+#endif
+
+/// Hardware timer used by default for cothread_sleep_ms() and timed waits.
+#define COTHREAD_DEFAULT_SLEEP_TIMER    3
+
 /// Creates a thread and allocate the stack for it.
 ///
-/// This stack will be freed when the thread is deleted.
+/// The context, thread local storage and stack of the thread are allocated in
+/// one block of memory. When the thread is deleted, the block is kept in a
+/// small pool so that new threads with the same stack size can reuse it (see
+/// cothread_pool_reserve() and cothread_pool_trim()).
+///
+/// The scheduler checks a canary at the bottom of the stack every time the
+/// thread yields, and crashes with an error message if it has been overwritten.
 ///
 /// Important: If this thread is going to do filesystem accesses, you need to
 /// assign it a reasonably big stack size.
@@ -48,7 +106,7 @@ typedef int (*cothread_entrypoint_t)(void *);
 ///     Size of the stack. If it is set to zero it will use a default value. If
 ///     non-zero, it must be aligned to 64 bit.
 /// @param flags
-///     Set of ORed flags (like COTHREAD_DETACHED) or 0.
+///     Set of ORed flags (like COTHREAD_DETACHED or COTHREAD_PRIORITY()) or 0.
 ///
 /// @return
 ///     On success, it returns a non-negative value representing the thread ID.
@@ -61,6 +119,10 @@ cothread_t cothread_create(cothread_entrypoint_t entrypoint, void *arg,
 /// The stack is owned by the caller of this function, and it has to be freed
 /// manually after the thread ends.
 ///
+/// This can be used to place the stack of a thread that needs fast stack
+/// accesses in DTCM, by passing a buffer defined with DTCM_BSS. Stack overflows
+/// are detected the same way as in cothread_create().
+///
 /// @param entrypoint
 ///     Function to be run. The argument is the value of 'arg' passed to
 ///     cothread_create_manual().
@@ -72,7 +134,7 @@ cothread_t cothread_create(cothread_entrypoint_t entrypoint, void *arg,
 /// @param stack_size
 ///     Size of the stack. Must be aligned to 64 bit.
 /// @param flags
-///     Set of ORed flags (like COTHREAD_DETACHED) or 0.
+///     Set of ORed flags (like COTHREAD_DETACHED or COTHREAD_PRIORITY()) or 0.
 ///
 /// @return
 ///     On success, it returns a non-negative value representing the thread ID.
@@ -81,6 +143,39 @@ cothread_t cothread_create_manual(cothread_entrypoint_t entrypoint, void *arg,
                                   void *stack_base, size_t stack_size,
                                   unsigned int flags);
 
+/// Allocates stacks for future calls to cothread_create().
+///
+/// Threads created with the same stack size will use the preallocated memory
+/// instead of allocating it from the heap. The pool is limited to
+/// COTHREAD_POOL_MAX_SLABS blocks.
+///
+/// @param stack_size
+///     Size of the stack. If it is set to zero it will use the default value
+///     of cothread_create(). It must be aligned to 64 bit.
+/// @param count
+///     Number of stacks to allocate.
+///
+/// @return
+///     On success, it returns the number of stacks added to the pool. On
+///     failure, it returns -1 and sets errno.
+int cothread_pool_reserve(size_t stack_size, unsigned int count);
+
+/// Frees all the stacks kept in the pool of cothread_create().
+void cothread_pool_trim(void);
+
+/// Returns the maximum number of bytes of stack that a thread has used.
+///
+/// This is measured by checking how much of the stack has been overwritten
+/// since the thread was created, so it can be used to size stacks accurately.
+///
+/// @param thread
+///     Thread ID. It can't be the main() thread.
+///
+/// @return
+///     On success, it returns the number of bytes. On failure, it returns -1
+///     and sets errno.
+int cothread_get_stack_usage(cothread_t thread);
+
 /// Detach the specified thread.
 ///
 /// @param thread
@@ -123,7 +218,9 @@ int cothread_get_exit_code(cothread_t thread);
 
 /// Deletes a running thread and frees all memory used by it.
 ///
-/// It isn't possible to delete the currently running thread.
+/// It isn't possible to delete the currently running thread. Threads waiting
+/// to join it with cothread_join_timeout() or thrd_join() are woken up, and
+/// they return an error because the thread doesn't exist anymore.
 ///
 /// @param thread
 ///     Thread ID.
@@ -132,6 +229,52 @@ int cothread_get_exit_code(cothread_t thread);
 ///     On success, it returns 0. On failure, it returns -1 and sets errno.
 int cothread_delete(cothread_t thread);
 
+/// Sets the priority of a thread.
+///
+/// Any priority inherited by the thread because it owns a mutex is dropped.
+///
+/// @param thread
+///     Thread ID.
+/// @param priority
+///     New priority, between COTHREAD_PRIORITY_HIGHEST and
+///     COTHREAD_PRIORITY_LOWEST.
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno.
+int cothread_set_priority(cothread_t thread, int priority);
+
+/// Gets the priority of a thread.
+///
+/// It returns the priority set by the user, not the one inherited from mutexes.
+///
+/// @param thread
+///     Thread ID.
+///
+/// @return
+///     On success, it returns the priority. On failure, it returns -1 and sets
+///     errno.
+int cothread_get_priority(cothread_t thread);
+
+/// Sets a soft deadline for a thread, relative to the start of VBlank.
+///
+/// If the thread is ready to run, it hasn't run yet during the current frame,
+/// and the current scanline is past the deadline, the scheduler resumes it
+/// before any other thread, regardless of priorities. This is useful for
+/// threads that need to do some work every frame, like audio stream refills.
+///
+/// The scheduler counts frames with the VBlank interrupt, so it needs to be
+/// enabled (it is enabled by default).
+///
+/// @param thread
+///     Thread ID.
+/// @param scanlines
+///     Number of scanlines after the start of VBlank (from 0 to 262). A
+///     negative value removes the deadline of the thread.
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno.
+int cothread_set_deadline(cothread_t thread, int scanlines);
+
 /// Tells the scheduler to switch to a different thread.
 ///
 /// This can also be called from main().
@@ -156,12 +299,286 @@ void cothread_yield_irq(uint32_t flags);
 void cothread_yield_irq_aux(uint32_t flags);
 #endif
 
+/// Blocks the current thread for at least the specified number of milliseconds.
+///
+/// The thread isn't resumed by the scheduler until the time has passed. If no
+/// thread is ready to run, the CPU enters low power mode until an interrupt
+/// happens.
+///
+/// While there is any thread sleeping or waiting with a timeout, the hardware
+/// timer selected with cothread_set_sleep_timer() is used by the scheduler.
+///
+/// @param ms
+///     Number of milliseconds to sleep. If it's 0, it behaves like
+///     cothread_yield(). Values over INT32_MAX - 1 are clamped.
+void cothread_sleep_ms(uint32_t ms);
+
+/// Blocks the current thread for the specified number of frames.
+///
+/// It waits for the specified number of VBlank interrupts.
+///
+/// @param frames
+///     Number of frames to sleep.
+void cothread_sleep_frames(uint32_t frames);
+
+/// Selects the hardware timer used by cothread_sleep_ms() and timed waits.
+///
+/// By default, COTHREAD_DEFAULT_SLEEP_TIMER is used. The timer is only used
+/// while there is a thread sleeping or waiting with a timeout. It can't be
+/// changed while the timer is in use, and it can't be one of the timers used
+/// by cothread_profiling_start().
+///
+/// @param timer
+///     Timer index (0 to 3).
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno.
+int cothread_set_sleep_timer(int timer);
+
+/// Waits until a thread ends, or until a timeout expires.
+///
+/// Don't call this if the thread is detached.
+///
+/// @param thread
+///     Thread ID.
+/// @param timeout_ms
+///     Maximum time to wait in milliseconds.
+///
+/// @return
+///     It returns 0 if the thread has ended. On failure, it returns -1 and sets
+///     errno (to ETIMEDOUT if the timeout has expired, or to EINVAL if the
+///     thread doesn't exist or it has been deleted while waiting).
+int cothread_join_timeout(cothread_t thread, uint32_t timeout_ms);
+
+#ifdef ARM9
+
+/// Function deferred with cothread_defer().
+typedef void (*cothread_deferred_fn_t)(void *arg);
+
+/// Defers work from an interrupt handler to the scheduler.
+///
+/// This lets interrupt handlers stay short. The scheduler runs all deferred
+/// functions, in the order they were added, before resuming any thread. They
+/// can wake up threads with cothread_wake_one() or cothread_wake_all(), which
+/// can't be called from interrupt handlers directly.
+///
+/// Deferred functions run outside of any thread: cothread_get_current()
+/// returns 0 and they have their own thread local variables (like errno). They
+/// must not yield or block, so they can't use functions that may wait for a
+/// lock, like malloc() or stdio functions. They can't use comutex_t either,
+/// not even comutex_try_acquire(), because a mutex needs a thread to own it.
+///
+/// It can also be called from threads. It's only available in the ARM9, the
+/// scheduler doesn't run in the ARM7.
+///
+/// @param fn
+///     Function to run.
+/// @param arg
+///     Argument passed to the function.
+///
+/// @return
+///     It returns true on success, false if there are already
+///     COTHREAD_DEFERRED_MAX items waiting to be run.
+bool cothread_defer(cothread_deferred_fn_t fn, void *arg);
+
+#endif // ARM9
+
 /// Returns ID of the thread that is running currently.
 ///
 /// @return
 ///     Thread ID of the current thread.
 cothread_t cothread_get_current(void);
 
+/// Statistics of a thread recorded while profiling is enabled.
+typedef struct
+{
+    uint64_t run_ticks; ///< Time the thread has been running (33.514 MHz ticks)
+    uint32_t resume_count; ///< Number of times the thread has been resumed
+    uint32_t irq_wait_count; ///< Number of times it has waited for an IRQ
+    uint32_t block_count; ///< Number of times it has blocked on an object
+} cothread_stats_t;
+
+/// Statistics of the scheduler recorded while profiling is enabled.
+typedef struct
+{
+    uint64_t idle_ticks; ///< Time spent in low power mode (33.514 MHz ticks)
+    uint32_t idle_count; ///< Number of times low power mode has been entered
+    uint32_t switch_count; ///< Number of times a thread has been resumed
+} cothread_scheduler_stats_t;
+
+/// Types of events recorded in the scheduler trace.
+typedef enum
+{
+    COTHREAD_TRACE_YIELD = 0, ///< A thread has run and yielded
+    COTHREAD_TRACE_WAIT_IRQ = 1, ///< A thread has run and waits for an IRQ
+    COTHREAD_TRACE_BLOCK = 2, ///< A thread has run and blocked on an object
+    COTHREAD_TRACE_END = 3, ///< A thread has run and ended
+    COTHREAD_TRACE_IDLE = 4, ///< The CPU has been in low power mode
+} cothread_trace_type_t;
+
+/// Event of the scheduler trace.
+typedef struct
+{
+    uint32_t timestamp; ///< Time at the start of the event (cpuGetTiming())
+    uint32_t duration; ///< Duration of the event in ticks
+    cothread_t thread; ///< Thread that has run (0 for idle events)
+    uint32_t type; ///< Event type (cothread_trace_type_t)
+} cothread_trace_event_t;
+
+/// Starts recording profiling information in the scheduler.
+///
+/// This uses cpuStartTiming() with the specified timer, so it uses two
+/// hardware timers (timer and timer + 1) and cpuGetTiming() can't be used for
+/// other purposes while profiling is enabled. All statistics are reset.
+///
+/// The timers can't overlap with the timer selected with
+/// cothread_set_sleep_timer(). In that case, errno is set to EBUSY.
+///
+/// @param timer
+///     First timer to use (0 to 2).
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno.
+int cothread_profiling_start(int timer);
+
+/// Stops recording profiling information and stops the timers.
+void cothread_profiling_stop(void);
+
+/// Resets all profiling statistics and the trace.
+void cothread_profiling_reset(void);
+
+/// Gets the profiling statistics of a thread.
+///
+/// @param thread
+///     Thread ID.
+/// @param stats
+///     Pointer to the struct where the statistics are stored.
+///
+/// @return
+///     On success, it returns 0. On failure, it returns -1 and sets errno.
+int cothread_get_stats(cothread_t thread, cothread_stats_t *stats);
+
+/// Gets the profiling statistics of the scheduler.
+///
+/// @param stats
+///     Pointer to the struct where the statistics are stored.
+void cothread_get_scheduler_stats(cothread_scheduler_stats_t *stats);
+
+/// Starts recording scheduler events in a ring buffer.
+///
+/// Events are only recorded while profiling is enabled. When the buffer is
+/// full, the oldest events are overwritten.
+///
+/// @param buffer
+///     Buffer to store the events.
+/// @param count
+///     Number of events that fit in the buffer.
+void cothread_trace_start(cothread_trace_event_t *buffer, size_t count);
+
+/// Stops recording scheduler events.
+void cothread_trace_stop(void);
+
+/// Copies the events of the trace, from the oldest to the newest.
+///
+/// The events can be printed with cothread_trace_type_name(). For example, to
+/// send them to the debug console of no$gba, redirect stderr with
+/// consoleDebugInit(DebugDevice_NOCASH) and print them with fprintf().
+///
+/// @param events
+///     Buffer to store the events.
+/// @param max_events
+///     Number of events that fit in the buffer.
+///
+/// @return
+///     Number of events copied.
+size_t cothread_trace_read(cothread_trace_event_t *events, size_t max_events);
+
+/// Returns the name of a type of event of the trace.
+///
+/// @param type
+///     Event type (cothread_trace_type_t).
+///
+/// @return
+///     Name of the event, or "?" if the type isn't valid.
+const char *cothread_trace_type_name(uint32_t type);
+
+/// Blocks the current thread until another thread wakes it up.
+///
+/// The thread isn't resumed by the scheduler until cothread_wake_one() or
+/// cothread_wake_all() are called with the same object. This is the building
+/// block of mutexes, semaphores and condition variables, but it can be used by
+/// the user to build other synchronization primitives.
+///
+/// @param object
+///     Address used to identify what the thread is waiting for.
+void cothread_block_on(void *object);
+
+/// Blocks the current thread until another thread wakes it up, or until a
+/// timeout expires.
+///
+/// @param object
+///     Address used to identify what the thread is waiting for.
+/// @param timeout_ms
+///     Maximum time to wait in milliseconds. If it's 0, the function returns
+///     right away.
+///
+/// @return
+///     It returns true if the thread has been woken up by cothread_wake_one()
+///     or cothread_wake_all(), false if the timeout has expired.
+bool cothread_block_on_timeout(void *object, uint32_t timeout_ms);
+
+/// Wakes up the highest priority thread blocked on an object.
+///
+/// If several threads have the same priority, the one that has been waiting
+/// for the longest time is woken up. It must not be called from an interrupt
+/// handler.
+///
+/// @param object
+///     Address passed to cothread_block_on().
+///
+/// @return
+///     It returns true if a thread has been woken up, false otherwise.
+bool cothread_wake_one(void *object);
+
+/// Wakes up all threads blocked on an object.
+///
+/// It must not be called from an interrupt handler.
+///
+/// @param object
+///     Address passed to cothread_block_on().
+///
+/// @return
+///     Number of threads that have been woken up.
+int cothread_wake_all(void *object);
+
+/// Bit set in a comutex_t when there are threads blocked on it.
+///
+/// The rest of the bits hold the ID of the thread that owns the mutex.
+#define COMUTEX_WAITERS     (1 << 0)
+
+/// Slow path of comutex_acquire(). It shouldn't be called by user code.
+///
+/// @param mutex
+///     Pointer to the mutex.
+void comutex_acquire_contended(comutex_t *mutex);
+
+/// Slow path of comutex_acquire_timeout(). It shouldn't be called by user code.
+///
+/// @param mutex
+///     Pointer to the mutex.
+/// @param timeout_ms
+///     Maximum time to wait in milliseconds.
+///
+/// @return
+///     It returns true if the mutex has been acquired, false otherwise.
+bool comutex_acquire_contended_timeout(comutex_t *mutex, uint32_t timeout_ms);
+
+/// Slow path of comutex_release(). It shouldn't be called by user code.
+///
+/// @param mutex
+///     Pointer to the mutex.
+void comutex_release_contended(comutex_t *mutex);
+
 /// Initializes a mutex.
 ///
 /// @param mutex
@@ -177,6 +594,10 @@ static inline bool comutex_init(comutex_t *mutex)
 
 /// Tries to acquire a mutex without blocking execution.
 ///
+/// The thread that acquires a mutex becomes its owner, and only the owner can
+/// release it. Mutexes can't be used outside of threads (for example, by
+/// functions passed to cothread_defer()).
+///
 /// @param mutex
 ///     Pointer to the mutex.
 ///
@@ -184,33 +605,220 @@ static inline bool comutex_init(comutex_t *mutex)
 ///     It returns true if the mutex has been acquired, false if not.
 static inline bool comutex_try_acquire(comutex_t *mutex)
 {
+#ifdef ARM9
+    sassert(cothread_get_current() != 0, "Mutexes must be used from threads");
+#endif
+
     if (*mutex != 0)
         return false;
 
-    *mutex = 1;
+    // Save the owner so that priority inheritance can work
+    *mutex = cothread_get_current();
     return true;
 }
 
-/// Waits in a loop until the mutex is available.
+/// Waits until the mutex is available.
 ///
-/// The main body of the loop calls cothread_yield() after each try, so that
-/// other threads can take control of the CPU and eventually release the mutex.
+/// If the mutex is owned by a different thread, the current thread is blocked
+/// and it won't be resumed by the scheduler until the owner releases the mutex
+/// and hands it over to this thread. While it waits, the owner of the mutex
+/// inherits the priority of the current thread if it's higher than its own.
 ///
 /// @param mutex
 ///     Pointer to the mutex.
 static inline void comutex_acquire(comutex_t *mutex)
 {
-    while (comutex_try_acquire(mutex) == false)
-        cothread_yield();
+    if (comutex_try_acquire(mutex) == false)
+        comutex_acquire_contended(mutex);
+}
+
+/// Waits until the mutex is available, or until a timeout expires.
+///
+/// @param mutex
+///     Pointer to the mutex.
+/// @param timeout_ms
+///     Maximum time to wait in milliseconds.
+///
+/// @return
+///     It returns true if the mutex has been acquired, false otherwise.
+static inline bool comutex_acquire_timeout(comutex_t *mutex, uint32_t timeout_ms)
+{
+    if (comutex_try_acquire(mutex))
+        return true;
+
+    return comutex_acquire_contended_timeout(mutex, timeout_ms);
 }
 
 /// Releases a mutex.
 ///
+/// If other threads are waiting for the mutex, the highest priority one becomes
+/// the new owner.
+///
+/// Only the thread that owns the mutex can release it. Releasing it from any
+/// other thread would break the priority inheritance state of the owner.
+///
 /// @param mutex
 ///     Pointer to the mutex.
 static inline void comutex_release(comutex_t *mutex)
 {
-    *mutex = 0;
+#ifdef ARM9
+    sassert((cothread_get_current() != 0)
+            && ((*mutex & ~COMUTEX_WAITERS) == cothread_get_current()),
+            "Mutex released by a thread that doesn't own it");
+#endif
+
+    if (*mutex & COMUTEX_WAITERS)
+        comutex_release_contended(mutex);
+    else
+        *mutex = 0;
+}
+
+/// Initializes a semaphore.
+///
+/// @param sema
+///     Pointer to the semaphore.
+/// @param count
+///     Initial count of the semaphore.
+///
+/// @return
+///     It returns true if the semaphore has been initialized, false if not.
+static inline bool cosema_init(cosema_t *sema, int count)
+{
+    if (count < 0)
+        return false;
+
+    *sema = count;
+    return true;
+}
+
+/// Tries to decrement the count of a semaphore without blocking execution.
+///
+/// @param sema
+///     Pointer to the semaphore.
+///
+/// @return
+///     It returns true if the count has been decremented, false if it was 0.
+static inline bool cosema_try_acquire(cosema_t *sema)
+{
+    if (*sema <= 0)
+        return false;
+
+    (*sema)--;
+    return true;
+}
+
+/// Decrements the count of a semaphore, blocking the thread while it is 0.
+///
+/// @param sema
+///     Pointer to the semaphore.
+static inline void cosema_acquire(cosema_t *sema)
+{
+    // If the count is 0, cosema_release() will wake this thread up without
+    // incrementing the count, which is the same as decrementing it here.
+    if (cosema_try_acquire(sema) == false)
+        cothread_block_on(sema);
+}
+
+/// Decrements the count of a semaphore, blocking the thread while it is 0 for
+/// up to the specified time.
+///
+/// @param sema
+///     Pointer to the semaphore.
+/// @param timeout_ms
+///     Maximum time to wait in milliseconds.
+///
+/// @return
+///     It returns true if the count has been decremented, false if the timeout
+///     has expired.
+static inline bool cosema_acquire_timeout(cosema_t *sema, uint32_t timeout_ms)
+{
+    if (cosema_try_acquire(sema))
+        return true;
+
+    return cothread_block_on_timeout(sema, timeout_ms);
+}
+
+/// Increments the count of a semaphore, or wakes up a thread waiting for it.
+///
+/// @param sema
+///     Pointer to the semaphore.
+static inline void cosema_release(cosema_t *sema)
+{
+    if (cothread_wake_one(sema) == false)
+        (*sema)++;
+}
+
+/// Initializes a condition variable.
+///
+/// @param cond
+///     Pointer to the condition variable.
+///
+/// @return
+///     It returns true if the condition variable has been initialized, false if
+///     not.
+static inline bool cocond_init(cocond_t *cond)
+{
+    *cond = 0;
+    return true;
+}
+
+/// Releases a mutex and blocks the thread until the condition is signaled.
+///
+/// The mutex is acquired again before returning.
+///
+/// @param cond
+///     Pointer to the condition variable.
+/// @param mutex
+///     Pointer to a mutex owned by the current thread.
+static inline void cocond_wait(cocond_t *cond, comutex_t *mutex)
+{
+    // Threads are cooperative, so no other thread can signal the condition
+    // between the release of the mutex and the moment this thread blocks.
+    comutex_release(mutex);
+    cothread_block_on(cond);
+    comutex_acquire(mutex);
+}
+
+/// Releases a mutex and blocks the thread until the condition is signaled or a
+/// timeout expires.
+///
+/// The mutex is acquired again before returning, even if the timeout expires.
+///
+/// @param cond
+///     Pointer to the condition variable.
+/// @param mutex
+///     Pointer to a mutex owned by the current thread.
+/// @param timeout_ms
+///     Maximum time to wait in milliseconds.
+///
+/// @return
+///     It returns true if the condition has been signaled, false if the timeout
+///     has expired.
+static inline bool cocond_wait_timeout(cocond_t *cond, comutex_t *mutex,
+                                       uint32_t timeout_ms)
+{
+    comutex_release(mutex);
+    bool signaled = cothread_block_on_timeout(cond, timeout_ms);
+    comutex_acquire(mutex);
+    return signaled;
+}
+
+/// Wakes up the highest priority thread waiting for a condition variable.
+///
+/// @param cond
+///     Pointer to the condition variable.
+static inline void cocond_signal(cocond_t *cond)
+{
+    cothread_wake_one(cond);
+}
+
+/// Wakes up all threads waiting for a condition variable.
+///
+/// @param cond
+///     Pointer to the condition variable.
+static inline void cocond_broadcast(cocond_t *cond)
+{
+    cothread_wake_all(cond);
 }
 
 // Private thread information. It is private to the library, but exposed here
@@ -225,12 +833,32 @@ typedef struct
     // Specific to cothread
     void *stack_base; // If not NULL, it has to be freed by the scheduler
     void *tls;
-    void *next;
+    void *next; // List of all threads
+    void *sched_next; // Ready queue or IRQ wait list the thread is in
     uint32_t wait_irq_flags;
 #ifdef ARM7
     uint32_t wait_irq_aux_flags;
 #endif
     uint32_t flags;
+    uint8_t priority; // Current priority, it may be inherited from a mutex
+    uint8_t base_priority; // Priority set by the user
+    uint16_t deadline; // Scanlines after VBlank, or COTHREAD_NO_DEADLINE
+    uint32_t last_frame; // Frame in which the thread was last resumed
+    void *deadline_next; // List of threads with a deadline
+    void *wait_object; // Object the thread is blocked on, or NULL
+    uint32_t contended_mutexes; // Owned mutexes with threads waiting for them
+    void *wait_mutex_owner; // Owner of the mutex this thread is waiting for
+    uint32_t wake_tick; // Timer tick in which the wait times out
+    void *timer_next; // Timer wheel slot list
+    bool timer_armed; // The thread is in the timer wheel
+    bool timed_out; // The last wait has timed out
+    bool slab; // Context, TLS and stack are one block from the pool
+    void *stack_limit; // Bottom of the stack, where the canary is stored
+    uint32_t stack_size;
+    uint64_t run_ticks; // Profiling information
+    uint32_t resume_count;
+    uint32_t irq_wait_count;
+    uint32_t block_count;
 } cothread_info_t;
 
 #ifdef __cplusplus
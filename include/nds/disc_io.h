@@ -17,6 +17,7 @@ extern "C" {
 #define FEATURE_SLOT_GBA            0x00000010 ///< This driver uses Slot-2 cartridges.
 #define FEATURE_SLOT_NDS            0x00000020 ///< This driver uses Slot-1 cartridges.
 #define FEATURE_ARM7_CAPABLE        0x00000100 ///< This driver can be safely used from ARM7 and ARM9. BlocksDS extension.
+#define FEATURE_MEDIUM_CANTRIM      0x00000200 ///< This driver implements trimSectors(). BlocksDS extension.
 
 #define DEVICE_TYPE_DSI_SD          ('_') | ('S' << 8) | ('D' << 16) | ('_' << 24)
 
@@ -26,6 +27,7 @@ typedef bool (*FN_MEDIUM_READSECTORS)(sec_t sector, sec_t numSectors, void *buff
 typedef bool (*FN_MEDIUM_WRITESECTORS)(sec_t sector, sec_t numSectors, const void *buffer);
 typedef bool (*FN_MEDIUM_CLEARSTATUS)(void);
 typedef bool (*FN_MEDIUM_SHUTDOWN)(void);
+typedef bool (*FN_MEDIUM_TRIMSECTORS)(sec_t sector, sec_t numSectors);
 
 typedef struct DISC_INTERFACE_STRUCT
 {
@@ -39,6 +41,7 @@ typedef struct DISC_INTERFACE_STRUCT
     /// @see FEATURE_SLOT_GBA
     /// @see FEATURE_SLOT_NDS
     /// @see FEATURE_ARM7_CAPABLE
+    /// @see FEATURE_MEDIUM_CANTRIM
     unsigned long           features;
 
     /// Initialize the device.
@@ -99,6 +102,21 @@ typedef struct DISC_INTERFACE_STRUCT
     /// @return
     ///     True on success.
     FN_MEDIUM_SHUTDOWN      shutdown;
+
+    /// Tell the device that some sectors don't hold valid data anymore.
+    ///
+    /// This field is only present if FEATURE_MEDIUM_CANTRIM is set in the
+    /// features field. Drivers that don't set it can use the space after
+    /// shutdown for anything else, so it must not be accessed in that case.
+    ///
+    /// @param sector
+    ///     The first sector.
+    /// @param numSectors
+    ///     The number of sectors.
+    ///
+    /// @return
+    ///     True on success.
+    FN_MEDIUM_TRIMSECTORS   trimSectors;
 } DISC_INTERFACE;
 
 /// Return the internal DSi SD card interface.
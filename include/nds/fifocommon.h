@@ -95,6 +95,8 @@ typedef enum
     DLDI_CLEAR_STATUS,
     DLDI_SHUTDOWN,
     SLOT1_CARD_READ,
+    DLDI_TRIM_SECTORS,
+    SDMMC_SD_ERASE_BLOCK_SIZE,
 } FifoSdmmcCommands;
 
 typedef enum
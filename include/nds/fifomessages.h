@@ -31,7 +31,10 @@ typedef enum {
     CAMERA_APT_READ_I2C,
     CAMERA_APT_WRITE_I2C,
     CAMERA_APT_READ_MCU,
-    CAMERA_APT_WRITE_MCU
+    CAMERA_APT_WRITE_MCU,
+    SDMMC_SD_TRIM_SECTORS,
+    SYS_ARM7_TASK_RUN,
+    SYS_ARM7_TASK_DONE
 } FifoMessageType;
 
 typedef struct FifoMessage {
@@ -119,6 +122,19 @@ typedef struct FifoMessage {
         struct {
             void *buffer;
         } setArm7Console;
+
+        struct {
+            void *args;
+            u32 size;
+            u16 id;
+            u16 ticket;
+        } arm7TaskRun;
+
+        struct {
+            u32 result;
+            u16 ticket;
+            u16 status;
+        } arm7TaskDone;
     };
 
 } ALIGN(4) FifoMessage;
@@ -5,6 +5,8 @@
 #ifndef THREADS_H__
 #define THREADS_H__
 
+#include <time.h>
+
 #include <nds/cothread.h>
 
 // Partial implementation of C11 threads.h.
@@ -47,6 +49,28 @@ static inline void thrd_yield(void)
     cothread_yield();
 }
 
+static inline int thrd_sleep(const struct timespec *duration,
+                             struct timespec *remaining)
+{
+    if ((duration->tv_sec < 0) || (duration->tv_nsec < 0))
+        return -2;
+
+    // Durations that don't fit in 32 bits are clamped to the longest sleep
+    uint64_t ms = (uint64_t)duration->tv_sec * 1000 + duration->tv_nsec / 1000000;
+    if (ms > UINT32_MAX)
+        ms = UINT32_MAX;
+
+    cothread_sleep_ms(ms);
+
+    if (remaining != NULL)
+    {
+        remaining->tv_sec = 0;
+        remaining->tv_nsec = 0;
+    }
+
+    return 0;
+}
+
 typedef comutex_t mtx_t;
 enum
 {
@@ -76,6 +100,41 @@ static inline int mtx_unlock(mtx_t *mtx)
     return thrd_success;
 }
 
+static inline void mtx_destroy(mtx_t *mtx)
+{
+    (void)mtx;
+}
+
+typedef cocond_t cnd_t;
+
+static inline int cnd_init(cnd_t *cond)
+{
+    return cocond_init(cond) ? thrd_success : thrd_error;
+}
+
+static inline int cnd_signal(cnd_t *cond)
+{
+    cocond_signal(cond);
+    return thrd_success;
+}
+
+static inline int cnd_broadcast(cnd_t *cond)
+{
+    cocond_broadcast(cond);
+    return thrd_success;
+}
+
+static inline int cnd_wait(cnd_t *cond, mtx_t *mtx)
+{
+    cocond_wait(cond, mtx);
+    return thrd_success;
+}
+
+static inline void cnd_destroy(cnd_t *cond)
+{
+    (void)cond;
+}
+
 #ifdef __cplusplus
 }
 #endif
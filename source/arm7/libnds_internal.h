@@ -6,6 +6,7 @@
 #ifndef ARM7_LIBNDS_INTERNAL_H__
 #define ARM7_LIBNDS_INTERNAL_H__
 
+#include <nds/fifomessages.h>
 #include <nds/ndstypes.h>
 
 #include "common/libnds_internal.h"
@@ -13,6 +14,7 @@
 void storageMsgHandler(int bytes, void *user_data);
 void storageValueHandler(u32 value, void *user_data);
 void firmwareMsgHandler(int bytes, void *user_data);
+void arm7TaskMsgHandler(FifoMessage *msg);
 
 typedef struct {
     u16 value;      // 1..4095, 0 if invalid
@@ -691,6 +691,52 @@ static u32 updateStatus(SdmmcDev *const dev, const bool stopTransmission)
     return res;
 }
 
+u32 SDMMC_getEraseBlockSize(const u8 devNum)
+{
+    if (devNum > SDMMC_MAX_DEV_NUM)
+        return 0;
+
+    // Check if the device is initialized.
+    SdmmcDev *const dev = &g_devs[devNum];
+    const u8 devType = dev->type;
+    if (devType == DEV_TYPE_NONE)
+        return 0;
+
+    // (e)MMC erase groups aren't cached and they aren't needed for now.
+    if (IS_DEV_MMC(devType))
+        return 1;
+
+    // Send the app CMD without a buffer, it isn't a data command.
+    TmioPort *const port = &dev->port;
+    TMIO_setBuffer(port, NULL, 1);
+    u32 res = TMIO_sendCommand(port, MMC_APP_CMD, (u32)dev->rca << 16);
+    if (res != 0)
+        return 0;
+
+    // The SD status is a single 64 byte block. SET_BLOCKLEN isn't needed.
+    alignas(4) u8 status[64];
+    TMIO_setBlockLen(port, 64);
+    TMIO_setBuffer(port, (u32 *)status, 1);
+    res = TMIO_sendCommand(port, SD_APP_SD_STATUS, 0);
+    TMIO_setBlockLen(port, 512); // Restore default block length.
+    if (res != 0)
+    {
+        updateStatus(dev, false);
+        return 0;
+    }
+
+    // AU_SIZE [431:428]. The status is sent MSB first.
+    const u32 au_size = status[10] >> 4;
+    if (au_size == 0) // Not defined.
+        return 1;
+    if (au_size <= 9) // 16 KB to 4 MB, powers of two.
+        return 32u << (au_size - 1);
+
+    // 8 MB, 12 MB, 16 MB, 24 MB, 32 MB and 64 MB.
+    static const u8 au_size_mb[6] = { 8, 12, 16, 24, 32, 64 };
+    return (u32)au_size_mb[au_size - 10] * 2048;
+}
+
 // Note: On multi-block read from the last 2 sectors there are no errors reported by the controller
 //       however the R1 card status may report ADDRESS_OUT_OF_RANGE on next(?) status read.
 //       This error is normal for (e)MMC and can be ignored.
@@ -748,8 +794,18 @@ u32 SDMMC_writeSectors(const u8 devNum, u32 sect, const void *const buf, const u
     if (dev->prot != 0)
         return SDMMC_ERR_WRITE_PROT;
 
-    // Set source buffer and sector count.
     TmioPort *const port = &dev->port;
+
+    // Tell SD cards how many blocks are going to be written so that they can
+    // pre-erase them. This is only a hint, so errors are ignored. It has to be
+    // sent before setting up the buffer because it isn't a data command.
+    if (count > 1 && !IS_DEV_MMC(devType))
+    {
+        TMIO_setBuffer(port, NULL, 1);
+        sendAppCmd(port, SD_APP_SET_WR_BLK_ERASE_COUNT, count, (u32)dev->rca << 16);
+    }
+
+    // Set source buffer and sector count.
     TMIO_setBuffer(port, (void *)buf, count);
 
     // Write a single 512 bytes block. Same CMD for (e)MMC/SD.
@@ -773,6 +829,58 @@ u32 SDMMC_writeSectors(const u8 devNum, u32 sect, const void *const buf, const u
     return SDMMC_ERR_NONE;
 }
 
+u32 SDMMC_eraseSectors(const u8 devNum, u32 sect, const u32 count)
+{
+    if (devNum > SDMMC_MAX_DEV_NUM || count == 0)
+        return SDMMC_ERR_INVAL_PARAM;
+
+    // Check if the device is initialized.
+    SdmmcDev *const dev = &g_devs[devNum];
+    const u8 devType = dev->type;
+    if (devType == DEV_TYPE_NONE)
+        return SDMMC_ERR_NO_CARD;
+
+    // Check if the device is write protected.
+    if (dev->prot != 0)
+        return SDMMC_ERR_WRITE_PROT;
+
+    // (e)MMC erases whole erase groups, not only the requested write blocks.
+    // Command class 5 (erase) is mandatory for SD cards but check it anyway.
+    if (IS_DEV_MMC(devType) || (dev->ccc & (1u << 5)) == 0)
+        return SDMMC_ERR_INVAL_PARAM;
+
+    u32 end = sect + count - 1;
+    if (devType == DEV_TYPE_SDSC)
+    {
+        sect *= 512; // Byte addressing.
+        end *= 512;
+    }
+
+    TmioPort *const port = &dev->port;
+    TMIO_setBuffer(port, NULL, 1);
+
+    u32 res = TMIO_sendCommand(port, SD_ERASE_WR_BLK_START, sect);
+    if (res == 0)
+        res = TMIO_sendCommand(port, SD_ERASE_WR_BLK_END, end);
+    if (res == 0)
+    {
+        // Same data timeout hack as in SDMMC_lockUnlock(). The card signals
+        // busy until the erase is done, which can take a long time.
+        const u16 clk_ctrl_backup = port->sd_clk_ctrl;
+        TMIO_setClock(port, 130913);
+        res = TMIO_sendCommand(port, SD_ERASE, 0); // arg = 0 is erase.
+        port->sd_clk_ctrl = clk_ctrl_backup;
+    }
+
+    if (res != 0)
+    {
+        updateStatus(dev, false);
+        return SDMMC_ERR_ERASE;
+    }
+
+    return SDMMC_ERR_NONE;
+}
+
 u32 SDMMC_sendCommand(const u8 devNum, MmcCommand *const mmcCmd)
 {
     if (devNum > SDMMC_MAX_DEV_NUM)
@@ -47,6 +47,7 @@ void storageMsgHandler(int bytes, void *user_data)
         case SDMMC_SD_WRITE_SECTORS:
         case SDMMC_NAND_READ_SECTORS:
         case SDMMC_NAND_WRITE_SECTORS:
+        case SDMMC_SD_TRIM_SECTORS:
             if (isDSiMode())
                 retval = sdmmcMsgHandler(bytes, user_data, &msg);
             break;
@@ -84,6 +85,22 @@ void storageMsgHandler(int bytes, void *user_data)
                 libndsCrash("Write with no DLDI");
             }
             break;
+
+        case DLDI_TRIM_SECTORS:
+            if (dldi_io)
+            {
+                if (dldi_io->features & FEATURE_MEDIUM_CANTRIM)
+                {
+                    retval = dldi_io->trimSectors(msg.sdParams.startsector,
+                                                  msg.sdParams.numsectors);
+                }
+            }
+            else
+            {
+                libndsCrash("Trim with no DLDI");
+            }
+            break;
+
         case SLOT1_CARD_READ:
             cardRead(msg.cardParams.buffer,
                      msg.cardParams.offset,
@@ -114,6 +131,7 @@ void storageValueHandler(u32 value, void *user_data)
         case SDMMC_NAND_STOP:
         case SDMMC_NAND_STATUS:
         case SDMMC_NAND_SIZE:
+        case SDMMC_SD_ERASE_BLOCK_SIZE:
             if (isDSiMode())
                 result = sdmmcValueHandler(value, user_data);
             break;
@@ -3,6 +3,7 @@
 // Copyright (c) 2023 Antonio Niño Díaz
 
 #include <stddef.h>
+#include <string.h>
 
 #include <nds.h>
 #include <nds/ndma.h>
@@ -11,48 +12,106 @@
 
 #define NDMA_CHANNEL 1
 
-static u32 sdmmcReadSectors(const u8 devNum, u32 sect, u8 *buf, u32 count)
+// The block count register of the controller is 16 bit wide. Requests bigger
+// than this are split into several back-to-back multi-block commands.
+#define SDMMC_MAX_BLOCKS    0x8000
+
+// Buffers that aren't word-aligned can't be accessed by NDMA directly. They are
+// transferred through this buffer so that NDMA can always be used, and the
+// transfers are kept as multi-block commands of this size.
+#define BOUNCE_SECTORS      4
+
+ALIGN(4) static u8 bounce_buffer[BOUNCE_SECTORS * 512];
+
+static void ndmaStart(u32 dst, u32 src, u32 count, bool read)
 {
-#ifdef NDMA_CHANNEL
-    if (!(((uintptr_t) buf) & 0x3))
+    NDMA_SRC(NDMA_CHANNEL) = src;
+    NDMA_DEST(NDMA_CHANNEL) = dst;
+    NDMA_LENGTH(NDMA_CHANNEL) = (count * 512) / 4;
+    NDMA_BLENGTH(NDMA_CHANNEL) = 512 / 4;
+    NDMA_BDELAY(NDMA_CHANNEL) = NDMA_BDELAY_DIV_1 | NDMA_BDELAY_CYCLES(0);
+    NDMA_CR(NDMA_CHANNEL) = NDMA_ENABLE | NDMA_BLOCK_SCALER(4) | NDMA_START_SDMMC
+                            | (read ? (NDMA_SRC_FIX | NDMA_DST_INC)
+                                    : (NDMA_SRC_INC | NDMA_DST_FIX));
+}
+
+static void ndmaStop(u32 result)
+{
+    // The controller signals the end of the transfer before the last block has
+    // been read from the FIFO, so the channel needs to be allowed to finish.
+    // It stops by itself after copying all the blocks. If there has been an
+    // error it won't get any more requests, so it has to be stopped manually.
+    if (result == 0)
     {
-        NDMA_SRC(NDMA_CHANNEL) = (u32) getTmioFifo(getTmioRegs(0));
-        NDMA_DEST(NDMA_CHANNEL) = (u32) buf;
-        NDMA_BLENGTH(NDMA_CHANNEL) = 512 / 4;
-        NDMA_BDELAY(NDMA_CHANNEL) = NDMA_BDELAY_DIV_1 | NDMA_BDELAY_CYCLES(0);
-        NDMA_CR(NDMA_CHANNEL) = NDMA_ENABLE | NDMA_REPEAT | NDMA_BLOCK_SCALER(4)
-                                | NDMA_SRC_FIX | NDMA_DST_INC | NDMA_START_SDMMC;
-        u32 result = SDMMC_readSectors(devNum, sect, NULL, count);
-        NDMA_CR(NDMA_CHANNEL) = 0;
-        return result;
+        while (NDMA_CR(NDMA_CHANNEL) & NDMA_BUSY);
     }
-    else
-#endif
+
+    NDMA_CR(NDMA_CHANNEL) = 0;
+}
+
+static u32 sdmmcReadSectors(const u8 devNum, u32 sect, u8 *buf, u32 count)
+{
+    if (count == 0)
+        return SDMMC_ERR_INVAL_PARAM;
+
+    const bool aligned = (((uintptr_t) buf) & 0x3) == 0;
+    const u32 max_blocks = aligned ? SDMMC_MAX_BLOCKS : BOUNCE_SECTORS;
+
+    while (count > 0)
     {
-        return SDMMC_readSectors(devNum, sect, buf, count);
+        u32 blocks = count > max_blocks ? max_blocks : count;
+
+        u8 *dst = aligned ? buf : bounce_buffer;
+        ndmaStart((u32) dst, (u32) getTmioFifo(getTmioRegs(0)), blocks, true);
+        u32 result = SDMMC_readSectors(devNum, sect, NULL, blocks);
+        ndmaStop(result);
+
+        if (result != 0)
+            return result;
+
+        if (!aligned)
+            memcpy(buf, bounce_buffer, blocks * 512);
+
+        sect += blocks;
+        buf += blocks * 512;
+        count -= blocks;
     }
+
+    return 0;
 }
 
 static u32 sdmmcWriteSectors(const u8 devNum, u32 sect, const u8 *buf, u32 count)
 {
-#ifdef NDMA_CHANNEL
-    if (!(((uintptr_t) buf) & 0x3))
-    {
-        NDMA_SRC(NDMA_CHANNEL) = (u32) buf;
-        NDMA_DEST(NDMA_CHANNEL) = (u32) getTmioFifo(getTmioRegs(0));
-        NDMA_BLENGTH(NDMA_CHANNEL) = 512 / 4;
-        NDMA_BDELAY(NDMA_CHANNEL) = NDMA_BDELAY_DIV_1 | NDMA_BDELAY_CYCLES(0);
-        NDMA_CR(NDMA_CHANNEL) = NDMA_ENABLE | NDMA_REPEAT | NDMA_BLOCK_SCALER(4)
-                                | NDMA_SRC_INC | NDMA_DST_FIX | NDMA_START_SDMMC;
-        u32 result = SDMMC_writeSectors(devNum, sect, NULL, count);
-        NDMA_CR(NDMA_CHANNEL) = 0;
-        return result;
-    }
-    else
-#endif
+    if (count == 0)
+        return SDMMC_ERR_INVAL_PARAM;
+
+    const bool aligned = (((uintptr_t) buf) & 0x3) == 0;
+    const u32 max_blocks = aligned ? SDMMC_MAX_BLOCKS : BOUNCE_SECTORS;
+
+    while (count > 0)
     {
-        return SDMMC_writeSectors(devNum, sect, buf, count);
+        u32 blocks = count > max_blocks ? max_blocks : count;
+
+        const u8 *src = buf;
+        if (!aligned)
+        {
+            memcpy(bounce_buffer, buf, blocks * 512);
+            src = bounce_buffer;
+        }
+
+        ndmaStart((u32) getTmioFifo(getTmioRegs(0)), (u32) src, blocks, false);
+        u32 result = SDMMC_writeSectors(devNum, sect, NULL, blocks);
+        ndmaStop(result);
+
+        if (result != 0)
+            return result;
+
+        sect += blocks;
+        buf += blocks * 512;
+        count -= blocks;
     }
+
+    return 0;
 }
 
 int sdmmcMsgHandler(int bytes, void *user_data, FifoMessage *msg)
@@ -80,6 +139,10 @@ int sdmmcMsgHandler(int bytes, void *user_data, FifoMessage *msg)
             retval = sdmmcWriteSectors(SDMMC_DEV_eMMC, msg->sdParams.startsector,
                                        msg->sdParams.buffer, msg->sdParams.numsectors);
             break;
+        case SDMMC_SD_TRIM_SECTORS:
+            retval = SDMMC_eraseSectors(SDMMC_DEV_CARD, msg->sdParams.startsector,
+                                        msg->sdParams.numsectors);
+            break;
     }
 
     return retval;
@@ -123,6 +186,10 @@ int sdmmcValueHandler(u32 value, void *user_data)
         case SDMMC_NAND_SIZE:
             result = SDMMC_getSectors(SDMMC_DEV_eMMC);
             break;
+
+        case SDMMC_SD_ERASE_BLOCK_SIZE:
+            result = SDMMC_getEraseBlockSize(SDMMC_DEV_CARD);
+            break;
     }
 
     return result;
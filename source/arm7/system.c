@@ -185,6 +185,9 @@ void systemMsgHandler(int bytes, void *user_data)
         case SYS_SET_ARM7_CONSOLE:
             consoleSetup(msg.setArm7Console.buffer);
             break;
+        case SYS_ARM7_TASK_RUN:
+            arm7TaskMsgHandler(&msg);
+            break;
     }
 }
 
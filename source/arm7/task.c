@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <nds/arm7task.h>
+#include <nds/fifocommon.h>
+#include <nds/fifomessages.h>
+#include <nds/interrupts.h>
+
+#include "arm7/libnds_internal.h"
+
+static Arm7TaskFn arm7_tasks[ARM7_TASK_MAX];
+
+bool arm7TaskRegister(u32 id, Arm7TaskFn fn)
+{
+    if (id >= ARM7_TASK_MAX)
+        return false;
+
+    arm7_tasks[id] = fn;
+    return true;
+}
+
+void arm7TaskMsgHandler(FifoMessage *msg)
+{
+    u32 id = msg->arm7TaskRun.id;
+    u16 ticket = msg->arm7TaskRun.ticket;
+
+    FifoMessage reply;
+    reply.type = SYS_ARM7_TASK_DONE;
+    reply.arm7TaskDone.ticket = ticket;
+    reply.arm7TaskDone.result = 0;
+    reply.arm7TaskDone.status = 0;
+
+    Arm7TaskFn fn = (id < ARM7_TASK_MAX) ? arm7_tasks[id] : NULL;
+
+    if (fn == NULL)
+    {
+        reply.arm7TaskDone.status = 1;
+    }
+    else
+    {
+        // Don't let other FIFO messages interrupt the task, like in the
+        // handlers of storage requests. Other interrupts are still allowed.
+        int oldIME = enterCriticalSection();
+        REG_IE &= ~(IRQ_FIFO_NOT_EMPTY | IRQ_FIFO_EMPTY);
+        leaveCriticalSection(oldIME);
+
+        reply.arm7TaskDone.result = fn(msg->arm7TaskRun.args,
+                                       msg->arm7TaskRun.size);
+
+        oldIME = enterCriticalSection();
+        REG_IE |= IRQ_FIFO_NOT_EMPTY | IRQ_FIFO_EMPTY;
+        leaveCriticalSection(oldIME);
+    }
+
+    fifoSendDatamsg(FIFO_SYSTEM, sizeof(reply), (u8 *)&reply);
+}
@@ -80,7 +80,10 @@ DIR *opendir(const char *name)
 
         FRESULT result = f_opendir(dp, name);
         if (result == FR_OK)
+        {
+            fatfs_object_opened(&dp->obj);
             return dirp;
+        }
 
         errno = fatfs_error_to_posix(result);
     }
@@ -101,6 +104,7 @@ int closedir(DIR *dirp)
     {
         DIRff *dp = dirp->dp;
 
+        fatfs_object_closed(&dp->obj);
         result = f_closedir(dp);
     }
 
@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -13,11 +14,15 @@
 
 #include "fat.h"
 #include "ff.h"
+#include "diskio.h"
 #include "fatfs/cache.h"
 #include "filesystem_internal.h"
 
 #define DEFAULT_SECTORS_PER_PAGE    8 // Each sector is 512 bytes
 
+#define FORMAT_WORK_BUFFER_SIZE     (32 * 1024)
+#define FORMAT_MAX_CLUSTER_SIZE     (32 * 1024)
+
 // Devices: "fat:/", "sd:/"
 static FATFS fs_info[FF_VOLUMES] = { 0 };
 
@@ -26,6 +31,21 @@ static const char *sd_drive = "sd:/";
 
 static bool fat_initialized = false;
 
+// Number of files and directories open in each volume
+static uint32_t fs_open_objects[FF_VOLUMES] = { 0 };
+
+void fatfs_object_opened(const FFOBJID *obj)
+{
+    fs_open_objects[obj->fs->pdrv]++;
+}
+
+// This must be called before f_close() or f_closedir(), they clear the pointer
+// to the filesystem of the object.
+void fatfs_object_closed(const FFOBJID *obj)
+{
+    fs_open_objects[obj->fs->pdrv]--;
+}
+
 int fatfs_error_to_posix(FRESULT error)
 {
     // The following errno codes have been picked so that they make some sort of
@@ -253,8 +273,8 @@ bool fatInit(int32_t cache_size_pages, bool set_as_default_device)
 
     char *default_cwd = fatGetDefaultCwd();
 
-    // Initialize read cache, shared by all filesystems
-    // ------------------------------------------------
+    // Initialize read cache, split between all filesystems
+    // ----------------------------------------------------
 
     int32_t cache_size_sectors = cache_size_pages * DEFAULT_SECTORS_PER_PAGE;
 
@@ -310,6 +330,7 @@ bool fatInit(int32_t cache_size_pages, bool set_as_default_device)
             errno = fatfs_error_to_posix(result);
             goto cleanup;
         }
+        bool sd_mounted = result == FR_OK;
 
         // Try to initialize DLDI
         result = f_mount(&fs_info[0], fat_drive, 1);
@@ -318,6 +339,10 @@ bool fatInit(int32_t cache_size_pages, bool set_as_default_device)
             errno = fatfs_error_to_posix(result);
             goto cleanup;
         }
+        bool fat_mounted = result == FR_OK;
+
+        // Don't reserve cache entries for a drive that isn't available.
+        cache_set_volumes((fat_mounted ? (1 << 0) : 0) | (sd_mounted ? (1 << 1) : 0));
     }
     else
     {
@@ -329,6 +354,9 @@ bool fatInit(int32_t cache_size_pages, bool set_as_default_device)
             goto cleanup;
         }
 
+        // The internal SD slot doesn't exist, give all the cache to DLDI.
+        cache_set_volumes(1 << 0);
+
         default_drive = fat_drive;
     }
 
@@ -388,3 +416,86 @@ int fatInitLookupCache(int fd, uint32_t max_buffer_size)
 
     return 0;
 }
+
+int fatFormat(const char *drive)
+{
+    BYTE pdrv;
+
+    if (strncmp(drive, fat_drive, strlen("fat:")) == 0)
+    {
+        pdrv = 0;
+    }
+    else if (strncmp(drive, sd_drive, strlen("sd:")) == 0)
+    {
+        pdrv = 1;
+    }
+    else
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Formatting the drive would leave any open file or directory pointing to
+    // the old filesystem.
+    if (fs_open_objects[pdrv] != 0)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (disk_initialize(pdrv) != 0)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    DWORD erase_block;
+    if (disk_ioctl(pdrv, GET_BLOCK_SIZE, &erase_block) != RES_OK || erase_block == 0)
+        erase_block = 1;
+
+    // FatFs can only align the data area to a power of two, up to 32768
+    // sectors. Some AU sizes (12 MB and 24 MB) aren't powers of two, so use the
+    // biggest power of two that divides them.
+    DWORD align = erase_block & -erase_block;
+    if (align > 32768)
+        align = 32768;
+
+    // Clusters must not cross erase block boundaries, so they need to divide
+    // the alignment of the data area. If it isn't known, let FatFs decide.
+    DWORD au_size = 0;
+    if (align > 1)
+    {
+        au_size = align * FF_MAX_SS;
+        if (au_size > FORMAT_MAX_CLUSTER_SIZE)
+            au_size = FORMAT_MAX_CLUSTER_SIZE;
+    }
+
+    void *work = malloc(FORMAT_WORK_BUFFER_SIZE);
+    if (work == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    MKFS_PARM opt = { FM_ANY, 2, align, 0, au_size };
+    FRESULT result = f_mkfs(drive, &opt, work, FORMAT_WORK_BUFFER_SIZE);
+    if (result == FR_MKFS_ABORTED && au_size != 0)
+    {
+        // The cluster size isn't valid for any FAT type with this volume size.
+        opt.au_size = 0;
+        result = f_mkfs(drive, &opt, work, FORMAT_WORK_BUFFER_SIZE);
+    }
+
+    free(work);
+
+    // Nothing cached from the old filesystem is valid anymore.
+    cache_sector_invalidate(pdrv, 0, UINT32_MAX);
+
+    if (result != FR_OK)
+    {
+        errno = fatfs_error_to_posix(result);
+        return -1;
+    }
+
+    return 0;
+}
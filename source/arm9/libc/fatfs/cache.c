@@ -12,11 +12,20 @@
 typedef struct
 {
     uint8_t  valid;
-    uint8_t  pdrv;
     LBA_t    sector;
     uint32_t used_at;
 } cache_entry_t;
 
+// Each volume gets its own range of cache entries with its own LRU state, so
+// that accessing one volume doesn't evict the sectors of the other one, and so
+// that two threads accessing different volumes never get the same entry.
+typedef struct
+{
+    uint32_t first;         // Index of the first entry of this volume
+    uint32_t num_sectors;   // Number of entries of this volume
+    uint32_t usage_counter;
+} cache_volume_t;
+
 #if FF_MAX_SS != FF_MIN_SS
 #error "This code expects a fixed sector size"
 #endif
@@ -25,7 +34,7 @@ static cache_entry_t *cache_entries;
 static uint8_t *cache_mem;
 static uint32_t cache_num_sectors;
 static uint32_t dldi_stub_space_sectors;
-static uint32_t usage_counter = 0;
+static cache_volume_t cache_volumes[FF_VOLUMES];
 
 extern uint8_t *dldiGetStubDataEnd(void);
 extern uint8_t *dldiGetStubEnd(void);
@@ -37,6 +46,52 @@ bool cache_initialized(void)
     return false;
 }
 
+void cache_set_volumes(uint32_t volume_mask)
+{
+    uint32_t num_volumes = 0;
+    for (int i = 0; i < FF_VOLUMES; i++)
+    {
+        if (volume_mask & (1 << i))
+            num_volumes++;
+    }
+
+    // Every volume gets at least one entry, even if it isn't in use, so that
+    // cache_sector_borrow() always has a buffer to return (fatFormat() uses it
+    // with volumes that may not be mounted). The rest of
+    // the entries are split evenly between the volumes in use, and the first
+    // one gets the remainder.
+    uint32_t spare = 0;
+    if (cache_num_sectors > FF_VOLUMES)
+        spare = cache_num_sectors - FF_VOLUMES;
+
+    uint32_t first = 0;
+    bool remainder_given = false;
+    for (int i = 0; i < FF_VOLUMES; i++)
+    {
+        cache_volume_t *volume = &(cache_volumes[i]);
+
+        uint32_t num_sectors = (first < cache_num_sectors) ? 1 : 0;
+        if ((volume_mask & (1 << i)) && (num_volumes > 0))
+        {
+            num_sectors += spare / num_volumes;
+            if (!remainder_given)
+            {
+                num_sectors += spare % num_volumes;
+                remainder_given = true;
+            }
+        }
+
+        volume->first = first;
+        volume->num_sectors = num_sectors;
+        volume->usage_counter = 0;
+
+        first += num_sectors;
+    }
+
+    for (uint32_t i = 0; i < cache_num_sectors; i++)
+        cache_entries[i].valid = 0;
+}
+
 int cache_init(int32_t num_sectors)
 {
     // If this function is called after the first time, clear the cache and
@@ -87,6 +142,9 @@ int cache_init(int32_t num_sectors)
         cache_num_sectors = 0;
     }
 
+    // Until it's known which volumes are in use, assume all of them are.
+    cache_set_volumes((1 << FF_VOLUMES) - 1);
+
     return 0;
 }
 
@@ -100,17 +158,19 @@ static void *cache_sector_address(uint32_t i)
 
 void *cache_sector_get(uint8_t pdrv, uint32_t sector)
 {
-    for (uint32_t i = 0; i < cache_num_sectors; i++)
+    cache_volume_t *volume = &(cache_volumes[pdrv]);
+
+    for (uint32_t i = volume->first; i < volume->first + volume->num_sectors; i++)
     {
         cache_entry_t *entry = &(cache_entries[i]);
 
         if (entry->valid == 0)
             continue;
 
-        if ((entry->pdrv != pdrv) || (entry->sector != sector))
+        if (entry->sector != sector)
             continue;
 
-        entry->used_at = usage_counter++;
+        entry->used_at = volume->usage_counter++;
 
         return cache_sector_address(i);
     }
@@ -118,14 +178,20 @@ void *cache_sector_get(uint8_t pdrv, uint32_t sector)
     return NULL;
 }
 
-void *cache_sector_add(uint8_t pdrv, uint32_t sector)
+static void *cache_sector_add_internal(uint8_t pdrv, uint32_t sector, bool borrow)
 {
+    cache_volume_t *volume = &(cache_volumes[pdrv]);
+
+    // The cache is too small to give an entry to this volume
+    if (volume->num_sectors == 0)
+        return NULL;
+
     uint32_t used_at_difference = 0;
-    uint32_t selected_entry = 0;
+    uint32_t selected_entry = volume->first;
 
     // Assumption: cache_sector_get() has been called,
     // and we know the sector is not present
-    for (uint32_t i = 0; i < cache_num_sectors; i++)
+    for (uint32_t i = volume->first; i < volume->first + volume->num_sectors; i++)
     {
         if (cache_entries[i].valid == 0)
         {
@@ -135,7 +201,7 @@ void *cache_sector_add(uint8_t pdrv, uint32_t sector)
         }
 
         // Check if this entry was least recently used
-        uint32_t i_used_at_difference = usage_counter - cache_entries[i].used_at;
+        uint32_t i_used_at_difference = volume->usage_counter - cache_entries[i].used_at;
         if (i_used_at_difference > used_at_difference)
         {
             used_at_difference = i_used_at_difference;
@@ -145,12 +211,11 @@ void *cache_sector_add(uint8_t pdrv, uint32_t sector)
 
     cache_entry_t *entry = &(cache_entries[selected_entry]);
 
-    if (pdrv != 0xFF)
+    if (!borrow)
     {
-        entry->pdrv = pdrv;
         entry->valid = 1;
         entry->sector = sector;
-        entry->used_at = usage_counter++;
+        entry->used_at = volume->usage_counter++;
     }
     else
     {
@@ -160,16 +225,28 @@ void *cache_sector_add(uint8_t pdrv, uint32_t sector)
     return cache_sector_address(selected_entry);
 }
 
+void *cache_sector_add(uint8_t pdrv, uint32_t sector)
+{
+    return cache_sector_add_internal(pdrv, sector, false);
+}
+
+void *cache_sector_borrow(uint8_t pdrv)
+{
+    return cache_sector_add_internal(pdrv, 0, true);
+}
+
 void cache_sector_invalidate(uint8_t pdrv, uint32_t sector_from, uint32_t sector_to)
 {
-    for (uint32_t i = 0; i < cache_num_sectors; i++)
+    cache_volume_t *volume = &(cache_volumes[pdrv]);
+
+    for (uint32_t i = volume->first; i < volume->first + volume->num_sectors; i++)
     {
         cache_entry_t *entry = &(cache_entries[i]);
 
         if (entry->valid == 0)
             continue;
 
-        if ((entry->pdrv != pdrv) || (entry->sector < sector_from) || (entry->sector > sector_to))
+        if ((entry->sector < sector_from) || (entry->sector > sector_to))
             continue;
 
         entry->valid = 0;
@@ -16,12 +16,16 @@ void *cache_sector_add(uint8_t pdrv, uint32_t sector);
 void cache_sector_invalidate(uint8_t pdrv, uint32_t sector_from, uint32_t sector_to);
 
 /**
- * "Borrow" an unused cache entry to use as a write buffer.
+ * Split the cache between the volumes set in the mask (bit N is volume N).
+ * Volumes that aren't set still get one entry for cache_sector_borrow(). All
+ * cached sectors are invalidated.
  */
-__attribute__((always_inline))
-static inline void *cache_sector_borrow(void)
-{
-    return cache_sector_add(0xFF, 0);
-}
+void cache_set_volumes(uint32_t volume_mask);
+
+/**
+ * "Borrow" an unused cache entry of a volume to use as a write buffer.
+ * It returns NULL if the cache doesn't have any entry for the volume.
+ */
+void *cache_sector_borrow(uint8_t pdrv);
 
 #endif // FATFS_CACHE_H__
@@ -178,7 +178,9 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
 
             if (!cacheable)
             {
-                void *cache = cache_sector_borrow();
+                void *cache = cache_sector_borrow(pdrv);
+                if (cache == NULL)
+                    return RES_ERROR;
 
                 while (count > 0)
                 {
@@ -203,6 +205,8 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
                     if (cache == NULL)
                     {
                         cache = cache_sector_add(pdrv, sector);
+                        if (cache == NULL)
+                            return RES_ERROR;
 
                         if (!io->readSectors(sector, 1, cache))
                         {
@@ -258,16 +262,15 @@ DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
 #endif
             {
                 // DLDI drivers expect a 4-byte aligned buffer.
-                uint8_t *align_buffer = cache_sector_borrow();
+                uint8_t *align_buffer = cache_sector_borrow(pdrv);
+                if (align_buffer == NULL)
+                    return RES_ERROR;
 
                 while (count > 0)
                 {
                     __aeabi_memcpy(align_buffer, buff, FF_MAX_SS);
                     if (!io->writeSectors(sector, 1, align_buffer))
-                    {
-                        free(align_buffer);
                         return RES_ERROR;
-                    }
 
                     count--;
                     sector++;
@@ -300,24 +303,74 @@ DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
 // buff: Buffer to send/receive control data
 DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 {
-    (void)buff;
-
     if (!fs_initialized[pdrv])
         return RES_NOTRDY;
 
-    // Only CTRL_SYNC is needed for now:
-    // - GET_SECTOR_COUNT: Used by f_mkfs and f_fdisk.
-    // - GET_SECTOR_SIZE: Required only if FF_MAX_SS > FF_MIN_SS.
-    // - GET_BLOCK_SIZE: Used by f_mkfs.
-    // - CTRL_TRIM: Required when FF_USE_TRIM == 1.
+    // GET_SECTOR_SIZE isn't needed, it's only required if FF_MAX_SS > FF_MIN_SS.
 
     switch (pdrv)
     {
         case DEV_DLDI:
         case DEV_SD:
-            // This command flushes the cache, but there is no cache right now
             if (cmd == CTRL_SYNC)
+            {
+                // The DSi SD driver combines adjacent writes before sending
+                // them to the card. Make sure that they have been written.
+                if (pdrv == DEV_SD && !sdmmc_Flush())
+                    return RES_ERROR;
+
                 return RES_OK;
+            }
+
+            if (cmd == CTRL_TRIM)
+            {
+                // Drivers need to opt in. This is only a hint, so it's fine to
+                // not support it.
+                const DISC_INTERFACE *io = fs_io[pdrv];
+                if (!(io->features & FEATURE_MEDIUM_CANTRIM))
+                    return RES_PARERR;
+
+                // Start and end sectors, inclusive.
+                const LBA_t *range = buff;
+                if (range[1] < range[0])
+                    return RES_PARERR;
+
+                cache_sector_invalidate(pdrv, range[0], range[1]);
+
+                if (!io->trimSectors(range[0], range[1] - range[0] + 1))
+                    return RES_ERROR;
+
+                return RES_OK;
+            }
+
+            if (cmd == GET_SECTOR_COUNT)
+            {
+                // DLDI drivers have no way to report the size of the device.
+                if (pdrv != DEV_SD)
+                    return RES_PARERR;
+
+                LBA_t sectors = sdmmc_GetSectors();
+                if (sectors == 0)
+                    return RES_ERROR;
+
+                *(LBA_t *)buff = sectors;
+                return RES_OK;
+            }
+
+            if (cmd == GET_BLOCK_SIZE)
+            {
+                // Erase block size in sectors, 1 if unknown.
+                DWORD size = 1;
+                if (pdrv == DEV_SD)
+                {
+                    size = sdmmc_GetEraseBlockSize();
+                    if (size == 0)
+                        size = 1;
+                }
+
+                *(DWORD *)buff = size;
+                return RES_OK;
+            }
 
             return RES_PARERR;
 
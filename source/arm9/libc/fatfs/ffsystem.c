@@ -70,8 +70,11 @@ int ff_mutex_take (	/* Returns 1:Succeeded or 0:Timeout */
 	int vol			/* Mutex ID: Volume mutex (0 to FF_VOLUMES - 1) or system mutex (FF_VOLUMES) */
 )
 {
+	// Each volume has its own mutex, so threads that access the same volume
+	// wait for their turn, and accesses to different volumes can overlap.
 	// TODO: Implement timeout.
-	return comutex_try_acquire(&Mutex[vol]);
+	comutex_acquire(&Mutex[vol]);
+	return 1;
 }
 
 
@@ -15,4 +15,8 @@
 int fatfs_error_to_posix(FRESULT error);
 uint32_t fatfs_timestamp_to_fattime(struct tm *stm);
 
+// Keep track of the files and directories open in each volume
+void fatfs_object_opened(const FFOBJID *obj);
+void fatfs_object_closed(const FFOBJID *obj);
+
 #endif // FATFS_INTERNAL_H__
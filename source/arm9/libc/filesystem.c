@@ -126,7 +126,10 @@ int open(const char *path, int flags, ...)
     FRESULT result = f_open(fp, path, mode);
 
     if (result == FR_OK)
+    {
+        fatfs_object_opened(&fp->obj);
         return (int)fp;
+    }
 
     errno = fatfs_error_to_posix(result);
     return -1;
@@ -188,6 +191,8 @@ int close(int fd)
 
     FIL *fp = (FIL *)fd;
 
+    fatfs_object_closed(&fp->obj);
+
     FRESULT result = f_close(fp);
 
     if (fp->cltbl != NULL)
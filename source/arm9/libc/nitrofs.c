@@ -18,6 +18,7 @@
 #include <nds/arm9/sassert.h>
 #include <nds/arm9/dldi.h>
 #include <nds/card.h>
+#include <nds/cothread.h>
 #include <nds/memory.h>
 #include <nds/system.h>
 
@@ -59,6 +60,18 @@ extern char __dtcm_start[];
 const uintptr_t DTCM_START = (uintptr_t)__dtcm_start;
 const uintptr_t DTCM_END   = DTCM_START + (16 * 1024) - 1;
 
+#if FF_MAX_SS != FF_MIN_SS
+#error "This code expects a fixed sector size"
+#endif
+
+// The ARM7 can't write to DTCM, so reads to DTCM go through this buffer in main
+// RAM. It isn't shared with the FatFs cache: a FatFs thread may be using a cache
+// entry as a DLDI buffer while it waits for the ARM7. The mutex protects it
+// from other threads that read from NitroFS at the same time, as card reads
+// yield while they wait for the ARM7.
+ALIGN(32) static uint8_t nitrofs_bounce_buffer[FF_MAX_SS];
+static comutex_t nitrofs_bounce_mutex;
+
 static ssize_t nitrofs_read_internal(void *ptr, size_t offset, size_t len)
 {
     if (nitrofs_local.file)
@@ -80,28 +93,28 @@ static ssize_t nitrofs_read_internal(void *ptr, size_t offset, size_t len)
             if ((uintptr_t)ptr >= DTCM_START && (uintptr_t)ptr < DTCM_END)
             {
                 // The destination is in DTCM
-
-                void *cache = cache_sector_borrow();
-
-#if FF_MAX_SS != FF_MIN_SS
-#error "This code expects a fixed sector size"
-#endif
                 uint8_t *buff = ptr;
+                size_t total = len;
+
+                comutex_acquire(&nitrofs_bounce_mutex);
 
                 while (len > 0)
                 {
                     size_t read_size = len > FF_MAX_SS ? FF_MAX_SS : len;
 
-                    cardReadArm7(cache, offset, read_size, __NDSHeader->cardControl13);
+                    cardReadArm7(nitrofs_bounce_buffer, offset, read_size,
+                                 __NDSHeader->cardControl13);
 
-                    __aeabi_memcpy(buff, cache, read_size);
+                    __aeabi_memcpy(buff, nitrofs_bounce_buffer, read_size);
 
                     len -= read_size;
                     offset += read_size;
                     buff += read_size;
                 }
 
-                return len;
+                comutex_release(&nitrofs_bounce_mutex);
+
+                return total;
             }
             else
             {
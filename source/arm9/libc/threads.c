@@ -30,8 +30,16 @@ int thrd_create(thrd_t *thr, thrd_start_t func, void *arg)
 
 int thrd_join(thrd_t thr, int *res)
 {
+    // The scheduler wakes up any thread blocked on a thread when it ends
+    errno = 0;
     while (!cothread_has_joined(thr))
-        cothread_yield();
+    {
+        // The thread doesn't exist
+        if (errno != 0)
+            return thrd_error;
+
+        cothread_block_on((void *)thr);
+    }
 
     if (res != NULL)
         *res = cothread_get_exit_code(thr);
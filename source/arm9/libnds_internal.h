@@ -9,11 +9,14 @@
 
 #include <nds/arm9/console.h>
 #include <nds/arm9/input.h>
+#include <nds/fifomessages.h>
 
 extern ConsoleOutFn libnds_stdout_write, libnds_stderr_write;
 
 void setTransferInputData(touchPosition *touch, u16 buttons);
 
+void arm7TaskResultHandler(FifoMessage *msg);
+
 extern time_t *punixTime;
 
 #endif // ARM9_LIBNDS_INTERNAL_H__
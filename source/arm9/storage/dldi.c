@@ -135,6 +135,25 @@ static bool dldi_arm7_shutdown(void)
     return result != 0;
 }
 
+static bool dldi_arm7_trim_sectors(sec_t sector, sec_t numSectors)
+{
+    FifoMessage msg;
+    msg.type = DLDI_TRIM_SECTORS;
+    msg.sdParams.startsector = sector;
+    msg.sdParams.numsectors = numSectors;
+    msg.sdParams.buffer = NULL;
+
+    fifoMutexAcquire(FIFO_STORAGE);
+
+    fifoSendDatamsg(FIFO_STORAGE, sizeof(msg), (u8 *)&msg);
+    fifoWaitValue32Async(FIFO_STORAGE);
+    int result = fifoGetValue32(FIFO_STORAGE);
+
+    fifoMutexRelease(FIFO_STORAGE);
+
+    return result != 0;
+}
+
 // Driver that sends commands to the ARM7 to perform operations
 DISC_INTERFACE __io_dldi_arm7_interface =
 {
@@ -145,7 +164,8 @@ DISC_INTERFACE __io_dldi_arm7_interface =
     &dldi_arm7_read_sectors,
     &dldi_arm7_write_sectors,
     &dldi_arm7_clear_status,
-    &dldi_arm7_shutdown
+    &dldi_arm7_shutdown,
+    &dldi_arm7_trim_sectors
 };
 
 // -----------------------------------------------------------------------------
@@ -276,6 +296,11 @@ void dldiRelocate(DLDI_INTERFACE *io, void *targetAddress)
         (FN_MEDIUM_CLEARSTATUS)((intptr_t)io->ioInterface.clearStatus + offset);
     io->ioInterface.shutdown =
         (FN_MEDIUM_SHUTDOWN)((intptr_t)io->ioInterface.shutdown + offset);
+    if (io->ioInterface.features & FEATURE_MEDIUM_CANTRIM)
+    {
+        io->ioInterface.trimSectors =
+            (FN_MEDIUM_TRIMSECTORS)((intptr_t)io->ioInterface.trimSectors + offset);
+    }
 
     // Fix all addresses with in the DLDI
     if (io->fixSectionsFlags & FIX_ALL)
@@ -3,9 +3,14 @@
 //
 // Copyright (C) 2011-2017 Dave Murphy (WinterMute)
 
+#include <malloc.h>
 #include <stdbool.h>
+#include <string.h>
+
 #include <nds/arm9/cache.h>
+#include <nds/arm9/cp15_asm.h>
 #include <nds/arm9/sdmmc.h>
+#include <nds/cothread.h>
 #include <nds/disc_io.h>
 #include <nds/fifocommon.h>
 #include <nds/fifomessages.h>
@@ -60,6 +65,99 @@ static u32 sdmmc_fifo_sectors(uint32_t cmd, sec_t sector, sec_t numSectors, void
     return result;
 }
 
+// Writes to the SD card that are adjacent to the previous ones are combined in
+// this buffer and sent to the ARM7 as a single multi-block write. Cheap SD cards
+// are much faster with one big write than with many small ones. The pending
+// sectors are written when a write isn't adjacent to them, when the buffer is
+// full, when sdmmc_Flush() is called, and after a few frames without writes.
+//
+// If writing the pending sectors fails they are kept in the buffer, and the
+// error is reported by sdmmc_Flush(). Reads and writes that don't overlap them
+// don't fail because of it.
+#define SDMMC_WRITE_COMBINE_SECTORS 32
+
+// Frames without writes after which the pending sectors are written
+#define SDMMC_WRITE_COMBINE_FRAMES 6
+
+static comutex_t wc_mutex;
+static u8 *wc_buffer;
+static sec_t wc_sector;
+static sec_t wc_count;
+static u32 wc_idle_frames;
+static bool wc_flusher_running;
+
+static bool sdmmc_wc_flush(void)
+{
+    if (wc_count == 0)
+        return true;
+
+    u32 result = sdmmc_fifo_sectors(SDMMC_SD_WRITE_SECTORS, wc_sector, wc_count,
+                                    wc_buffer, true);
+    if (result != 0)
+        return false;
+
+    wc_count = 0;
+    return true;
+}
+
+static bool sdmmc_wc_overlaps(sec_t sector, sec_t numSectors)
+{
+    return (wc_count > 0) && (sector < wc_sector + wc_count)
+           && (wc_sector < sector + numSectors);
+}
+
+// Thread that writes the pending sectors if no more writes arrive in a few
+// frames. It ends when the buffer is empty.
+static int sdmmc_wc_flusher(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        cothread_sleep_frames(1);
+
+        comutex_acquire(&wc_mutex);
+
+        if (wc_count == 0)
+        {
+            wc_flusher_running = false;
+            comutex_release(&wc_mutex);
+            return 0;
+        }
+
+        // If it fails, try again after the same number of frames
+        if (++wc_idle_frames >= SDMMC_WRITE_COMBINE_FRAMES)
+        {
+            wc_idle_frames = 0;
+            sdmmc_wc_flush();
+        }
+
+        comutex_release(&wc_mutex);
+    }
+}
+
+static void sdmmc_wc_start_flusher(void)
+{
+    wc_idle_frames = 0;
+
+    if (wc_flusher_running)
+        return;
+
+    // If the thread can't be created, the sectors stay in the buffer until the
+    // next barrier or non-adjacent access.
+    if (cothread_create(sdmmc_wc_flusher, NULL, 0, COTHREAD_DETACHED) >= 0)
+        wc_flusher_running = true;
+}
+
+bool sdmmc_Flush(void)
+{
+    comutex_acquire(&wc_mutex);
+    bool ret = sdmmc_wc_flush();
+    comutex_release(&wc_mutex);
+
+    return ret;
+}
+
 bool sdmmc_ClearStatus(void)
 {
     return true;
@@ -67,7 +165,7 @@ bool sdmmc_ClearStatus(void)
 
 bool sdmmc_Shutdown(void)
 {
-    return true;
+    return sdmmc_Flush();
 }
 
 u8 nand_GetDiskStatus(void)
@@ -90,6 +188,11 @@ u32 sdmmc_GetSectors(void)
     return sdmmc_fifo_value(SDMMC_SD_SIZE);
 }
 
+u32 sdmmc_GetEraseBlockSize(void)
+{
+    return sdmmc_fifo_value(SDMMC_SD_ERASE_BLOCK_SIZE);
+}
+
 bool nand_Startup(void)
 {
     return sdmmc_fifo_value(SDMMC_NAND_START) == 0;
@@ -120,7 +223,26 @@ bool nand_ReadSectors(sec_t sector, sec_t numSectors, void *buffer)
 
 bool sdmmc_ReadSectors(sec_t sector, sec_t numSectors, void *buffer)
 {
-    return sdmmc_fifo_sectors(SDMMC_SD_READ_SECTORS, sector, numSectors, buffer, false) == 0;
+    comutex_acquire(&wc_mutex);
+
+    bool ret = sdmmc_fifo_sectors(SDMMC_SD_READ_SECTORS, sector, numSectors,
+                                  buffer, false) == 0;
+
+    // Sectors that haven't been written to the card yet are taken from the
+    // write-combining buffer.
+    if (ret && sdmmc_wc_overlaps(sector, numSectors))
+    {
+        sec_t start = (sector > wc_sector) ? sector : wc_sector;
+        sec_t end = (sector + numSectors < wc_sector + wc_count) ?
+                    sector + numSectors : wc_sector + wc_count;
+
+        memcpy((u8 *)buffer + (start - sector) * 512,
+               wc_buffer + (start - wc_sector) * 512, (end - start) * 512);
+    }
+
+    comutex_release(&wc_mutex);
+
+    return ret;
 }
 
 bool nand_WriteSectors(sec_t sector, sec_t numSectors, const void *buffer)
@@ -130,7 +252,89 @@ bool nand_WriteSectors(sec_t sector, sec_t numSectors, const void *buffer)
 
 bool sdmmc_WriteSectors(sec_t sector, sec_t numSectors, const void *buffer)
 {
-    return sdmmc_fifo_sectors(SDMMC_SD_WRITE_SECTORS, sector, numSectors, (void *) buffer, true) == 0;
+    bool ret = true;
+
+    comutex_acquire(&wc_mutex);
+
+    if (wc_buffer == NULL)
+        wc_buffer = memalign(CACHE_LINE_SIZE, SDMMC_WRITE_COMBINE_SECTORS * 512);
+
+    if ((wc_count > 0) && (sector >= wc_sector)
+        && (sector + numSectors <= wc_sector + wc_count))
+    {
+        // Rewrite of sectors that haven't been written yet.
+        memcpy(wc_buffer + (sector - wc_sector) * 512, buffer, numSectors * 512);
+        wc_idle_frames = 0;
+    }
+    else if ((wc_buffer != NULL) && (numSectors < SDMMC_WRITE_COMBINE_SECTORS)
+             && (wc_count > 0) && (sector == wc_sector + wc_count)
+             && (wc_count + numSectors <= SDMMC_WRITE_COMBINE_SECTORS))
+    {
+        // Continuation of the pending sectors.
+        memcpy(wc_buffer + wc_count * 512, buffer, numSectors * 512);
+        wc_count += numSectors;
+        wc_idle_frames = 0;
+    }
+    else
+    {
+        // The pending sectors have to be written first. If that fails they are
+        // kept in the buffer. This write can still go ahead if it doesn't
+        // overlap them, as the order of the two writes doesn't matter then.
+        if (!sdmmc_wc_flush() && sdmmc_wc_overlaps(sector, numSectors))
+        {
+            ret = false;
+        }
+        else if ((wc_buffer == NULL) || (wc_count > 0)
+                 || (numSectors >= SDMMC_WRITE_COMBINE_SECTORS))
+        {
+            // Big writes are sent to the ARM7 right away.
+            ret = sdmmc_fifo_sectors(SDMMC_SD_WRITE_SECTORS, sector, numSectors,
+                                     (void *)buffer, true) == 0;
+        }
+        else
+        {
+            wc_sector = sector;
+            memcpy(wc_buffer, buffer, numSectors * 512);
+            wc_count = numSectors;
+            sdmmc_wc_start_flusher();
+        }
+    }
+
+    comutex_release(&wc_mutex);
+
+    return ret;
+}
+
+bool sdmmc_TrimSectors(sec_t sector, sec_t numSectors)
+{
+    FifoMessage msg;
+    bool ret = true;
+
+    comutex_acquire(&wc_mutex);
+
+    // Pending writes to these sectors must not reach the card after the trim.
+    if (sdmmc_wc_overlaps(sector, numSectors))
+        ret = sdmmc_wc_flush();
+
+    if (ret)
+    {
+        msg.type = SDMMC_SD_TRIM_SECTORS;
+        msg.sdParams.startsector = sector;
+        msg.sdParams.numsectors = numSectors;
+        msg.sdParams.buffer = NULL;
+
+        fifoMutexAcquire(FIFO_STORAGE);
+
+        fifoSendDatamsg(FIFO_STORAGE, sizeof(msg), (u8 *)&msg);
+        fifoWaitValue32Async(FIFO_STORAGE);
+        ret = fifoGetValue32(FIFO_STORAGE) == 0;
+
+        fifoMutexRelease(FIFO_STORAGE);
+    }
+
+    comutex_release(&wc_mutex);
+
+    return ret;
 }
 
 /* const DISC_INTERFACE __io_dsinand = {
@@ -147,13 +351,14 @@ bool sdmmc_WriteSectors(sec_t sector, sec_t numSectors, const void *buffer)
 const DISC_INTERFACE __io_dsisd =
 {
     DEVICE_TYPE_DSI_SD,
-    FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE,
+    FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE | FEATURE_MEDIUM_CANTRIM,
     &sdmmc_Startup,
     &sdmmc_IsInserted,
     &sdmmc_ReadSectors,
     &sdmmc_WriteSectors,
     &sdmmc_ClearStatus,
-    &sdmmc_Shutdown
+    &sdmmc_Shutdown,
+    &sdmmc_TrimSectors
 };
 
 const DISC_INTERFACE *get_io_dsisd(void)
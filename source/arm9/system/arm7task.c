@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <nds/arm7task.h>
+#include <nds/arm9/cache.h>
+#include <nds/arm9/cp15_asm.h>
+#include <nds/arm9/sassert.h>
+#include <nds/cothread.h>
+#include <nds/fifocommon.h>
+#include <nds/fifomessages.h>
+#include <nds/interrupts.h>
+
+#include "arm9/libnds_internal.h"
+
+typedef struct
+{
+    bool used;
+    bool done;
+    u16 status;
+    u32 result;
+    void *args; // Arguments buffer, invalidated when the task ends
+    size_t size;
+} arm7_task_slot_t;
+
+// The "done", "status" and "result" fields are written from the FIFO handler.
+static volatile arm7_task_slot_t arm7_task_slots[ARM7_TASK_PENDING];
+
+void arm7TaskResultHandler(FifoMessage *msg)
+{
+    u16 ticket = msg->arm7TaskDone.ticket;
+
+    if (ticket >= ARM7_TASK_PENDING)
+        return;
+
+    volatile arm7_task_slot_t *slot = &arm7_task_slots[ticket];
+
+    slot->result = msg->arm7TaskDone.result;
+    slot->status = msg->arm7TaskDone.status;
+    slot->done = true;
+}
+
+int arm7TaskCallAsync(u32 id, void *args, size_t size)
+{
+    // The ID is sent as a 16-bit value, check it before it's truncated
+    if (id >= ARM7_TASK_MAX)
+        return -1;
+
+    // The ARM7 writes to the buffer while the ARM9 may be using other data in
+    // the same cache lines, so the buffer can't share them with anything else.
+    if ((args != NULL) && (size > 0))
+    {
+        sassert((((uintptr_t)args | size) & (CACHE_LINE_SIZE - 1)) == 0,
+                "Arguments buffer must be aligned to the cache line size");
+    }
+
+    int ticket = -1;
+
+    int oldIME = enterCriticalSection();
+
+    for (int i = 0; i < ARM7_TASK_PENDING; i++)
+    {
+        if (!arm7_task_slots[i].used)
+        {
+            arm7_task_slots[i].used = true;
+            arm7_task_slots[i].done = false;
+            arm7_task_slots[i].args = args;
+            arm7_task_slots[i].size = size;
+            ticket = i;
+            break;
+        }
+    }
+
+    leaveCriticalSection(oldIME);
+
+    if (ticket == -1)
+        return -1;
+
+    if ((args != NULL) && (size > 0))
+        DC_FlushRange(args, size);
+
+    FifoMessage msg;
+    msg.type = SYS_ARM7_TASK_RUN;
+    msg.arm7TaskRun.args = args;
+    msg.arm7TaskRun.size = size;
+    msg.arm7TaskRun.id = id;
+    msg.arm7TaskRun.ticket = ticket;
+
+    fifoSendDatamsg(FIFO_SYSTEM, sizeof(msg), (u8 *)&msg);
+
+    return ticket;
+}
+
+bool arm7TaskIsDone(int ticket)
+{
+    if ((ticket < 0) || (ticket >= ARM7_TASK_PENDING))
+        return false;
+
+    return arm7_task_slots[ticket].done;
+}
+
+int arm7TaskWait(int ticket, u32 *result)
+{
+    if ((ticket < 0) || (ticket >= ARM7_TASK_PENDING))
+        return -1;
+
+    volatile arm7_task_slot_t *slot = &arm7_task_slots[ticket];
+
+    if (!slot->used)
+        return -1;
+
+    // The reply arrives as a FIFO message
+    while (!slot->done)
+        cothread_yield_irq(IRQ_FIFO_NOT_EMPTY);
+
+    // Discard any line of the buffer that the ARM9 may have loaded into the
+    // cache while the task was running.
+    if ((slot->args != NULL) && (slot->size > 0))
+        DC_InvalidateRange(slot->args, slot->size);
+
+    int ret = (slot->status == 0) ? 0 : -1;
+
+    if (result != NULL)
+        *result = slot->result;
+
+    slot->used = false;
+
+    return ret;
+}
+
+int arm7TaskCall(u32 id, void *args, size_t size, u32 *result)
+{
+    int ticket = arm7TaskCallAsync(id, args, size);
+    if (ticket == -1)
+        return -1;
+
+    return arm7TaskWait(ticket, result);
+}
@@ -70,6 +70,9 @@ void systemMsgHandler(int bytes, void *user_data)
         case SYS_INPUT_MESSAGE:
             setTransferInputData(&(msg.SystemInput.touch), msg.SystemInput.keys);
             break;
+        case SYS_ARM7_TASK_DONE:
+            arm7TaskResultHandler(&msg);
+            break;
     }
 }
 
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <nds/arm9/displaylist.h>
+#include <nds/arm9/sassert.h>
+
+// Number of parameters of each geometry command, indexed by command ID. Unused
+// IDs are left as 0, see glListCommandParams().
+static const s8 gl_list_cmd_params[0x80] = {
+    [0x00] = 0,  // NOP
+    [0x10] = 1,  // MTX_MODE
+    [0x11] = 0,  // MTX_PUSH
+    [0x12] = 1,  // MTX_POP
+    [0x13] = 1,  // MTX_STORE
+    [0x14] = 1,  // MTX_RESTORE
+    [0x15] = 0,  // MTX_IDENTITY
+    [0x16] = 16, // MTX_LOAD_4x4
+    [0x17] = 12, // MTX_LOAD_4x3
+    [0x18] = 16, // MTX_MULT_4x4
+    [0x19] = 12, // MTX_MULT_4x3
+    [0x1A] = 9,  // MTX_MULT_3x3
+    [0x1B] = 3,  // MTX_SCALE
+    [0x1C] = 3,  // MTX_TRANS
+    [0x20] = 1,  // COLOR
+    [0x21] = 1,  // NORMAL
+    [0x22] = 1,  // TEXCOORD
+    [0x23] = 2,  // VTX_16
+    [0x24] = 1,  // VTX_10
+    [0x25] = 1,  // VTX_XY
+    [0x26] = 1,  // VTX_XZ
+    [0x27] = 1,  // VTX_YZ
+    [0x28] = 1,  // VTX_DIFF
+    [0x29] = 1,  // POLYGON_ATTR
+    [0x2A] = 1,  // TEXIMAGE_PARAM
+    [0x2B] = 1,  // PLTT_BASE
+    [0x30] = 1,  // DIF_AMB
+    [0x31] = 1,  // SPE_EMI
+    [0x32] = 1,  // LIGHT_VECTOR
+    [0x33] = 1,  // LIGHT_COLOR
+    [0x34] = 32, // SHININESS
+    [0x40] = 1,  // BEGIN_VTXS
+    [0x41] = 0,  // END_VTXS
+    [0x50] = 1,  // SWAP_BUFFERS
+    [0x60] = 1,  // VIEWPORT
+    [0x70] = 3,  // BOX_TEST
+    [0x71] = 2,  // POS_TEST
+    [0x72] = 1,  // VEC_TEST
+};
+
+int glListCommandParams(u8 command)
+{
+    if (command >= sizeof(gl_list_cmd_params))
+        return -1;
+
+    // Only a few commands take no parameters, any other ID with 0 parameters
+    // in the table isn't a valid command.
+    int params = gl_list_cmd_params[command];
+
+    if ((params == 0) && (command != 0x00) && (command != 0x11) &&
+        (command != 0x15) && (command != 0x41))
+        return -1;
+
+    return params;
+}
+
+bool glListInit(GLDisplayList *list, u32 *buffer, size_t size)
+{
+    // The size word is always needed
+    if ((buffer == NULL) || (size < sizeof(u32)))
+        return false;
+
+    list->data = buffer;
+    list->capacity = size / sizeof(u32);
+
+    glListReset(list);
+
+    return true;
+}
+
+void glListReset(GLDisplayList *list)
+{
+    list->data[0] = 0;
+    list->size = 1;
+    list->header = 0;
+    list->commands = 4; // Force a new header word for the first command
+    list->overflow = false;
+}
+
+bool glListCommand(GLDisplayList *list, u8 command, const u32 *params,
+                   u32 num_params)
+{
+    // A wrong number of parameters would desynchronize the whole list
+    sassert(glListCommandParams(command) == (int)num_params,
+            "Command 0x%02X takes %d parameters, not %d", command,
+            glListCommandParams(command), (int)num_params);
+
+    u32 needed = num_params;
+
+    if (list->commands == 4)
+        needed++;
+
+    if (list->size + needed > list->capacity)
+    {
+        list->overflow = true;
+        return false;
+    }
+
+    if (list->commands == 4)
+    {
+        // Start a new header word. Unused slots are left as NOP, which don't
+        // take any parameter.
+        list->header = list->size;
+        list->data[list->size++] = 0;
+        list->commands = 0;
+    }
+
+    list->data[list->header] |= (u32)command << (list->commands * 8);
+    list->commands++;
+
+    for (u32 i = 0; i < num_params; i++)
+        list->data[list->size++] = params[i];
+
+    return true;
+}
+
+const void *glListFinish(GLDisplayList *list)
+{
+    if (list->overflow)
+        return NULL;
+
+    list->data[0] = list->size - 1;
+
+    return list->data;
+}
+
+int glListDecode(const void *list, GLListDecodeFn callback, void *userdata)
+{
+    const u32 *ptr = list;
+    u32 remaining = *ptr++;
+    int count = 0;
+
+    while (remaining > 0)
+    {
+        u32 header = *ptr++;
+        remaining--;
+
+        for (int i = 0; i < 4; i++)
+        {
+            u8 command = (header >> (i * 8)) & 0xFF;
+
+            int num_params = glListCommandParams(command);
+            if (num_params < 0)
+                return -1;
+
+            if ((u32)num_params > remaining)
+                return -1;
+
+            if (command != 0x00)
+            {
+                if (callback != NULL)
+                    callback(command, ptr, num_params, userdata);
+                count++;
+            }
+
+            ptr += num_params;
+            remaining -= num_params;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <nds/arm9/cache.h>
+#include <nds/arm9/displaylist.h>
+#include <nds/arm9/sassert.h>
+#include <nds/cothread.h>
+#include <nds/dma.h>
+#include <nds/interrupts.h>
+
+// Display lists are sent with DMA channel 0 in GX FIFO mode, like with
+// glCallList(). The DMA interrupt is used to start the next list of the queue.
+// The callbacks of the lists that have been sent are run later with
+// cothread_defer(), so the interrupt handler stays short.
+
+typedef struct
+{
+    const u32 *data;
+    u32 count;
+    u32 fence;
+    GLListDoneFn callback;
+    void *userdata;
+} gl_list_queue_entry_t;
+
+static gl_list_queue_entry_t gl_list_queue[GL_LIST_QUEUE_SIZE];
+
+// Modified from the DMA interrupt handler
+static volatile u32 gl_list_queue_done; // Entry with the next callback to run
+static volatile u32 gl_list_queue_head; // Entry being sent
+static volatile u32 gl_list_queue_tail; // Next free entry
+static volatile bool gl_list_queue_deferred; // Callbacks waiting to be run
+static volatile bool gl_list_queue_busy;
+static volatile bool gl_list_queue_stalled; // Next list waiting to be started
+static volatile u32 gl_list_fence_completed;
+
+static u32 gl_list_fence_issued;
+
+// Starts the transfer of the list at the head of the queue. Same workaround as
+// glCallList(): the transfer can't start while other channels are active, so
+// it returns false in that case.
+static bool glListQueueStartHead(void)
+{
+    if (dmaBusy(1) || dmaBusy(2) || dmaBusy(3))
+        return false;
+
+    gl_list_queue_entry_t *entry = &gl_list_queue[gl_list_queue_head];
+
+    dmaSetParams(0, entry->data, (void *)&GFX_FIFO,
+                 DMA_FIFO | DMA_IRQ_REQ | entry->count);
+
+    return true;
+}
+
+// Starts the next list if the interrupt handler couldn't do it. This is only
+// called from threads, never from the interrupt handler, because waiting for
+// other channels can take forever if they are repeating transfers.
+static void glListQueueResume(void)
+{
+    if (!gl_list_queue_stalled)
+        return;
+
+    while (dmaBusy(1) || dmaBusy(2) || dmaBusy(3));
+
+    int oldIME = enterCriticalSection();
+
+    if (gl_list_queue_stalled && glListQueueStartHead())
+        gl_list_queue_stalled = false;
+
+    leaveCriticalSection(oldIME);
+}
+
+// Runs the callbacks of all lists that have been sent, in order, and releases
+// their entries. Normally it is deferred to the scheduler by the interrupt
+// handler.
+static void glListQueueRunCallbacks(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        int oldIME = enterCriticalSection();
+
+        // The interrupt handler doesn't release entries or defer this function
+        // again until the flag is cleared.
+        if (gl_list_queue_done == gl_list_queue_head)
+        {
+            gl_list_queue_deferred = false;
+            leaveCriticalSection(oldIME);
+            break;
+        }
+
+        gl_list_queue_entry_t *entry = &gl_list_queue[gl_list_queue_done];
+
+        GLListDoneFn callback = entry->callback;
+        void *userdata = entry->userdata;
+        const void *list = entry->data - 1;
+
+        gl_list_queue_done = (gl_list_queue_done + 1) % GL_LIST_QUEUE_SIZE;
+
+        leaveCriticalSection(oldIME);
+
+        if (callback != NULL)
+            callback(list, userdata);
+    }
+}
+
+static void glListQueueHandler(void)
+{
+    if (!gl_list_queue_busy || gl_list_queue_stalled)
+        return;
+
+    gl_list_queue_entry_t *entry = &gl_list_queue[gl_list_queue_head];
+
+    gl_list_fence_completed = entry->fence;
+    gl_list_queue_head = (gl_list_queue_head + 1) % GL_LIST_QUEUE_SIZE;
+
+    if (gl_list_queue_head == gl_list_queue_tail)
+        gl_list_queue_busy = false;
+    else if (!glListQueueStartHead())
+        gl_list_queue_stalled = true;
+
+    // Entries without a callback can be released right away if there aren't
+    // callbacks of older entries waiting to be run.
+    if ((entry->callback == NULL) && !gl_list_queue_deferred)
+    {
+        gl_list_queue_done = gl_list_queue_head;
+        return;
+    }
+
+    if (gl_list_queue_deferred)
+        return;
+
+    gl_list_queue_deferred = true;
+
+    // If the queue of deferred work is full, run the callbacks here
+    if (!cothread_defer(glListQueueRunCallbacks, NULL))
+        glListQueueRunCallbacks(NULL);
+}
+
+u32 glCallListAsync(const void *list, GLListDoneFn callback, void *userdata)
+{
+    sassert(list != NULL,
+            "glCallListAsync received a null display list pointer");
+
+    const u32 *ptr = list;
+    u32 count = *ptr++;
+
+    if (count == 0)
+        return 0;
+
+    // Flush the area that we are going to DMA
+    DC_FlushRange(ptr, count * 4);
+
+    int oldIME = enterCriticalSection();
+
+    // Entries are released after their callback has run
+    u32 next = (gl_list_queue_tail + 1) % GL_LIST_QUEUE_SIZE;
+    if (next == gl_list_queue_done)
+    {
+        leaveCriticalSection(oldIME);
+        return 0;
+    }
+
+    // Fence 0 is used to report errors, skip it
+    gl_list_fence_issued++;
+    if (gl_list_fence_issued == 0)
+        gl_list_fence_issued++;
+
+    u32 fence = gl_list_fence_issued;
+
+    gl_list_queue_entry_t *entry = &gl_list_queue[gl_list_queue_tail];
+    entry->data = ptr;
+    entry->count = count;
+    entry->fence = fence;
+    entry->callback = callback;
+    entry->userdata = userdata;
+
+    gl_list_queue_tail = next;
+
+    if (!gl_list_queue_busy)
+    {
+        // Install the handler every time the queue starts, in case the DMA 0
+        // interrupt has been used by someone else while the queue was idle.
+        irqSet(IRQ_DMA0, glListQueueHandler);
+        irqEnable(IRQ_DMA0);
+
+        gl_list_queue_busy = true;
+        gl_list_queue_stalled = true;
+    }
+
+    leaveCriticalSection(oldIME);
+
+    glListQueueResume();
+
+    return fence;
+}
+
+bool glListFenceDone(u32 fence)
+{
+    // Fences are compared with wraparound, like timer ticks
+    return (s32)(gl_list_fence_completed - fence) >= 0;
+}
+
+void glListFenceWait(u32 fence)
+{
+    while (!glListFenceDone(fence))
+    {
+        if (gl_list_queue_stalled)
+            glListQueueResume();
+        else
+            cothread_yield_irq(IRQ_DMA0);
+    }
+}
+
+bool glListQueueIdle(void)
+{
+    return !gl_list_queue_busy;
+}
+
+void glListQueueWaitIdle(void)
+{
+    while (gl_list_queue_busy)
+    {
+        if (gl_list_queue_stalled)
+            glListQueueResume();
+        else
+            cothread_yield_irq(IRQ_DMA0);
+    }
+}
+
+bool glListPairInit(GLDisplayListPair *pair, u32 *buffer0, u32 *buffer1,
+                    size_t size)
+{
+    if (!glListInit(&pair->lists[0], buffer0, size))
+        return false;
+    if (!glListInit(&pair->lists[1], buffer1, size))
+        return false;
+
+    pair->fences[0] = 0;
+    pair->fences[1] = 0;
+    pair->current = 0;
+
+    return true;
+}
+
+GLDisplayList *glListPairBegin(GLDisplayListPair *pair)
+{
+    int current = pair->current;
+
+    // The buffer may still be in use by the DMA from two submissions ago
+    if (pair->fences[current] != 0)
+    {
+        glListFenceWait(pair->fences[current]);
+        pair->fences[current] = 0;
+    }
+
+    GLDisplayList *list = &pair->lists[current];
+    glListReset(list);
+
+    return list;
+}
+
+u32 glListPairSubmit(GLDisplayListPair *pair, GLListDoneFn callback,
+                     void *userdata)
+{
+    int current = pair->current;
+
+    const void *data = glListFinish(&pair->lists[current]);
+    if (data == NULL)
+        return 0;
+
+    u32 fence = glCallListAsync(data, callback, userdata);
+    if (fence == 0)
+        return 0;
+
+    pair->fences[current] = fence;
+    pair->current = current ^ 1;
+
+    return fence;
+}
@@ -9,7 +9,10 @@
 //
 // A very small and simple DS rendering lib using the 3d core to render 2D stuff
 
+#include <stdlib.h>
+
 #include <gl2d.h>
+#include <nds/arm9/displaylist.h>
 
 // Our static global variable used for depth values since we cannot disable
 // depth testing in the DS hardware. This value is incremented for every draw
@@ -17,6 +20,234 @@
 static v16 g_depth = 0;
 int gCurrentTexture = 0;
 
+// Quad stored in the batch buffer, with everything needed to emit it later.
+typedef struct
+{
+    int texture;
+    s16 x[4];
+    s16 y[4];
+    u32 texcoord[4]; // Already in GFX_TEX_COORD format
+    u16 color[4];
+    v16 depth;
+    bool colored;
+} gl2d_batch_quad;
+
+// Words of display list needed in the worst case for each quad (commands,
+// colors, texture coordinates and vertices) and for each change of texture.
+#define GL2D_BATCH_WORDS_PER_QUAD   24
+#define GL2D_BATCH_WORDS_EXTRA      8
+
+static struct
+{
+    bool active;
+    u32 flags;
+    gl2d_batch_quad *quads;
+    int count;
+    int capacity;
+    GLDisplayList list;
+    u32 *list_buffer;
+} g_batch;
+
+static int gl2d_batch_compare(const void *a, const void *b)
+{
+    const gl2d_batch_quad *qa = a;
+    const gl2d_batch_quad *qb = b;
+
+    if (qa->texture != qb->texture)
+        return qa->texture - qb->texture;
+
+    // Keep the original order inside each group. The depth is increased for
+    // every draw call, so it can be used for that.
+    return qa->depth - qb->depth;
+}
+
+void glBatchFlush2D(void)
+{
+    if (g_batch.count == 0)
+        return;
+
+    if (g_batch.flags & GL2D_BATCH_SORT)
+        qsort(g_batch.quads, g_batch.count, sizeof(gl2d_batch_quad),
+              gl2d_batch_compare);
+
+    GLDisplayList *list = &g_batch.list;
+    glListReset(list);
+
+    int texture = -1;
+    bool restore_color = false;
+
+    for (int i = 0; i < g_batch.count; i++)
+    {
+        const gl2d_batch_quad *q = &g_batch.quads[i];
+
+        if (q->texture != texture)
+        {
+            if (texture != -1)
+                glListEnd(list);
+
+            // Bind the texture to get its format and palette, and so that the
+            // state of videoGL matches the GPU after the list is sent.
+            glBindTexture(0, q->texture);
+
+            u32 format = 0;
+            int palette = 0;
+
+            if (q->texture != 0)
+            {
+                format = glGetTexParameter();
+                if (glGetColorTableParameterEXT(0, GL_COLOR_TABLE_FORMAT_EXT,
+                                                &palette) == 0)
+                    palette = 0;
+            }
+
+            glListTexFormat(list, format);
+            glListPalFormat(list, palette);
+            glListBegin(list, GL_QUADS);
+
+            texture = q->texture;
+        }
+
+        if (q->colored)
+        {
+            restore_color = true;
+        }
+        else if (restore_color)
+        {
+            // Like in immediate mode, the color is set to white after drawing
+            // a colored primitive.
+            glListColor(list, 0x7FFF);
+            restore_color = false;
+        }
+
+        for (int v = 0; v < 4; v++)
+        {
+            if (q->colored)
+                glListColor(list, q->color[v]);
+            if (q->texture != 0)
+                glListCommand1(list, FIFO_TEX_COORD, q->texcoord[v]);
+
+            if (v == 0)
+                glListVertex3v16(list, q->x[0], q->y[0], q->depth);
+            else
+                glListVertex2v16(list, q->x[v], q->y[v]);
+        }
+    }
+
+    glListEnd(list);
+
+    if (restore_color)
+        glListColor(list, 0x7FFF);
+
+    const void *data = glListFinish(list);
+    sassert(data != NULL, "gl2d batch display list overflow");
+
+    glCallList(data);
+
+    gCurrentTexture = texture;
+    g_batch.count = 0;
+}
+
+bool glBatchBegin2D(int max_quads, u32 flags)
+{
+    if (max_quads <= 0)
+        return false;
+
+    if (g_batch.active)
+        glBatchFlush2D();
+
+    if (max_quads > g_batch.capacity)
+    {
+        size_t list_size = (max_quads * GL2D_BATCH_WORDS_PER_QUAD
+                            + GL2D_BATCH_WORDS_EXTRA) * sizeof(u32);
+
+        gl2d_batch_quad *quads = malloc(max_quads * sizeof(gl2d_batch_quad));
+        u32 *list_buffer = malloc(list_size);
+
+        if ((quads == NULL) || (list_buffer == NULL))
+        {
+            free(quads);
+            free(list_buffer);
+            return false;
+        }
+
+        free(g_batch.quads);
+        free(g_batch.list_buffer);
+
+        g_batch.quads = quads;
+        g_batch.list_buffer = list_buffer;
+        g_batch.capacity = max_quads;
+
+        glListInit(&g_batch.list, list_buffer, list_size);
+    }
+
+    g_batch.flags = flags;
+    g_batch.count = 0;
+    g_batch.active = true;
+
+    return true;
+}
+
+void glBatchEnd2D(void)
+{
+    if (!g_batch.active)
+        return;
+
+    glBatchFlush2D();
+
+    free(g_batch.quads);
+    free(g_batch.list_buffer);
+
+    g_batch.quads = NULL;
+    g_batch.list_buffer = NULL;
+    g_batch.capacity = 0;
+    g_batch.active = false;
+}
+
+// Returns a new quad of the batch, or NULL if batch mode isn't active.
+static gl2d_batch_quad *gl2d_batch_add(int texture)
+{
+    if (!g_batch.active)
+        return NULL;
+
+    if (g_batch.count == g_batch.capacity)
+        glBatchFlush2D();
+
+    gl2d_batch_quad *q = &g_batch.quads[g_batch.count++];
+
+    q->texture = texture;
+    q->depth = g_depth++;
+    q->colored = false;
+
+    return q;
+}
+
+// Primitives that aren't batched need all previous quads to be drawn first.
+static inline void gl2d_batch_sync(void)
+{
+    if (g_batch.count > 0)
+        glBatchFlush2D();
+}
+
+static void gl2d_batch_set_rect(gl2d_batch_quad *q, int x1, int y1,
+                                int x2, int y2)
+{
+    // Same vertex order as the immediate mode functions
+    q->x[0] = x1; q->y[0] = y1;
+    q->x[1] = x1; q->y[1] = y2;
+    q->x[2] = x2; q->y[2] = y2;
+    q->x[3] = x2; q->y[3] = y1;
+}
+
+static void gl2d_batch_set_uv(gl2d_batch_quad *q, int u1, int v1,
+                              int u2, int v2)
+{
+    // Same format as glTexCoord2i()
+    q->texcoord[0] = (v1 << 20) | ((u1 << 4) & 0xFFFF);
+    q->texcoord[1] = (v2 << 20) | ((u1 << 4) & 0xFFFF);
+    q->texcoord[2] = (v2 << 20) | ((u2 << 4) & 0xFFFF);
+    q->texcoord[3] = (v1 << 20) | ((u2 << 4) & 0xFFFF);
+}
+
 void glScreen2D(void)
 {
     // Initialize gl
@@ -133,6 +364,8 @@ void glBegin2D(void)
 
 void glEnd2D(void)
 {
+    gl2d_batch_sync();
+
     // Restore 3d matrices and set current matrix to modelview
     glMatrixMode(GL_PROJECTION);
     glPopMatrix(1);
@@ -142,6 +375,8 @@ void glEnd2D(void)
 
 void glPutPixel(int x, int y, int color)
 {
+    gl2d_batch_sync();
+
     glBindTexture(0, 0);
     glColor(color);
     glBegin(GL_TRIANGLES);
@@ -156,6 +391,8 @@ void glPutPixel(int x, int y, int color)
 
 void glLine(int x1, int y1, int x2, int y2, int color)
 {
+    gl2d_batch_sync();
+
     x2++;
     y2++;
 
@@ -173,6 +410,8 @@ void glLine(int x1, int y1, int x2, int y2, int color)
 
 void glBox(int x1, int y1, int x2, int y2, int color)
 {
+    gl2d_batch_sync();
+
     x2++;
     y2++;
 
@@ -209,6 +448,15 @@ void glBoxFilled(int x1, int y1, int x2, int y2, int color)
     x2++;
     y2++;
 
+    gl2d_batch_quad *q = gl2d_batch_add(0);
+    if (q != NULL)
+    {
+        gl2d_batch_set_rect(q, x1, y1, x2, y2);
+        q->color[0] = q->color[1] = q->color[2] = q->color[3] = color;
+        q->colored = true;
+        return;
+    }
+
     glBindTexture(0, 0);
     glColor(color);
     glBegin(GL_QUADS);
@@ -230,6 +478,18 @@ void glBoxFilledGradient(int x1, int y1, int x2, int y2,
     x2++;
     y2++;
 
+    gl2d_batch_quad *q = gl2d_batch_add(0);
+    if (q != NULL)
+    {
+        gl2d_batch_set_rect(q, x1, y1, x2, y2);
+        q->color[0] = color1;
+        q->color[1] = color2;
+        q->color[2] = color3;
+        q->color[3] = color4;
+        q->colored = true;
+        return;
+    }
+
     glBindTexture(0,0);
     glBegin(GL_QUADS);
         glColor(color1);
@@ -250,6 +510,8 @@ void glBoxFilledGradient(int x1, int y1, int x2, int y2,
 
 void glTriangle(int x1, int y1, int x2, int y2, int x3, int y3, int color)
 {
+    gl2d_batch_sync();
+
     glBindTexture(0, 0);
     glColor(color);
     glBegin(GL_TRIANGLES);
@@ -274,6 +536,8 @@ void glTriangle(int x1, int y1, int x2, int y2, int x3, int y3, int color)
 
 void glTriangleFilled(int x1, int y1, int x2, int y2, int x3, int y3, int color)
 {
+    gl2d_batch_sync();
+
     glBindTexture(0, 0);
     glColor(color);
     glBegin(GL_TRIANGLES);
@@ -291,6 +555,8 @@ void glTriangleFilled(int x1, int y1, int x2, int y2, int x3, int y3, int color)
 void glTriangleFilledGradient(int x1, int y1, int x2, int y2, int x3, int y3,
                               int color1, int color2, int color3)
 {
+    gl2d_batch_sync();
+
     glBindTexture(0, 0);
     glBegin(GL_TRIANGLES);
         // Use 3i for first vertex so that we increment HW depth
@@ -319,6 +585,14 @@ void glSprite(int x, int y, int flipmode, const glImage *spr)
     int v1 = spr->v_off + ((flipmode & GL_FLIP_V) ? spr->height - 1 : 0);
     int v2 = spr->v_off + ((flipmode & GL_FLIP_V) ? 0 : spr->height);
 
+    gl2d_batch_quad *q = gl2d_batch_add(spr->textureID);
+    if (q != NULL)
+    {
+        gl2d_batch_set_rect(q, x1, y1, x2, y2);
+        gl2d_batch_set_uv(q, u1, v1, u2, v2);
+        return;
+    }
+
     if (spr->textureID != gCurrentTexture)
     {
         glBindTexture(GL_TEXTURE_2D, spr->textureID);
@@ -339,6 +613,8 @@ void glSprite(int x, int y, int flipmode, const glImage *spr)
 
 void glSpriteScale(int x, int y, s32 scale, int flipmode, const glImage *spr)
 {
+    gl2d_batch_sync();
+
     int x1 = 0;
     int y1 = 0;
     int x2 = spr->width;
@@ -380,6 +656,8 @@ void glSpriteScale(int x, int y, s32 scale, int flipmode, const glImage *spr)
 void glSpriteScaleXY(int x, int y, s32 scaleX, s32 scaleY, int flipmode,
                      const glImage *spr)
 {
+    gl2d_batch_sync();
+
     int x1 = 0;
     int y1 = 0;
     int x2 = spr->width;
@@ -420,6 +698,8 @@ void glSpriteScaleXY(int x, int y, s32 scaleX, s32 scaleY, int flipmode,
 
 void glSpriteRotate(int x, int y, s32 angle, int flipmode, const glImage *spr)
 {
+    gl2d_batch_sync();
+
     int s_half_x = ((spr->width) + (spr->width & 1)) / 2;
     int s_half_y = ((spr->height) + (spr->height & 1)) / 2;
 
@@ -466,6 +746,8 @@ void glSpriteRotate(int x, int y, s32 angle, int flipmode, const glImage *spr)
 void glSpriteRotateScale(int x, int y, s32 angle, s32 scale, int flipmode,
                          const glImage *spr)
 {
+    gl2d_batch_sync();
+
     int s_half_x = ((spr->width) + (spr->width & 1)) / 2;
     int s_half_y = ((spr->height) + (spr->height & 1)) / 2;
 
@@ -514,6 +796,8 @@ void glSpriteRotateScale(int x, int y, s32 angle, s32 scale, int flipmode,
 void glSpriteRotateScaleXY(int x, int y, s32 angle, s32 scaleX, s32 scaleY,
                            int flipmode, const glImage *spr)
 {
+    gl2d_batch_sync();
+
 
     int s_half_x = ((spr->width) + (spr->width & 1)) / 2;
     int s_half_y = ((spr->height) + (spr->height & 1))  / 2;
@@ -562,6 +846,8 @@ void glSpriteRotateScaleXY(int x, int y, s32 angle, s32 scaleX, s32 scaleY,
 
 void glSpriteStretchHorizontal(int x, int y, int length_x, const glImage *spr)
 {
+    gl2d_batch_sync();
+
     int x1 = x;
     int y1 = y;
     int x2 = x + length_x;
@@ -645,6 +931,17 @@ void glSpriteOnQuad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int
     int v1 = spr->v_off + ((flipmode & GL_FLIP_V) ? spr->height - 1 : 0);
     int v2 = spr->v_off + ((flipmode & GL_FLIP_V) ? 0 : spr->height);
 
+    gl2d_batch_quad *q = gl2d_batch_add(spr->textureID);
+    if (q != NULL)
+    {
+        q->x[0] = x1; q->y[0] = y1;
+        q->x[1] = x2; q->y[1] = y2;
+        q->x[2] = x3; q->y[2] = y3;
+        q->x[3] = x4; q->y[3] = y4;
+        gl2d_batch_set_uv(q, u1 + uoff, v1 + voff, u2 + uoff, v2 + voff);
+        return;
+    }
+
     if (spr->textureID != gCurrentTexture)
     {
         glBindTexture(GL_TEXTURE_2D, spr->textureID);
@@ -0,0 +1,470 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/mesh.h>
+#include <nds/arm9/videoGL.h>
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t size;
+} RIFFChunkHeader;
+
+#define CHUNK_ID(a, b, c, d) \
+    ((uint32_t)((a) | ((b) << 8) | ((c) << 16) | ((d) << 24)))
+
+#define ID_RIFF     CHUNK_ID('R', 'I', 'F', 'F')
+#define ID_NMSH     CHUNK_ID('N', 'M', 'S', 'H')
+#define ID_HDRX     CHUNK_ID('H', 'D', 'R', 'X')
+#define ID_TEX      CHUNK_ID('T', 'E', 'X', ' ')
+#define ID_MTRL     CHUNK_ID('M', 'T', 'R', 'L')
+#define ID_DLST     CHUNK_ID('D', 'L', 'S', 'T')
+
+// The same parser is used for files and for data in RAM. Data in RAM is used
+// in place, data in files is read to buffers allocated with malloc().
+typedef struct
+{
+    FILE *file;
+    const uint8_t *mem;
+    size_t pos;
+    size_t size;
+} gl_mesh_reader;
+
+static GLMeshError glMeshRead(gl_mesh_reader *r, void *dst, size_t size)
+{
+    if (r->file != NULL)
+    {
+        if (fread(dst, 1, size, r->file) != size)
+            return GL_MESH_FILE_NOT_READ;
+        return GL_MESH_NO_ERROR;
+    }
+
+    if (size > r->size - r->pos)
+        return GL_MESH_INVALID_FORMAT;
+
+    memcpy(dst, r->mem + r->pos, size);
+    r->pos += size;
+    return GL_MESH_NO_ERROR;
+}
+
+static GLMeshError glMeshSkip(gl_mesh_reader *r, size_t size)
+{
+    if (r->file != NULL)
+    {
+        if (fseek(r->file, size, SEEK_CUR) != 0)
+            return GL_MESH_FILE_NOT_READ;
+        return GL_MESH_NO_ERROR;
+    }
+
+    if (size > r->size - r->pos)
+        return GL_MESH_INVALID_FORMAT;
+
+    r->pos += size;
+    return GL_MESH_NO_ERROR;
+}
+
+// Returns a pointer to the next "size" bytes. In RAM they are used in place.
+// From a file, they are read to a new buffer, and "allocated" is set to true.
+static GLMeshError glMeshReadBlock(gl_mesh_reader *r, size_t size,
+                                   const void **dst, bool *allocated)
+{
+    if (r->file == NULL)
+    {
+        if (size > r->size - r->pos)
+            return GL_MESH_INVALID_FORMAT;
+
+        *dst = r->mem + r->pos;
+        *allocated = false;
+        r->pos += size;
+        return GL_MESH_NO_ERROR;
+    }
+
+    void *buffer = malloc(size);
+    if (buffer == NULL)
+        return GL_MESH_NOT_ENOUGH_MEMORY;
+
+    if (fread(buffer, 1, size, r->file) != size)
+    {
+        free(buffer);
+        return GL_MESH_FILE_NOT_READ;
+    }
+
+    *dst = buffer;
+    *allocated = true;
+    return GL_MESH_NO_ERROR;
+}
+
+// Size of the data of a texture (texels and the extra data of GL_COMPRESSED
+// textures, without the palette). It returns 0 if the format isn't valid.
+static uint32_t glMeshTextureDataSize(const GLMeshTextureInfo *info)
+{
+    if ((info->type == GL_NOTEXTURE) || (info->type > GL_RGB))
+        return 0;
+
+    if ((info->size_x > TEXTURE_SIZE_1024) || (info->size_y > TEXTURE_SIZE_1024))
+        return 0;
+
+    uint32_t texels = 1 << (info->size_x + info->size_y + 6);
+
+    switch (info->type)
+    {
+        case GL_RGB:
+        case GL_RGBA:
+            return texels * 2;
+        case GL_RGB4:
+            return texels / 4;
+        case GL_COMPRESSED:
+            // 2 bits per texel, and 2 bytes of extra data per 4x4 block
+            return (texels / 4) + (texels / 8);
+        case GL_RGB16:
+            return texels / 2;
+        default:
+            return texels;
+    }
+}
+
+static GLMeshError glMeshLoadTexture(gl_mesh_reader *r, uint32_t size,
+                                     GLMesh *mesh, int index)
+{
+    GLMeshTextureInfo info;
+
+    if (size < sizeof(info))
+        return GL_MESH_INVALID_FORMAT;
+
+    GLMeshError ret = glMeshRead(r, &info, sizeof(info));
+    if (ret != GL_MESH_NO_ERROR)
+        return ret;
+
+    size -= sizeof(info);
+
+    if ((info.data_size == 0) || (info.data_size != glMeshTextureDataSize(&info)))
+        return GL_MESH_INVALID_FORMAT;
+
+    if (info.data_size + info.num_colors * 2 > size)
+        return GL_MESH_INVALID_FORMAT;
+
+    const void *data;
+    bool allocated;
+
+    ret = glMeshReadBlock(r, size, &data, &allocated);
+    if (ret != GL_MESH_NO_ERROR)
+        return ret;
+
+    if (glGenTextures(1, &mesh->textures[index]) == 0)
+        ret = GL_MESH_TEXTURE_FAILED;
+
+    if (ret == GL_MESH_NO_ERROR)
+    {
+        glBindTexture(0, mesh->textures[index]);
+
+        if (glTexImage2D(0, 0, info.type, info.size_x, info.size_y, 0,
+                         info.param, data) == 0)
+            ret = GL_MESH_TEXTURE_FAILED;
+    }
+
+    if ((ret == GL_MESH_NO_ERROR) && (info.num_colors > 0))
+    {
+        const uint8_t *palette = (const uint8_t *)data + info.data_size;
+
+        if (glColorTableEXT(0, 0, info.num_colors, 0, 0, palette) == 0)
+            ret = GL_MESH_TEXTURE_FAILED;
+    }
+
+    if (allocated)
+    {
+        // If the copy to VRAM has been deferred, the data is needed until the
+        // queue has been flushed. This is also true if the texture has failed
+        // to load after queueing some copies, glMeshFree() will remove them.
+        if (glTexUploadsPending() > 0)
+        {
+            mesh->texture_data[index] = (void *)data;
+            mesh->texture_data_size[index] = size;
+        }
+        else
+        {
+            free((void *)data);
+        }
+    }
+
+    return ret;
+}
+
+static GLMeshError glMeshCheck(const GLMesh *mesh)
+{
+    for (int i = 0; i < mesh->header.num_materials; i++)
+    {
+        const GLMeshMaterialInfo *mat = &mesh->materials[i];
+
+        if (mat->texture >= mesh->header.num_textures)
+            return GL_MESH_INVALID_FORMAT;
+
+        if (mat->list_offset >= mesh->lists_words)
+            return GL_MESH_INVALID_FORMAT;
+
+        // The first word of the list is the number of words that follow it
+        size_t words = mesh->lists[mat->list_offset];
+        if (words > mesh->lists_words - mat->list_offset - 1)
+            return GL_MESH_INVALID_FORMAT;
+    }
+
+    return GL_MESH_NO_ERROR;
+}
+
+static GLMeshError glMeshLoadInternal(gl_mesh_reader *r, GLMesh *mesh)
+{
+    RIFFChunkHeader riff_chunk, mesh_chunk;
+    GLMeshError ret;
+
+    ret = glMeshRead(r, &riff_chunk, sizeof(riff_chunk));
+    if (ret != GL_MESH_NO_ERROR)
+        return ret;
+
+    ret = glMeshRead(r, &mesh_chunk, sizeof(mesh_chunk));
+    if (ret != GL_MESH_NO_ERROR)
+        return ret;
+
+    if ((riff_chunk.id != ID_RIFF) || (mesh_chunk.id != ID_NMSH))
+        return GL_MESH_INVALID_FORMAT;
+
+    if (riff_chunk.size != (mesh_chunk.size + 8))
+        return GL_MESH_INVALID_FORMAT;
+
+    uint32_t remaining = mesh_chunk.size;
+    bool has_header = false;
+    int num_textures = 0;
+
+    while (remaining > 0)
+    {
+        RIFFChunkHeader chunk;
+
+        if (remaining < sizeof(chunk))
+            return GL_MESH_INVALID_FORMAT;
+
+        ret = glMeshRead(r, &chunk, sizeof(chunk));
+        if (ret != GL_MESH_NO_ERROR)
+            return ret;
+
+        remaining -= sizeof(chunk);
+
+        if ((chunk.size > remaining) || (chunk.size & 3))
+            return GL_MESH_INVALID_FORMAT;
+
+        remaining -= chunk.size;
+
+        // The header must be the first chunk
+        if ((chunk.id != ID_HDRX) && !has_header)
+            return GL_MESH_INVALID_FORMAT;
+
+        const void *block;
+        bool allocated;
+
+        switch (chunk.id)
+        {
+            case ID_HDRX:
+            {
+                if (has_header || (chunk.size < sizeof(GLMeshHeader)))
+                    return GL_MESH_INVALID_FORMAT;
+
+                ret = glMeshRead(r, &mesh->header, sizeof(GLMeshHeader));
+                if (ret != GL_MESH_NO_ERROR)
+                    return ret;
+
+                if (mesh->header.version != GL_MESH_VERSION)
+                    return GL_MESH_INVALID_VERSION;
+
+                has_header = true;
+
+                int count = mesh->header.num_textures;
+                if (count > 0)
+                {
+                    mesh->textures = calloc(count, sizeof(int));
+                    mesh->texture_data = calloc(count, sizeof(void *));
+                    mesh->texture_data_size = calloc(count, sizeof(size_t));
+                    if ((mesh->textures == NULL) || (mesh->texture_data == NULL)
+                        || (mesh->texture_data_size == NULL))
+                        return GL_MESH_NOT_ENOUGH_MEMORY;
+                }
+
+                ret = glMeshSkip(r, chunk.size - sizeof(GLMeshHeader));
+                break;
+            }
+
+            case ID_TEX:
+            {
+                if (num_textures >= mesh->header.num_textures)
+                    return GL_MESH_INVALID_FORMAT;
+
+                ret = glMeshLoadTexture(r, chunk.size, mesh, num_textures);
+                num_textures++;
+                break;
+            }
+
+            case ID_MTRL:
+            {
+                size_t size = mesh->header.num_materials * sizeof(GLMeshMaterialInfo);
+
+                if ((mesh->materials != NULL) || (chunk.size != size))
+                    return GL_MESH_INVALID_FORMAT;
+
+                ret = glMeshReadBlock(r, size, &block, &allocated);
+                if (ret == GL_MESH_NO_ERROR)
+                {
+                    mesh->materials = block;
+                    mesh->owns_data = allocated;
+                }
+                break;
+            }
+
+            case ID_DLST:
+            {
+                if ((mesh->lists != NULL) || (chunk.size == 0))
+                    return GL_MESH_INVALID_FORMAT;
+
+                // Lists are read straight into the buffer sent to the GPU
+                ret = glMeshReadBlock(r, chunk.size, &block, &allocated);
+                if (ret == GL_MESH_NO_ERROR)
+                {
+                    mesh->lists = block;
+                    mesh->lists_words = chunk.size / 4;
+                    mesh->owns_data = allocated;
+                }
+                break;
+            }
+
+            default:
+                // Ignore unknown chunks
+                ret = glMeshSkip(r, chunk.size);
+                break;
+        }
+
+        if (ret != GL_MESH_NO_ERROR)
+            return ret;
+    }
+
+    if (!has_header || (num_textures != mesh->header.num_textures))
+        return GL_MESH_INVALID_FORMAT;
+
+    if ((mesh->header.num_materials > 0)
+        && ((mesh->materials == NULL) || (mesh->lists == NULL)))
+        return GL_MESH_INVALID_FORMAT;
+
+    return glMeshCheck(mesh);
+}
+
+static GLMeshError glMeshLoad(gl_mesh_reader *r, GLMesh *mesh)
+{
+    memset(mesh, 0, sizeof(GLMesh));
+
+    GLMeshError ret = glMeshLoadInternal(r, mesh);
+    if (ret != GL_MESH_NO_ERROR)
+        glMeshFree(mesh);
+
+    return ret;
+}
+
+GLMeshError glMeshLoadFileEx(FILE *file, GLMesh *mesh)
+{
+    if ((file == NULL) || (mesh == NULL))
+        return GL_MESH_NULL_POINTER;
+
+    gl_mesh_reader r = { .file = file };
+
+    return glMeshLoad(&r, mesh);
+}
+
+GLMeshError glMeshLoadFile(const char *path, GLMesh *mesh)
+{
+    if ((path == NULL) || (mesh == NULL))
+        return GL_MESH_NULL_POINTER;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return GL_MESH_FILE_NOT_OPENED;
+
+    GLMeshError ret = glMeshLoadFileEx(file, mesh);
+
+    if (fclose(file) != 0)
+    {
+        if (ret == GL_MESH_NO_ERROR)
+            glMeshFree(mesh);
+        return GL_MESH_FILE_NOT_CLOSED;
+    }
+
+    return ret;
+}
+
+GLMeshError glMeshLoadMem(const void *src, size_t size, GLMesh *mesh)
+{
+    if ((src == NULL) || (mesh == NULL))
+        return GL_MESH_NULL_POINTER;
+
+    gl_mesh_reader r = { .mem = src, .size = size };
+
+    return glMeshLoad(&r, mesh);
+}
+
+void glMeshFree(GLMesh *mesh)
+{
+    if (mesh == NULL)
+        return;
+
+    if (mesh->textures != NULL)
+    {
+        glDeleteTextures(mesh->header.num_textures, mesh->textures);
+        free(mesh->textures);
+    }
+
+    // Deleting the textures removes their deferred uploads, but a palette may
+    // be used by other textures and it isn't deleted with them.
+    if (mesh->texture_data != NULL)
+    {
+        for (int i = 0; i < mesh->header.num_textures; i++)
+        {
+            if (mesh->texture_data[i] == NULL)
+                continue;
+
+            glTexUploadsFlushBuffer(mesh->texture_data[i],
+                                    mesh->texture_data_size[i]);
+            free(mesh->texture_data[i]);
+        }
+        free(mesh->texture_data);
+    }
+
+    free(mesh->texture_data_size);
+
+    if (mesh->owns_data)
+    {
+        free((void *)mesh->materials);
+        free((void *)mesh->lists);
+    }
+
+    memset(mesh, 0, sizeof(GLMesh));
+}
+
+const void *glMeshGetList(const GLMesh *mesh, int material)
+{
+    if ((material < 0) || (material >= mesh->header.num_materials))
+        return NULL;
+
+    return &mesh->lists[mesh->materials[material].list_offset];
+}
+
+void glMeshDraw(const GLMesh *mesh)
+{
+    for (int i = 0; i < mesh->header.num_materials; i++)
+    {
+        const GLMeshMaterialInfo *mat = &mesh->materials[i];
+
+        int name = (mat->texture >= 0) ? mesh->textures[mat->texture] : 0;
+
+        glBindTexture(0, name);
+        glPolyFmt(mat->poly_fmt);
+        glCallList(glMeshGetList(mesh, i));
+    }
+}
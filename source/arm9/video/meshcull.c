@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <nds/arm9/boxtest.h>
+#include <nds/arm9/math.h>
+#include <nds/arm9/meshcull.h>
+#include <nds/arm9/postest.h>
+#include <nds/arm9/sassert.h>
+
+// Outcode bits: planes of the view frustum that a vertex is outside of
+#define OUT_LEFT    BIT(0)
+#define OUT_RIGHT   BIT(1)
+#define OUT_BOTTOM  BIT(2)
+#define OUT_TOP     BIT(3)
+#define OUT_NEAR    BIT(4)
+#define OUT_FAR     BIT(5)
+
+// Vertices further than this from the center of the screen (in units of the
+// screen size) aren't projected. This keeps the projected coordinates small
+// enough to calculate the orientation of triangles with 64-bit integers.
+#define GUARD_BAND_SHIFT    8
+
+bool glCullMeshVisible(const GLCullMesh *mesh)
+{
+    const v16 *b = mesh->bounds;
+
+    return BoxTest(b[0], b[1], b[2], b[3], b[4], b[5]) != 0;
+}
+
+static void glCullTransform(GLCullVertex *out, v16 x, v16 y, v16 z)
+{
+    // Let the geometry engine multiply the vertex by the clip matrix, so that
+    // the result is exactly what the GPU would calculate.
+    PosTest(x, y, z);
+
+    s32 cx = PosTestXresult();
+    s32 cy = PosTestYresult();
+    s32 cz = PosTestZresult();
+    s32 cw = PosTestWresult();
+
+    u8 outcode = 0;
+
+    if (cx < -cw)
+        outcode |= OUT_LEFT;
+    else if (cx > cw)
+        outcode |= OUT_RIGHT;
+
+    if (cy < -cw)
+        outcode |= OUT_BOTTOM;
+    else if (cy > cw)
+        outcode |= OUT_TOP;
+
+    if (cz < -cw)
+        outcode |= OUT_NEAR;
+    else if (cz > cw)
+        outcode |= OUT_FAR;
+
+    out->outcode = outcode;
+    out->projected = false;
+
+    if (cw <= 0)
+        return;
+
+    s64 limit = (s64)cw << GUARD_BAND_SHIFT;
+    if ((cx > limit) || (cx < -limit) || (cy > limit) || (cy < -limit))
+        return;
+
+    out->sx = divf32(cx, cw);
+    out->sy = divf32(cy, cw);
+    out->projected = true;
+}
+
+// Returns true if the triangle has to be drawn
+static bool glCullTriangle(const GLCullVertex *v0, const GLCullVertex *v1,
+                           const GLCullVertex *v2, u32 cull)
+{
+    // All vertices outside of the same plane
+    if (v0->outcode & v1->outcode & v2->outcode)
+        return false;
+
+    if (cull == POLY_CULL_NONE)
+        return true;
+
+    // Let the hardware clip the triangle if it can't be projected
+    if (!(v0->projected && v1->projected && v2->projected))
+        return true;
+
+    // Counter-clockwise triangles (with Y pointing up) are front-facing
+    s64 area = (s64)(v1->sx - v0->sx) * (v2->sy - v0->sy)
+             - (s64)(v2->sx - v0->sx) * (v1->sy - v0->sy);
+
+    if (area == 0)
+        return true;
+
+    if (cull == POLY_CULL_BACK)
+        return area > 0;
+    else // if (cull == POLY_CULL_FRONT)
+        return area < 0;
+}
+
+int glCullMeshEmit(GLDisplayList *list, const GLCullMesh *mesh,
+                   GLCullVertex *workspace, u32 cull)
+{
+    sassert(workspace != NULL, "glCullMeshEmit needs a workspace");
+
+    // The tests are sent directly to the geometry engine
+    glListQueueWaitIdle();
+
+    if (!glCullMeshVisible(mesh))
+        return 0;
+
+    const v16 *pos = mesh->positions;
+
+    for (u32 i = 0; i < mesh->num_vertices; i++)
+        glCullTransform(&workspace[i], pos[i * 3], pos[i * 3 + 1], pos[i * 3 + 2]);
+
+    int emitted = 0;
+
+    for (u32 t = 0; t < mesh->num_triangles; t++)
+    {
+        const u16 *idx = &mesh->indices[t * 3];
+
+        if (!glCullTriangle(&workspace[idx[0]], &workspace[idx[1]],
+                            &workspace[idx[2]], cull))
+            continue;
+
+        if (emitted == 0)
+            glListBegin(list, GL_TRIANGLES);
+
+        for (int i = 0; i < 3; i++)
+        {
+            u32 v = idx[i];
+
+            if (mesh->texcoords)
+                glListCommand1(list, FIFO_TEX_COORD, mesh->texcoords[v]);
+            if (mesh->colors)
+                glListColor(list, mesh->colors[v]);
+            if (mesh->normals)
+                glListNormal(list, mesh->normals[v]);
+
+            glListVertex3v16(list, pos[v * 3], pos[v * 3 + 1], pos[v * 3 + 2]);
+        }
+
+        emitted++;
+    }
+
+    if (emitted > 0)
+        glListEnd(list);
+
+    if (list->overflow)
+        return -1;
+
+    return emitted;
+}
@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <nds/arm9/background.h>
+#include <nds/arm9/displaylist.h>
+#include <nds/arm9/math.h>
+#include <nds/arm9/multipass.h>
+#include <nds/arm9/sprite.h>
+#include <nds/arm9/video.h>
+#include <nds/arm9/videoGL.h>
+#include <nds/dma.h>
+#include <nds/system.h>
+
+// Captured images are stored in VRAM C and D
+#define BANK_C  2
+#define BANK_D  3
+
+static struct
+{
+    bool active;
+    GLMultipassMode mode;
+    int passes;
+    int nextPass; // Pass returned by the next call to glMultipassBegin()
+    int currentPass; // Pass between glMultipassBegin() and glMultipassEnd()
+    int submittedPass; // Last pass ended before the next vertical blank
+    int screenPass; // Pass shown by the main engine in dual screen mode
+    int captureBank; // Bank that receives the capture of the current frame
+    rgb backdrop;
+    m4x4 projection; // Projection matrix set by the caller
+    int polygons[GL_MULTIPASS_MAX_PASSES];
+} gl_multipass;
+
+static void glMultipassSetBank(int bank, u8 type)
+{
+    if (bank == BANK_C)
+        VRAM_C_CR = VRAM_ENABLE | type;
+    else
+        VRAM_D_CR = VRAM_ENABLE | type;
+}
+
+// Uses 12 bitmap sprites of 64x64 pixels to show VRAM D as a 256x192 bitmap
+static void glMultipassSetupSubSprites(void)
+{
+    for (int i = 0; i < 128; i++)
+    {
+        OAM_SUB[i * 4 + 0] = ATTR0_DISABLED;
+        OAM_SUB[i * 4 + 1] = 0;
+        OAM_SUB[i * 4 + 2] = 0;
+    }
+
+    int id = 0;
+    for (int y = 0; y < 3; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            // In 2D bitmap mode with a width of 256 pixels, the tile index is
+            // the offset of the sprite in units of 8x8 pixels.
+            OAM_SUB[id * 4 + 0] = ATTR0_BMP | ATTR0_SQUARE | (64 * y);
+            OAM_SUB[id * 4 + 1] = ATTR1_SIZE_64 | (64 * x);
+            OAM_SUB[id * 4 + 2] = ATTR2_ALPHA(1) | (8 * 32 * y) | (8 * x);
+            id++;
+        }
+    }
+}
+
+bool glMultipassInit(GLMultipassMode mode, int passes)
+{
+    if (mode == GL_MULTIPASS_DUAL_SCREEN)
+        passes = 2;
+    else if (mode != GL_MULTIPASS_STRIPS)
+        return false;
+
+    if ((passes < 2) || (passes > GL_MULTIPASS_MAX_PASSES))
+        return false;
+
+    // Clear the banks that will hold the captured images
+    vramSetBankC(VRAM_C_LCD);
+    vramSetBankD(VRAM_D_LCD);
+    dmaFillWords(0, VRAM_C, 128 * 1024);
+    dmaFillWords(0, VRAM_D, 128 * 1024);
+
+    if (mode == GL_MULTIPASS_STRIPS)
+    {
+        // The 3D output goes over the last captured image
+        videoSetMode(MODE_5_3D | DISPLAY_BG3_ACTIVE);
+
+        REG_BG0CNT = BG_PRIORITY(0);
+        REG_BG3CNT = BG_BMP16_256x256 | BG_BMP_BASE(0) | BG_PRIORITY(1);
+        REG_BG3PA = 1 << 8;
+        REG_BG3PB = 0;
+        REG_BG3PC = 0;
+        REG_BG3PD = 1 << 8;
+        REG_BG3X = 0;
+        REG_BG3Y = 0;
+
+        // The first image is shown from VRAM C and captured to VRAM D
+        vramSetBankC(VRAM_C_MAIN_BG_0x06000000);
+        gl_multipass.captureBank = BANK_D;
+    }
+    else
+    {
+        videoSetMode(MODE_0_3D);
+
+        // The previous image of the other screen is shown from VRAM C (as a
+        // background) or from VRAM D (as sprites), depending on the screen.
+        // The bank that isn't mapped reads as transparent.
+        videoSetModeSub(MODE_5_2D | DISPLAY_BG2_ACTIVE | DISPLAY_SPR_ACTIVE |
+                        DISPLAY_SPR_2D_BMP_256);
+
+        REG_BG2CNT_SUB = BG_BMP16_256x256 | BG_BMP_BASE(0);
+        REG_BG2PA_SUB = 1 << 8;
+        REG_BG2PB_SUB = 0;
+        REG_BG2PC_SUB = 0;
+        REG_BG2PD_SUB = 1 << 8;
+        REG_BG2X_SUB = 0;
+        REG_BG2Y_SUB = 0;
+
+        glMultipassSetupSubSprites();
+
+        gl_multipass.captureBank = BANK_D;
+    }
+
+    gl_multipass.mode = mode;
+    gl_multipass.passes = passes;
+    gl_multipass.nextPass = 0;
+    gl_multipass.currentPass = -1;
+    gl_multipass.submittedPass = -1;
+    gl_multipass.screenPass = 0;
+
+    for (int i = 0; i < GL_MULTIPASS_MAX_PASSES; i++)
+        gl_multipass.polygons[i] = 0;
+
+    gl_multipass.active = true;
+
+    glMultipassSetBackdrop(gl_multipass.backdrop);
+
+    return true;
+}
+
+void glMultipassExit(void)
+{
+    if (!gl_multipass.active)
+        return;
+
+    REG_DISPCAPCNT = 0;
+    glViewport(0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+    lcdMainOnTop();
+
+    gl_multipass.active = false;
+}
+
+void glMultipassSetBackdrop(rgb color)
+{
+    gl_multipass.backdrop = color;
+
+    // Make the clear color transparent so that the last captured image can be
+    // seen outside of the current strip.
+    if (gl_multipass.active && (gl_multipass.mode == GL_MULTIPASS_STRIPS))
+        glClearColor(color & 31, (color >> 5) & 31, (color >> 10) & 31, 0);
+}
+
+// Draws a polygon that fills the viewport, behind everything else
+static void glMultipassDrawBackdrop(void)
+{
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPolyFmt(POLY_ALPHA(31) | POLY_CULL_NONE);
+    GFX_TEX_FORMAT = 0;
+    glColor(gl_multipass.backdrop);
+
+    v16 z = inttov16(1) - 1;
+
+    glBegin(GL_QUADS);
+    glVertex3v16(-inttov16(1), -inttov16(1), z);
+    glVertex3v16(inttov16(1), -inttov16(1), z);
+    glVertex3v16(inttov16(1), inttov16(1), z);
+    glVertex3v16(-inttov16(1), inttov16(1), z);
+    glEnd();
+
+    glPopMatrix(1);
+
+    GFX_TEX_FORMAT = glGetTexParameter();
+}
+
+int glMultipassBegin(void)
+{
+    if (!gl_multipass.active)
+        return -1;
+
+    int pass = gl_multipass.nextPass;
+
+    gl_multipass.currentPass = pass;
+    gl_multipass.nextPass = (pass + 1) % gl_multipass.passes;
+
+    if (gl_multipass.mode == GL_MULTIPASS_DUAL_SCREEN)
+        return pass;
+
+    // Rows of the screen covered by this strip (from the top)
+    int height = SCREEN_HEIGHT / gl_multipass.passes;
+    int r0 = pass * height;
+    int r1 = r0 + height;
+
+    // Limits of the strip in normalized device coordinates (Y points up)
+    int32_t top = inttof32(1) - (inttof32(2) * r0) / SCREEN_HEIGHT;
+    int32_t bottom = inttof32(1) - (inttof32(2) * r1) / SCREEN_HEIGHT;
+    int32_t center = (top + bottom) / 2;
+    int32_t scale = inttof32(SCREEN_HEIGHT) / height;
+
+    // Map the strip to the whole viewport: y' = (y - center * w) * scale. The
+    // hardware uses row vectors, so this modifies the Y column.
+    glGetFixed(GL_GET_MATRIX_PROJECTION, gl_multipass.projection.m);
+
+    m4x4 strip = gl_multipass.projection;
+    for (int i = 0; i < 4; i++)
+    {
+        int32_t y = strip.m[i * 4 + 1];
+        int32_t w = strip.m[i * 4 + 3];
+
+        strip.m[i * 4 + 1] = mulf32(y - mulf32(center, w), scale);
+    }
+
+    glViewport(0, SCREEN_HEIGHT - r1, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1 - r0);
+
+    glMultipassDrawBackdrop();
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrix4x4(&strip);
+    glMatrixMode(GL_MODELVIEW);
+
+    return pass;
+}
+
+void glMultipassEnd(void)
+{
+    if (!gl_multipass.active || (gl_multipass.currentPass < 0))
+        return;
+
+    int pass = gl_multipass.currentPass;
+
+    if (gl_multipass.mode == GL_MULTIPASS_STRIPS)
+    {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrix4x4(&gl_multipass.projection);
+        glMatrixMode(GL_MODELVIEW);
+
+        glViewport(0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+    }
+
+    // Wait for the geometry engine to process all commands to count the
+    // polygons of this pass. Don't count the backdrop.
+    glListQueueWaitIdle();
+    while (GFX_BUSY);
+
+    int polygons = GFX_POLYGON_RAM_USAGE;
+    if ((gl_multipass.mode == GL_MULTIPASS_STRIPS) && (polygons > 0))
+        polygons--;
+
+    gl_multipass.polygons[pass] = polygons;
+    gl_multipass.submittedPass = pass;
+    gl_multipass.currentPass = -1;
+}
+
+void glMultipassVBlank(void)
+{
+    if (!gl_multipass.active)
+        return;
+
+    // The pass ended during the last frame is the one that the 3D engine is
+    // going to show now.
+    int pass = gl_multipass.submittedPass;
+    gl_multipass.submittedPass = -1;
+
+    if (gl_multipass.mode == GL_MULTIPASS_STRIPS)
+    {
+        // Show the image captured during the last frame, which has the latest
+        // version of all strips, and capture the new frame in the other bank.
+        int displayBank = gl_multipass.captureBank;
+        int captureBank = (displayBank == BANK_C) ? BANK_D : BANK_C;
+
+        glMultipassSetBank(captureBank, VRAM_C_LCD);
+        glMultipassSetBank(displayBank, VRAM_C_MAIN_BG_0x06000000);
+
+        gl_multipass.captureBank = captureBank;
+    }
+    else
+    {
+        // If nothing new has been drawn the 3D engine shows the same frame
+        // again, so keep the same screen.
+        if (pass >= 0)
+            gl_multipass.screenPass = pass;
+
+        if (gl_multipass.screenPass == 0)
+        {
+            // Top screen: the sub engine shows the last bottom screen image
+            lcdMainOnTop();
+            vramSetBankD(VRAM_D_LCD);
+            vramSetBankC(VRAM_C_SUB_BG);
+            gl_multipass.captureBank = BANK_D;
+        }
+        else
+        {
+            // Bottom screen: the sub engine shows the last top screen image
+            lcdMainOnBottom();
+            vramSetBankC(VRAM_C_LCD);
+            vramSetBankD(VRAM_D_SUB_SPRITE);
+            gl_multipass.captureBank = BANK_C;
+        }
+    }
+
+    REG_DISPCAPCNT = DCAP_ENABLE | DCAP_MODE(DCAP_MODE_A)
+                   | DCAP_SRC_A(DCAP_SRC_A_COMPOSITED)
+                   | DCAP_SIZE(DCAP_SIZE_256x192)
+                   | DCAP_BANK(gl_multipass.captureBank);
+}
+
+int glMultipassPolygonCount(void)
+{
+    int total = 0;
+
+    for (int i = 0; i < gl_multipass.passes; i++)
+        total += gl_multipass.polygons[i];
+
+    return total;
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include "tex_residency.h"
+
+void texResidency_init(s_texResidency *res, const s_texResidencyCallbacks *cb)
+{
+    res->cb = cb;
+    res->frame = 0;
+    res->budget = 0;
+    res->residentBytes = 0;
+}
+
+void texResidency_add(s_texResidency *res, s_texResidencyEntry *entry,
+                      uint32_t size)
+{
+    entry->size = size;
+    entry->lastUsedFrame = res->frame;
+    entry->state = TEX_RESIDENCY_RESIDENT;
+
+    res->residentBytes += size;
+}
+
+void texResidency_remove(s_texResidency *res, s_texResidencyEntry *entry)
+{
+    // Evicted textures don't have any VRAM assigned
+    if (entry->state == TEX_RESIDENCY_RESIDENT)
+        res->residentBytes -= entry->size;
+
+    entry->size = 0;
+    entry->state = TEX_RESIDENCY_RESIDENT;
+}
+
+void texResidency_use(s_texResidency *res, s_texResidencyEntry *entry)
+{
+    entry->lastUsedFrame = res->frame;
+
+    if (entry->state == TEX_RESIDENCY_EVICTED)
+        entry->state = TEX_RESIDENCY_PENDING;
+}
+
+void texResidency_prefetch(s_texResidencyEntry *entry)
+{
+    if (entry->state == TEX_RESIDENCY_EVICTED)
+        entry->state = TEX_RESIDENCY_PENDING;
+}
+
+bool texResidency_evictLRU(s_texResidency *res)
+{
+    const s_texResidencyCallbacks *cb = res->cb;
+
+    s_texResidencyEntry *oldest = NULL;
+    int oldestName = 0;
+
+    int count = cb->count();
+    int active = cb->active();
+
+    for (int name = 1; name < count; name++)
+    {
+        s_texResidencyEntry *entry = cb->get(name);
+
+        if ((entry == NULL) || (entry->state != TEX_RESIDENCY_RESIDENT))
+            continue;
+
+        if ((name == active) || (entry->lastUsedFrame == res->frame))
+            continue;
+
+        if ((oldest == NULL) || (entry->lastUsedFrame < oldest->lastUsedFrame))
+        {
+            oldest = entry;
+            oldestName = name;
+        }
+    }
+
+    if (oldest == NULL)
+        return false;
+
+    cb->evict(oldestName);
+
+    oldest->state = TEX_RESIDENCY_EVICTED;
+    res->residentBytes -= oldest->size;
+
+    return true;
+}
+
+void texResidency_enforceBudget(s_texResidency *res, size_t extra)
+{
+    if (res->budget == 0)
+        return;
+
+    while (res->residentBytes + extra > res->budget)
+    {
+        if (!texResidency_evictLRU(res))
+            break;
+    }
+}
+
+void texResidency_setBudget(s_texResidency *res, size_t bytes)
+{
+    res->budget = bytes;
+    texResidency_enforceBudget(res, 0);
+}
+
+// Loads an evicted texture to VRAM again.
+static bool texResidency_load(s_texResidency *res, int name,
+                              s_texResidencyEntry *entry)
+{
+    texResidency_enforceBudget(res, entry->size);
+
+    if (!res->cb->load(name))
+        return false;
+
+    entry->state = TEX_RESIDENCY_RESIDENT;
+    res->residentBytes += entry->size;
+
+    return true;
+}
+
+void texResidency_update(s_texResidency *res, size_t max_bytes)
+{
+    const s_texResidencyCallbacks *cb = res->cb;
+
+    res->frame++;
+
+    // The active texture may be used in the next frame without being bound
+    s_texResidencyEntry *active = cb->get(cb->active());
+    if (active != NULL)
+        active->lastUsedFrame = res->frame;
+
+    size_t loaded = 0;
+
+    int count = cb->count();
+
+    for (int name = 1; name < count; name++)
+    {
+        s_texResidencyEntry *entry = cb->get(name);
+
+        if ((entry == NULL) || (entry->state != TEX_RESIDENCY_PENDING))
+            continue;
+
+        if ((loaded != 0) && (loaded + entry->size > max_bytes))
+            break;
+
+        // The texture is used in the frame that is about to start
+        entry->lastUsedFrame = res->frame;
+
+        // If it doesn't fit, stop. Loading a smaller texture could cause more
+        // evictions that the texture that has failed will need again.
+        if (!texResidency_load(res, name, entry))
+            break;
+
+        loaded += entry->size;
+    }
+}
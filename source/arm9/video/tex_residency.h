@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Residency manager of videoGL. It decides which textures are evicted from VRAM
+// and which ones are loaded again, but it doesn't allocate VRAM or copy any
+// data itself: videoGL does that in the callbacks. This way it can be built for
+// the host to test it (see tests/host).
+//
+// A managed texture is in one of these states:
+//
+// - Resident: It is in VRAM and its size is counted in residentBytes.
+// - Evicted: It has been removed from VRAM to make room for other textures.
+// - Pending: It has been bound (or prefetched) after being evicted. It will be
+//   loaded again by texResidency_update().
+
+#ifndef LIBNDS_ARM9_VIDEO_TEX_RESIDENCY_H__
+#define LIBNDS_ARM9_VIDEO_TEX_RESIDENCY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// States of textures handled by the residency manager
+#define TEX_RESIDENCY_RESIDENT  0 // In VRAM
+#define TEX_RESIDENCY_EVICTED   1 // Only in RAM
+#define TEX_RESIDENCY_PENDING   2 // Only in RAM, bound since it was evicted
+
+// Residency information of a texture. It is stored inside the texture struct
+// of videoGL.
+typedef struct s_texResidencyEntry
+{
+    uint32_t size;          // Size of the texture in VRAM
+    uint32_t lastUsedFrame; // Value of frame when it was last used
+    uint8_t state;          // TEX_RESIDENCY_RESIDENT, _EVICTED or _PENDING
+} s_texResidencyEntry;
+
+typedef struct s_texResidencyCallbacks
+{
+    // Returns the number of texture names. Names go from 1 to count - 1.
+    int (*count)(void);
+    // Returns the name of the active texture (0 if there isn't one)
+    int (*active)(void);
+    // Returns the residency information of a texture, or NULL if the texture
+    // isn't handled by the residency manager.
+    s_texResidencyEntry *(*get)(int name);
+    // Frees the VRAM used by a texture
+    void (*evict)(int name);
+    // Copies a texture to VRAM. Returns false if there isn't enough VRAM.
+    bool (*load)(int name);
+} s_texResidencyCallbacks;
+
+typedef struct s_texResidency
+{
+    const s_texResidencyCallbacks *cb;
+    uint32_t frame;         // Increased by texResidency_update()
+    size_t budget;          // Max VRAM used by managed textures (0 = no limit)
+    size_t residentBytes;   // VRAM currently used by managed textures
+} s_texResidency;
+
+// Initializes the manager with no budget and no textures.
+void texResidency_init(s_texResidency *res, const s_texResidencyCallbacks *cb);
+
+// Starts handling a texture that has just been loaded to VRAM.
+void texResidency_add(s_texResidency *res, s_texResidencyEntry *entry,
+                      uint32_t size);
+
+// Stops handling a texture. The texture is left as it is (in VRAM or not).
+void texResidency_remove(s_texResidency *res, s_texResidencyEntry *entry);
+
+// Marks a texture as used in the current frame. If it was evicted, it becomes
+// pending.
+void texResidency_use(s_texResidency *res, s_texResidencyEntry *entry);
+
+// Marks an evicted texture as pending without changing when it was last used.
+void texResidency_prefetch(s_texResidencyEntry *entry);
+
+// Evicts the resident texture that has been used least recently. Textures used
+// in the current frame and the active texture are never evicted. Returns false
+// if there is nothing that can be evicted.
+bool texResidency_evictLRU(s_texResidency *res);
+
+// Evicts textures until "extra" more bytes fit in the budget, or until there is
+// nothing else that can be evicted.
+void texResidency_enforceBudget(s_texResidency *res, size_t extra);
+
+// Sets the budget and evicts textures until the resident ones fit in it.
+void texResidency_setBudget(s_texResidency *res, size_t bytes);
+
+// Starts a new frame and loads pending textures, up to "max_bytes" (at least
+// one texture is loaded if there is any pending texture). It stops at the first
+// texture that can't be loaded.
+void texResidency_update(s_texResidency *res, size_t max_bytes);
+
+#endif // LIBNDS_ARM9_VIDEO_TEX_RESIDENCY_H__
@@ -7,6 +7,10 @@
 
 // Video API vaguely similar to OpenGL
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/displaylist.h>
 #include <nds/arm9/math.h>
 #include <nds/arm9/sassert.h>
 #include <nds/arm9/trig_lut.h>
@@ -18,38 +22,8 @@
 #include <nds/ndstypes.h>
 #include <nds/system.h>
 
-// Structures specific to allocating and deallocating texture and palette VRAM
-// ---------------------------------------------------------------------------
-
-typedef struct s_SingleBlock
-{
-    uint32_t indexOut;
-    uint8_t *AddrSet;
-
-    // 0-1: prev/next memory block
-    // 2-3: prev/next empty/alloc block
-    struct s_SingleBlock *node[4];
-
-    uint32_t blockSize;
-} s_SingleBlock;
-
-typedef struct s_vramBlock
-{
-    uint8_t *startAddr, *endAddr;
-    struct s_SingleBlock *firstBlock;
-    struct s_SingleBlock *firstEmpty;
-    struct s_SingleBlock *firstAlloc;
-
-    struct s_SingleBlock *lastExamined;
-    uint8_t *lastExaminedAddr;
-    uint32_t lastExaminedSize;
-
-    DynamicArray blockPtrs;
-    DynamicArray deallocBlocks;
-
-    uint32_t blockCount;
-    uint32_t deallocCount;
-} s_vramBlock;
+#include "tex_residency.h"
+#include "vram_block.h"
 
 typedef struct gl_texture_data
 {
@@ -59,6 +33,14 @@ typedef struct gl_texture_data
     int palIndex;         // The palette index
     uint32_t texFormat;   // Specifications of how the texture is displayed
     uint32_t texSize;     // The size (in blocks) of the texture
+
+    // Residency management. Only used by textures loaded with
+    // glTexImage2DResident().
+    const void *backing;      // Copy of the texture data (NULL if not managed)
+    uint32_t residentFormat;  // Value of texFormat while the texture is evicted
+    uint8_t backingType;      // Format of the data in the copy
+    uint8_t backingOwned;     // The copy has been allocated by videoGL
+    s_texResidencyEntry residency; // State of the texture in the manager
 } gl_texture_data;
 
 typedef struct gl_palette_data
@@ -67,9 +49,22 @@ typedef struct gl_palette_data
     uint32_t palIndex;      // The index in the memory block
     uint16_t addr;          // The offset address for texture palettes in VRAM
     uint16_t palSize;       // The length of the palette
+    uint8_t addrShift;      // Shift applied to the VRAM offset to get "addr"
     uint32_t connectCount;  // The number of textures currently using this palette
 } gl_palette_data;
 
+// Copy of texture or palette data to VRAM that has been delayed until the next
+// call to glTexUploadsFlush().
+typedef struct gl_upload_entry
+{
+    const void *src;    // Data in main RAM
+    void *dst;          // Address in VRAM (LCD mapping)
+    uint32_t size;      // Size in bytes
+    int name;           // Name of the texture or palette that owns the data
+    bool isPalette;     // The name is a palette name
+    bool setAlpha;      // GL_RGB texture, the alpha bit needs to be set
+} gl_upload_entry;
+
 // This struct holds hidden globals for videoGL. It is initialized by glInit().
 typedef struct gl_hidden_globals
 {
@@ -81,6 +76,21 @@ typedef struct gl_hidden_globals
     int vramLockTex; // Holds the current lock state of the VRAM banks
     int vramLockPal; // Holds the current lock state of the VRAM banks
 
+    // Next texture and palette names to check in glCompactVRAMStep(), and
+    // whether anything has been moved since the names started from the start.
+    int compactTexName;
+    int compactPalName;
+    bool compactMoved;
+
+    // Deferred texture and palette uploads, see glTexUploadsDefer()
+    gl_upload_entry *uploads;
+    uint32_t uploadCount;
+    uint32_t uploadCapacity;
+    bool uploadsDeferred;
+
+    // Residency manager state
+    s_texResidency residency;
+
     // Texture/palette manamenent
     // --------------------------
 
@@ -127,6 +137,40 @@ gl_hidden_globals;
 // This is the actual data of the globals for videoGL.
 gl_hidden_globals glGlob;
 
+// Callbacks used by the residency manager to access the textures of videoGL
+
+static int glTexResidencyCount(void)
+{
+    return glGlob.texCount;
+}
+
+static int glTexResidencyActive(void)
+{
+    return glGlob.activeTexture;
+}
+
+static s_texResidencyEntry *glTexResidencyGet(int name)
+{
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+    if ((tex == NULL) || (tex->backing == NULL))
+        return NULL;
+
+    return &tex->residency;
+}
+
+static void glTexEvict(int name);
+static bool glTexLoadResident(int name);
+
+static const s_texResidencyCallbacks glTexResidencyCallbacks =
+{
+    .count = glTexResidencyCount,
+    .active = glTexResidencyActive,
+    .get = glTexResidencyGet,
+    .evict = glTexEvict,
+    .load = glTexLoadResident,
+};
+
 ARM_CODE void glRotatef32i(int angle, int32_t x, int32_t y, int32_t z)
 {
     int32_t axis[3];
@@ -356,363 +400,15 @@ ARM_CODE void glTexCoord2f32(int32_t u, int32_t v)
 }
 
 //------------------------------------------------------------------------------
-// Internal VRAM allocation/deallocation functions. Calling these functions
-// outside of videoGL may interfere with normal operations.
-
-int vramBlock_init(s_vramBlock *mb)
-{
-    // Construct a new block that will be set as the first block, as well as the
-    // first empty block.
-    struct s_SingleBlock *newBlock = calloc(1, sizeof(struct s_SingleBlock));
-    if (newBlock == NULL)
-        return 0;
-
-    newBlock->AddrSet = mb->startAddr;
-    newBlock->blockSize = (uint32_t)mb->endAddr - (uint32_t)mb->startAddr;
-
-    mb->firstBlock = mb->firstEmpty = newBlock;
-
-    // Default settings and initializations for up to 16 blocks (will increase
-    // as limit is reached).
-    mb->blockCount = 1;
-    mb->deallocCount = 0;
-
-    mb->lastExamined = NULL;
-    mb->lastExaminedAddr = NULL;
-    mb->lastExaminedSize = 0;
-
-    if (DynamicArrayInit(&mb->blockPtrs, 16) == NULL)
-    {
-        free(newBlock);
-        return 0;
-    }
-    if (DynamicArrayInit(&mb->deallocBlocks, 16) == NULL)
-    {
-        DynamicArrayDelete(&mb->blockPtrs);
-        free(newBlock);
-        return 0;
-    }
-
-    for (int i = 0; i < 16; i++)
-    {
-        // This should always work because we've already allocated 16 elements
-        DynamicArraySet(&mb->blockPtrs, i, (void *)0);
-        DynamicArraySet(&mb->deallocBlocks, i, (void *)0);
-    }
-
-    return 1;
-}
-
-s_vramBlock *vramBlock_Construct(uint8_t *start, uint8_t *end)
-{
-    // Block Container is constructed, with a starting and ending address. Then
-    // initialization of the first block is made.
-    struct s_vramBlock *mb = malloc(sizeof(s_vramBlock));
-    if (mb == NULL)
-        return NULL;
-
-    if (start > end)
-    {
-        mb->startAddr = end;
-        mb->endAddr = start;
-    }
-    else
-    {
-        mb->startAddr = start;
-        mb->endAddr = end;
-    }
-
-    if (vramBlock_init(mb) == 0)
-    {
-        free(mb);
-        return NULL;
-    }
-
-    return mb;
-}
-
-void vramBlock_terminate(s_vramBlock *mb)
-{
-    // Starts at the container's first block, and goes through each sequential block,
-    // deleting them.
-    struct s_SingleBlock *curBlock = mb->firstBlock;
-
-    while (curBlock != NULL)
-    {
-        struct s_SingleBlock *nextBlock = curBlock->node[1];
-        free(curBlock);
-        curBlock = nextBlock;
-    }
-
-    DynamicArrayDelete(&mb->deallocBlocks);
-    DynamicArrayDelete(&mb->blockPtrs);
-}
-
-void vramBlock_Deconstruct(s_vramBlock *mb)
-{
-    // Container must exist for deconstructing
-    if (mb)
-    {
-        vramBlock_terminate(mb);
-        free(mb);
-    }
-}
-
-struct s_SingleBlock *vramBlock__allocateBlock(s_vramBlock *mb,
-                                               struct s_SingleBlock *block,
-                                               uint8_t *addr, uint32_t size)
-{
-    // Initial tests to ensure allocation is valid
-    if (!size || !addr || !block || block->indexOut || addr < block->AddrSet
-        || (addr + size) > (block->AddrSet + block->blockSize))
-        return NULL;
-
-    // Get pointers to the various blocks, as those may change from allocation
-    struct s_SingleBlock **first = &mb->firstBlock;
-    struct s_SingleBlock **alloc = &mb->firstAlloc;
-    struct s_SingleBlock **empty = &mb->firstEmpty;
-
-    // The nodes in the test block array will change as examinations of pre/post
-    // blocks are done
-    struct s_SingleBlock *testBlock[4] = {
-        block->node[0], block->node[1], block->node[2], block->node[3]
-    };
-
-    // Boolean comparisons ( for determining if an empty block set for
-    // allocation should be split once, twice, or not at all )
-    uint32_t valComp[2] = {
-        addr != block->AddrSet,
-        addr + size < block->AddrSet + block->blockSize
-    };
-
-    for (int i = 0; i < 2; i++)
-    {
-        // Generate a new block if condition requires it, based on earlier
-        // comparison
-        if (valComp[i])
-        {
-            // If comparison check is true, then empty block is split in two
-            // empty blocks.  Addresses set, block sizes corrected, and nodes
-            // linked between the two. This can be done up to two times,
-            // resulting in 3 empty blocks sequentially. The middle in this case
-            // will be the true allocated block. If split once in total, either
-            // block will be the true block. Also done is examination of the
-            // first block and first empty block, which will be set as well.
-
-            struct s_SingleBlock *newBlock = malloc(sizeof(struct s_SingleBlock));
-            if (newBlock == NULL)
-                return NULL;
-
-            newBlock->indexOut = 0;
-            newBlock->AddrSet = block->AddrSet + (i * size);
-
-            if (i)
-            {
-                newBlock->blockSize = block->blockSize - size;
-                block->blockSize = size;
-            }
-            else
-            {
-                newBlock->blockSize = (uint32_t)addr - (uint32_t)block->AddrSet;
-                block->AddrSet = addr;
-                block->blockSize -= newBlock->blockSize;
-                if (block == *first)
-                    *first = newBlock;
-            }
-
-            // To get an idea of what the nodes represent, the first two in the
-            // array refer to the immediate pre/post blocks, which can be either
-            // empty or allocated blocks. The last two in the array refer to the
-            // prior/next blocks of the same type (empty or allocated), which
-            // can skip over blocks of a differing type. This allows for quick
-            // examination of similar blocks while keeping the organization of
-            // all the blocks in an ordered fashion. Think of it like a
-            // doubly-doubly linked list.
-
-            newBlock->node[1 - i] = block;
-            newBlock->node[i] = testBlock[i];
-            newBlock->node[i + 2] = testBlock[i + 2];
-
-            block->node[i] = newBlock;
-            if (testBlock[i])
-                testBlock[i]->node[1 - i] = newBlock;
-            if (testBlock[i + 2])
-                testBlock[i + 2]->node[3 - i] = newBlock;
-
-            testBlock[i + 2] = newBlock;
-
-            if (block == *empty)
-                *empty = newBlock;
-        }
-    }
-
-    // Finish off node linking (in this case, NULL is possible, which refers to
-    // the end of the block sequences)
-    if (testBlock[2])
-        testBlock[2]->node[3] = testBlock[3];
-    if (testBlock[3])
-        testBlock[3]->node[2] = testBlock[2];
-
-    // The condition of examining the first empty block is needed, in case the
-    // comparison check early is false for both
-    if (block == *empty)
-        *empty = block->node[3];
-
-    block->node[2] = testBlock[0];
-    block->node[3] = testBlock[1];
-
-    if (testBlock[0])
-        testBlock[0]->node[3] = block;
-    else
-        *alloc = block;
-
-    if (testBlock[1])
-        testBlock[1]->node[2] = block;
-
-    return block;
-}
-
-uint32_t vramBlock__deallocateBlock(s_vramBlock *mb, struct s_SingleBlock *block)
-{
-    // Test to see if this is an allocated block
-    if (!block->indexOut)
-        return 0;
-
-    struct s_SingleBlock **first = &mb->firstBlock;
-    struct s_SingleBlock **alloc = &mb->firstAlloc;
-    struct s_SingleBlock **empty = &mb->firstEmpty;
-
-    // Unlike empty blocks, allocated blocks can be next to each other to help
-    // retain the actual spaces being allocated.
-    //
-    // This is why when contructing the Test Block for the deallocation process,
-    // it fills it with the prior/next links for both sets instead of including
-    // the immediate pre/post blocks for figuring out the prior/next closest
-    // empty block
-    struct s_SingleBlock *testBlock[4] = { block->node[2], block->node[3], block->node[2],
-                                           block->node[3] };
-
-    for (int i = 0; i < 2; i++)
-    {
-        // If the immediate prior/next test link is not the block's immediate
-        // prior/next link (meaning an empty block separates them), then set the
-        // prior/next link to that empty block.
-
-        if (testBlock[i] != block->node[i])
-        {
-            testBlock[i + 2] = block->node[i];
-        }
-        else
-        {
-            // If not, then scan through the prior/next links until either an
-            // empty block is found, or no blocks (NULL) are found
-            while (testBlock[i + 2] && testBlock[i + 2]->indexOut)
-                testBlock[i + 2] = testBlock[i + 2]->node[i];
-        }
-    }
-
-    // Begin initial "rewiring" stage for when the block transitions from
-    // allocated to empty
-    if (testBlock[0])
-        testBlock[0]->node[3] = testBlock[1];
-    if (testBlock[1])
-        testBlock[1]->node[2] = testBlock[0];
-    if (testBlock[2])
-        testBlock[2]->node[3] = block;
-    if (testBlock[3])
-        testBlock[3]->node[2] = block;
-
-    block->node[2] = testBlock[2];
-    block->node[3] = testBlock[3];
-    block->indexOut = 0;
-
-    // If this block was the first allocated block of the group, then pass
-    // allocation lead to next one, even if that is NULL
-    if (block == *alloc)
-        *alloc = testBlock[1];
-
-    for (int i = 0; i < 2; i++)
-    {
-        if (testBlock[i + 2])
-        {
-            // If true, then we must do more rewiring, as well as merging blocks
-            // together. This also includes reassigning the first block and
-            // first empty block if necessary
-            if (testBlock[i + 2] == block->node[i])
-            {
-                block->node[i] = testBlock[i + 2]->node[i];
-
-                if (block->node[i])
-                    block->node[i]->node[1 - i] = block;
-
-                block->node[i + 2] = testBlock[i + 2]->node[i + 2];
-
-                if (block->node[i + 2])
-                    block->node[i + 2]->node[3 - i] = block;
-
-                block->blockSize += testBlock[i + 2]->blockSize;
-
-                if (!i)
-                {
-                    block->AddrSet = testBlock[2]->AddrSet;
-                    if (testBlock[2] == *first)
-                        *first = block;
-                }
-
-                if (testBlock[i + 2] == *empty)
-                    *empty = block;
-
-                free(testBlock[i + 2]);
-
-                // Even if the above did not happen, there is still a chance the
-                // new deallocated block may now be the first empty block, so
-                // assign it if that is the case.
-            }
-            else if (i && testBlock[i + 2] == *empty)
-            {
-                *empty = block;
-            }
-        }
-    }
-
-    return 1;
-}
+// Banks that the VRAM allocator can't use (see vram_block.h)
 
-uint8_t *vramBlock_examineSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size,
-                                  uint8_t align)
+void vramBlock_getLockedBanks(uint8_t *addr, uint8_t **bankLock,
+                              uint32_t *bankSize)
 {
-    // Simple validity tests
-    if (!addr || !mb->firstEmpty || !size || align >= 8)
-        return NULL;
-
-    // Start with the first empty block
-    struct s_SingleBlock *block = mb->firstEmpty;
-
-    // Set these value to 0/NULL (should only be filled in with valid data in
-    // case of error), and copy the address to start checking.
-    mb->lastExamined = NULL;
-    mb->lastExaminedAddr = NULL;
-    mb->lastExaminedSize = 0;
-    uint8_t *checkAddr = addr;
-
-    // If the address is within a valid block, examine if it will initially fit
-    // in it.
-    while (block && checkAddr >= block->AddrSet + block->blockSize)
-        block = block->node[3];
-
-    if (!block)
-        return NULL;
-
-    // Move the address up if before the first valid block
-    if (checkAddr < block->AddrSet)
-        checkAddr = block->AddrSet;
-
-    uint8_t *bankLock[5] = { 0x0 };
-    uint32_t bankSize[5] = { 0x0 };
     uint32_t curBank = 0;
 
     // Values that hold which banks to examine
-    uint32_t isNotMainBank = (checkAddr >= (uint8_t *)VRAM_E ? 1 : 0);
+    uint32_t isNotMainBank = (addr >= (uint8_t *)VRAM_E ? 1 : 0);
     uint32_t vramCtrl = (isNotMainBank ? VRAM_EFG_CR : VRAM_CR);
     int vramLock = isNotMainBank ? glGlob.vramLockPal : glGlob.vramLockTex;
     uint32_t iEnd = (isNotMainBank ? 3 : 4);
@@ -740,205 +436,9 @@ uint8_t *vramBlock_examineSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size,
         vramCtrl >>= 8;
         vramLock >>= 1;
     }
-    curBank = 0;
-
-    // Retrieve the available area from this block using the address given
-    uint32_t curBlockSize =
-        block->blockSize - ((uint32_t)checkAddr - (uint32_t)block->AddrSet);
-    do
-    {
-        // Do address adjustments based on locked banks
-        if (bankLock[curBank])
-        {
-            // Skip to corresponding bank that address is in
-            while (bankLock[curBank]
-                   && checkAddr >= (bankLock[curBank] + bankSize[curBank]))
-            {
-                curBank++;
-            }
-
-            do
-            {
-                // Examine is address is within locked bank, and push it to next
-                // bank if needed
-                if (bankLock[curBank] && checkAddr >= bankLock[curBank]
-                    && checkAddr < bankLock[curBank] + bankSize[curBank])
-                {
-                    checkAddr = bankLock[curBank] + bankSize[curBank];
-                }
-                else
-                {
-                    break;
-                }
-            } while (bankLock[++curBank] != NULL);
-
-            // Continue block and address adjustments
-            while (block && checkAddr >= block->AddrSet + block->blockSize)
-                block = block->node[3];
-
-            if (!block)
-                return NULL;
-
-            if (checkAddr < block->AddrSet)
-                checkAddr = block->AddrSet;
-
-            // Adjust the blocks available size based on address location within
-            // said block
-            if (bankLock[curBank]
-                && bankLock[curBank] < block->AddrSet + block->blockSize)
-            {
-                curBlockSize = (uint32_t)bankLock[curBank] - (uint32_t)checkAddr;
-            }
-            else
-            {
-                curBlockSize =
-                    block->blockSize - ((uint32_t)checkAddr - (uint32_t)block->AddrSet);
-            }
-        }
-
-        // Obtained an aligned address, and adjust the available area that can
-        // be used
-        uint8_t *aligned_checkAddr =
-            (uint8_t *)(((uint32_t)checkAddr + ((1 << align) - 1)) & (~((1 << align) - 1)));
-        uint32_t excess = ((uint32_t)aligned_checkAddr - (uint32_t)checkAddr);
-        curBlockSize -= excess;
-
-        if (curBlockSize >= size)
-        {
-            mb->lastExamined = block;
-            mb->lastExaminedAddr = aligned_checkAddr;
-            mb->lastExaminedSize = size;
-            return aligned_checkAddr;
-        }
-        else
-        {
-            if (bankLock[curBank]
-                && bankLock[curBank] < block->AddrSet + block->blockSize)
-            {
-                checkAddr = bankLock[curBank] + bankSize[curBank];
-                curBlockSize = 0;
-            }
-            else
-            {
-                block = block->node[3];
-
-                if (!block)
-                    return NULL;
-
-                checkAddr = block->AddrSet;
-                curBlockSize = block->blockSize;
-            }
-        }
-    } while (block != NULL);
-
-    return NULL;
-}
-
-uint32_t vramBlock_allocateSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size)
-{
-    // Simple validity tests. Special allocations require "examination" data
-    if (!addr || !size || !mb->lastExamined || !mb->lastExaminedAddr)
-        return 0;
-
-    if (mb->lastExaminedAddr != addr || mb->lastExaminedSize != size)
-        return 0;
-
-    // Can only get here if prior tests passed, meaning a spot is available, and
-    // can be allocated
-    struct s_SingleBlock *newBlock = vramBlock__allocateBlock(mb, mb->lastExamined, addr, size);
-    if (newBlock == NULL)
-        return 0;
-
-    // with current implementation, it should never be false if it gets to here
-    uint32_t curBlock;
-
-    // Use a prior index if one exists. Else, obtain a new index
-    if (mb->deallocCount)
-        curBlock = (uint32_t)DynamicArrayGet(&mb->deallocBlocks, mb->deallocCount--);
-    else
-        curBlock = mb->blockCount++;
-
-    DynamicArraySet(&mb->blockPtrs, curBlock, (void *)newBlock);
-    // Clear out examination data
-    mb->lastExamined = NULL;
-    mb->lastExaminedAddr = NULL;
-    mb->lastExaminedSize = 0;
-    newBlock->indexOut = curBlock;
-    return curBlock;
-}
-
-uint32_t vramBlock_allocateBlock(s_vramBlock *mb, uint32_t size, uint8_t align)
-{
-    // Simple valid tests, such as if there are no more empty blocks as
-    // indicated by "firstEmpty"
-    if (mb->firstEmpty == NULL || !size || align >= 8)
-        return 0;
-
-    // Grab the first empty block, and begin examination for a valid spot from
-    // there
-    struct s_SingleBlock *block = mb->firstEmpty;
-    uint8_t *checkAddr = vramBlock_examineSpecial(mb, block->AddrSet, size, align);
-    if (checkAddr == NULL)
-        return 0;
-
-    // If execution gets here, then a spot was found, so allocate it
-    return vramBlock_allocateSpecial(mb, checkAddr, size);
-}
-
-// TODO: The return value of this function isn't checked anywhere, but I'm not
-// sure if this is the right approach. All we can do if we fail to deallocate
-// memory is crash.
-uint32_t vramBlock_deallocateBlock(s_vramBlock *mb, uint32_t index)
-{
-    // Retrieve the block from the index array, and see if it exists. If it
-    // does, and is deallocated (which it should), remove from index list
-    struct s_SingleBlock *block = DynamicArrayGet(&mb->blockPtrs, index);
-
-    if (block && vramBlock__deallocateBlock(mb, block))
-    {
-        // Clear the current element
-        DynamicArraySet(&mb->blockPtrs, index, NULL);
-
-        // Add the block to the array of deallocated blocks
-        if (!DynamicArraySet(&mb->deallocBlocks, ++mb->deallocCount, (void *)index))
-        {
-            // It's pretty hard to recover from this. At least, try to detect it
-            // in debug builds.
-            sassert(false, "Can't add block to deallocBlocks");
-            return 0;
-        }
-        return 1;
-    }
-    return 0;
-}
-
-int vramBlock_deallocateAll(s_vramBlock *mb)
-{
-    // Reset the entire container
-    vramBlock_terminate(mb);
-    if (vramBlock_init(mb) == 0)
-        return 0;
-
-    return 1;
-}
-
-uint8_t *vramBlock_getAddr(s_vramBlock *mb, uint32_t index)
-{
-    struct s_SingleBlock *getBlock = DynamicArrayGet(&mb->blockPtrs, index);
-    if (getBlock)
-        return getBlock->AddrSet;
-
-    return NULL;
-}
-
-// TODO: This is unused. Remove?
-uint32_t vramBlock_getSize(s_vramBlock *mb, uint32_t index)
-{
-    struct s_SingleBlock *getBlock = DynamicArrayGet(&mb->blockPtrs, index);
-    if (getBlock)
-        return getBlock->blockSize;
 
-    return 0;
+    bankLock[curBank] = NULL;
+    bankSize[curBank] = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -967,6 +467,7 @@ int glInit(void)
 
     glGlob.activeTexture = 0;
     glGlob.activePalette = 0;
+    texResidency_init(&glGlob.residency, &glTexResidencyCallbacks);
     glGlob.texCount = 1;
     glGlob.palCount = 1;
     glGlob.deallocTexSize = 0;
@@ -1063,20 +564,297 @@ int glInit(void)
     glMatrixMode(GL_TEXTURE);
     glLoadIdentity();
 
-    // Set the GL state as active in the global state struct
-    glGlob.isActive = 1;
+    // Set the GL state as active in the global state struct
+    glGlob.isActive = 1;
+
+    return 1;
+
+cleanup:
+    DynamicArrayDelete(&glGlob.texturePtrs);
+    DynamicArrayDelete(&glGlob.palettePtrs);
+    DynamicArrayDelete(&glGlob.deallocTex);
+    DynamicArrayDelete(&glGlob.deallocPal);
+
+    vramBlock_Deconstruct(glGlob.vramBlocksTex);
+    vramBlock_Deconstruct(glGlob.vramBlocksPal);
+    return 0;
+}
+
+// Copies a GL_RGB texture setting the alpha bit of all texels, which turns it
+// into a GL_RGBA texture. Textures are always a multiple of 16 bytes in size,
+// so it copies 4 words per iteration to let the compiler use LDM and STM.
+ARM_CODE static void glCopyTexRGB(void *dst, const void *src, uint32_t size)
+{
+    uint32_t *d = dst;
+    const uint32_t *s = src;
+
+    for (size >>= 4; size > 0; size--)
+    {
+        uint32_t a = s[0], b = s[1], c = s[2], e = s[3];
+        s += 4;
+
+        d[0] = a | 0x80008000;
+        d[1] = b | 0x80008000;
+        d[2] = c | 0x80008000;
+        d[3] = e | 0x80008000;
+        d += 4;
+    }
+}
+
+// Returns a mask with a bit set for each VRAM bank touched by an area of VRAM
+// (bit 0 = bank A, ..., bit 6 = bank G).
+static uint32_t glVramBankMask(const void *addr, uint32_t size)
+{
+    static const struct
+    {
+        uintptr_t base;
+        uint32_t size;
+    } banks[7] = {
+        { (uintptr_t)VRAM_A, 128 * 1024 },
+        { (uintptr_t)VRAM_B, 128 * 1024 },
+        { (uintptr_t)VRAM_C, 128 * 1024 },
+        { (uintptr_t)VRAM_D, 128 * 1024 },
+        { (uintptr_t)VRAM_E, 64 * 1024 },
+        { (uintptr_t)VRAM_F, 16 * 1024 },
+        { (uintptr_t)VRAM_G, 16 * 1024 },
+    };
+
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end = start + size;
+    uint32_t mask = 0;
+
+    for (int i = 0; i < 7; i++)
+    {
+        if ((start < banks[i].base + banks[i].size) && (end > banks[i].base))
+            mask |= BIT(i);
+    }
+
+    return mask;
+}
+
+// Maps the banks of a mask returned by glVramBankMask() as LCD.
+static void glVramBanksToLCD(uint32_t mask)
+{
+    if (mask & BIT(0))
+        vramSetBankA(VRAM_A_LCD);
+    if (mask & BIT(1))
+        vramSetBankB(VRAM_B_LCD);
+    if (mask & BIT(2))
+        vramSetBankC(VRAM_C_LCD);
+    if (mask & BIT(3))
+        vramSetBankD(VRAM_D_LCD);
+    if (mask & BIT(4))
+        vramSetBankE(VRAM_E_LCD);
+    if (mask & BIT(5))
+        vramSetBankF(VRAM_F_LCD);
+    if (mask & BIT(6))
+        vramSetBankG(VRAM_G_LCD);
+}
+
+// Copies data to VRAM. The destination banks must be mapped as LCD.
+static void glUploadCopy(const gl_upload_entry *entry)
+{
+    if (entry->setAlpha)
+    {
+        glCopyTexRGB(entry->dst, entry->src, entry->size);
+    }
+    else if (entry->isPalette)
+    {
+        // Palettes may not be a multiple of 4 bytes in size
+        DC_FlushRange(entry->src, entry->size);
+        dmaCopyHalfWords(0, entry->src, entry->dst, entry->size);
+    }
+    else
+    {
+        DC_FlushRange(entry->src, entry->size);
+        dmaCopyWords(0, entry->src, entry->dst, entry->size);
+    }
+}
+
+// Copies data to VRAM right now, or adds it to the queue of uploads if uploads
+// are deferred.
+static void glUpload(int name, bool isPalette, bool setAlpha, const void *src,
+                     void *dst, uint32_t size)
+{
+    gl_upload_entry entry = {
+        .src = src,
+        .dst = dst,
+        .size = size,
+        .name = name,
+        .isPalette = isPalette,
+        .setAlpha = setAlpha,
+    };
+
+    if (glGlob.uploadsDeferred)
+    {
+        if (glGlob.uploadCount == glGlob.uploadCapacity)
+        {
+            uint32_t capacity = glGlob.uploadCapacity ? glGlob.uploadCapacity * 2 : 16;
+            gl_upload_entry *uploads = realloc(glGlob.uploads,
+                                               capacity * sizeof(gl_upload_entry));
+            if (uploads != NULL)
+            {
+                glGlob.uploads = uploads;
+                glGlob.uploadCapacity = capacity;
+            }
+        }
+
+        if (glGlob.uploadCount < glGlob.uploadCapacity)
+        {
+            glGlob.uploads[glGlob.uploadCount++] = entry;
+            return;
+        }
+
+        // If the queue can't grow, copy the data right away
+    }
+
+    // The copy uses DMA channel 0, like glCallListAsync()
+    glListQueueWaitIdle();
+
+    uint32_t vramTemp = VRAM_CR;
+    uint32_t vramTempEFG = VRAM_EFG_CR;
+
+    glVramBanksToLCD(glVramBankMask(dst, size));
+    glUploadCopy(&entry);
+
+    vramRestorePrimaryBanks(vramTemp);
+    vramRestoreBanks_EFG(vramTempEFG);
+}
+
+// Removes all deferred uploads of a texture or palette. This is needed when
+// its VRAM is freed or when it is going to be loaded again.
+static void glUploadsDrop(int name, bool isPalette)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < glGlob.uploadCount; i++)
+    {
+        gl_upload_entry *entry = &glGlob.uploads[i];
+
+        if ((entry->name == name) && (entry->isPalette == isPalette))
+            continue;
+
+        glGlob.uploads[count++] = *entry;
+    }
+
+    glGlob.uploadCount = count;
+}
+
+bool glTexUploadsFlush(size_t max_bytes)
+{
+    if (glGlob.uploadCount == 0)
+        return true;
+
+    // Take entries from the start of the queue until the limit is reached
+    uint32_t count = 0;
+    uint32_t mask = 0;
+    size_t bytes = 0;
+
+    while (count < glGlob.uploadCount)
+    {
+        gl_upload_entry *entry = &glGlob.uploads[count];
+
+        if ((count != 0) && (bytes + entry->size > max_bytes))
+            break;
+
+        bytes += entry->size;
+        mask |= glVramBankMask(entry->dst, entry->size);
+        count++;
+    }
+
+    // The copies use DMA channel 0, like glCallListAsync()
+    glListQueueWaitIdle();
+
+    // Map all the banks once for the whole batch
+    uint32_t vramTemp = VRAM_CR;
+    uint32_t vramTempEFG = VRAM_EFG_CR;
+
+    glVramBanksToLCD(mask);
+
+    for (uint32_t i = 0; i < count; i++)
+        glUploadCopy(&glGlob.uploads[i]);
+
+    vramRestorePrimaryBanks(vramTemp);
+    vramRestoreBanks_EFG(vramTempEFG);
+
+    // Remove the entries that have been copied
+    glGlob.uploadCount -= count;
+    memmove(&glGlob.uploads[0], &glGlob.uploads[count],
+            glGlob.uploadCount * sizeof(gl_upload_entry));
+
+    return glGlob.uploadCount == 0;
+}
+
+bool glTexUploadsFlushBuffer(const void *src, size_t size)
+{
+    const uint8_t *start = src;
+    const uint8_t *end = start + size;
+
+    // Look for entries that read from the buffer
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < glGlob.uploadCount; i++)
+    {
+        gl_upload_entry *entry = &glGlob.uploads[i];
+        const uint8_t *entryStart = entry->src;
+
+        if ((entryStart < end) && (entryStart + entry->size > start))
+            mask |= glVramBankMask(entry->dst, entry->size);
+    }
+
+    if (mask == 0)
+        return false;
+
+    // The copies use DMA channel 0, like glCallListAsync()
+    glListQueueWaitIdle();
+
+    uint32_t vramTemp = VRAM_CR;
+    uint32_t vramTempEFG = VRAM_EFG_CR;
+
+    glVramBanksToLCD(mask);
+
+    // Copy the entries and remove them from the queue, keeping the order of
+    // the rest of the entries.
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < glGlob.uploadCount; i++)
+    {
+        gl_upload_entry *entry = &glGlob.uploads[i];
+        const uint8_t *entryStart = entry->src;
+
+        if ((entryStart < end) && (entryStart + entry->size > start))
+        {
+            glUploadCopy(entry);
+            continue;
+        }
+
+        glGlob.uploads[count++] = *entry;
+    }
+
+    glGlob.uploadCount = count;
+
+    vramRestorePrimaryBanks(vramTemp);
+    vramRestoreBanks_EFG(vramTempEFG);
+
+    return true;
+}
+
+void glTexUploadsDefer(bool defer)
+{
+    glGlob.uploadsDeferred = defer;
+
+    if (!defer)
+        glTexUploadsFlush(SIZE_MAX);
+}
 
-    return 1;
+size_t glTexUploadsPending(void)
+{
+    size_t bytes = 0;
 
-cleanup:
-    DynamicArrayDelete(&glGlob.texturePtrs);
-    DynamicArrayDelete(&glGlob.palettePtrs);
-    DynamicArrayDelete(&glGlob.deallocTex);
-    DynamicArrayDelete(&glGlob.deallocPal);
+    for (uint32_t i = 0; i < glGlob.uploadCount; i++)
+        bytes += glGlob.uploads[i].size;
 
-    vramBlock_Deconstruct(glGlob.vramBlocksTex);
-    vramBlock_Deconstruct(glGlob.vramBlocksPal);
-    return 0;
+    return bytes;
 }
 
 void glResetTextures(void)
@@ -1090,6 +868,8 @@ void glResetTextures(void)
     glGlob.palCount = 1;
     glGlob.deallocTexSize = 0;
     glGlob.deallocPalSize = 0;
+    glGlob.uploadCount = 0;
+    glGlob.residency.residentBytes = 0;
 
     // Any textures in use will be clean of all their data
     for (unsigned int i = 0; i < glGlob.texturePtrs.cur_size; i++)
@@ -1097,6 +877,8 @@ void glResetTextures(void)
         gl_texture_data *texture = DynamicArrayGet(&glGlob.texturePtrs, i);
         if (texture)
         {
+            if (texture->backingOwned)
+                free((void *)texture->backing);
             free(texture);
             DynamicArraySet(&glGlob.texturePtrs, i, NULL);
         }
@@ -1158,6 +940,7 @@ static void removePaletteFromTexture(gl_texture_data *tex)
     if (palette->connectCount <= 0)
     {
         vramBlock_deallocateBlock(glGlob.vramBlocksPal, palette->palIndex);
+        glUploadsDrop(tex->palIndex, true);
 
         DynamicArraySet(&glGlob.deallocPal, glGlob.deallocPalSize, (void *)tex->palIndex);
         glGlob.deallocPalSize++;
@@ -1174,6 +957,41 @@ static void removePaletteFromTexture(gl_texture_data *tex)
     tex->palIndex = 0;
 }
 
+// Removes a texture from VRAM, keeping the copy in RAM of the residency
+// manager so that it can be loaded again later.
+static void glTexEvict(int name)
+{
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+    glUploadsDrop(name, false);
+
+    if (tex->texIndexExt)
+        vramBlock_deallocateBlock(glGlob.vramBlocksTex, tex->texIndexExt);
+    if (tex->texIndex)
+        vramBlock_deallocateBlock(glGlob.vramBlocksTex, tex->texIndex);
+
+    tex->texIndex = tex->texIndexExt = 0;
+    tex->vramAddr = NULL;
+
+    tex->residentFormat = tex->texFormat;
+    tex->texFormat = 0;
+}
+
+// Stops the residency manager from handling a texture.
+static void glTexReleaseBacking(gl_texture_data *tex)
+{
+    if (tex->backing == NULL)
+        return;
+
+    texResidency_remove(&glGlob.residency, &tex->residency);
+
+    if (tex->backingOwned)
+        free((void *)tex->backing);
+
+    tex->backing = NULL;
+    tex->backingOwned = 0;
+}
+
 // Internal function that returns a new texture name
 static int glGenTexture(void)
 {
@@ -1287,11 +1105,15 @@ int glDeleteTextures(int n, int *names)
                 vramBlock_deallocateBlock(glGlob.vramBlocksTex, texture->texIndex);
             }
 
+            glUploadsDrop(names[index], false);
+
             // Clear out the palette if this texture name is the last
             // texture using it
             if (texture->palIndex)
                 removePaletteFromTexture(texture);
 
+            glTexReleaseBacking(texture);
+
             free(texture);
 
             // Clear pointer to mark the name as not having a texture
@@ -1390,6 +1212,243 @@ int glUnlockVRAMBank(uint16_t *addr)
     return 1;
 }
 
+// Returns the offset of a palette inside the texture palette slots, in bytes.
+// The value of VRAM_EFG_CR is passed as an argument because banks may be mapped
+// as LCD when this is called.
+static uint32_t glPaletteSlotOffset(uint8_t *vramAddr, uint32_t efgCr)
+{
+    uint16_t *baseBank = vramGetBank((uint16_t *)vramAddr);
+    uint32_t addr = ((uint32_t)vramAddr - (uint32_t)baseBank);
+    uint8_t offset = 0;
+
+    if (baseBank == VRAM_F)
+        offset = (efgCr >> (8 + 3)) & 3;
+    else if (baseBank == VRAM_G)
+        offset = (efgCr >> (16 + 3)) & 3;
+    addr += ((offset & 0x1) * 0x4000) + ((offset & 0x2) * 0x8000);
+
+    return addr;
+}
+
+// Maximum number of textures or palettes moved by one call to
+// glCompactVRAMStep(). The copies are done after all the moves have been
+// decided, with the banks mapped as LCD only once.
+#define GL_COMPACT_MAX_MOVES    16
+
+typedef struct
+{
+    uint8_t *src;
+    uint8_t *dst;
+    uint32_t size;
+} gl_compact_move;
+
+// Moves a texture to the lowest free spot of texture VRAM that can hold it, if
+// it is lower than its current address. The data is copied later. Returns
+// false if the texture can't be moved.
+static bool glCompactTexture(int name, gl_texture_data *tex,
+                             gl_compact_move *move)
+{
+    // Compressed textures use two blocks that depend on each other, so they
+    // are left where they are.
+    if (!tex->texIndex || tex->texIndexExt || !tex->vramAddr)
+        return false;
+
+    uint8_t *oldAddr = tex->vramAddr;
+    uint32_t size = tex->texSize;
+
+    // Don't move textures out of locked banks, they may be accessed directly
+    uint32_t firstBank = ((uint32_t)oldAddr - (uint32_t)VRAM_A) / 0x20000;
+    uint32_t lastBank = ((uint32_t)oldAddr + size - 1 - (uint32_t)VRAM_A) / 0x20000;
+    for (uint32_t i = firstBank; i <= lastBank; i++)
+    {
+        if (glGlob.vramLockTex & BIT(i))
+            return false;
+    }
+
+    uint8_t *newAddr = vramBlock_examineSpecial(glGlob.vramBlocksTex,
+                                                (uint8_t *)VRAM_A, size, 3);
+    if ((newAddr == NULL) || (newAddr >= oldAddr))
+        return false;
+
+    uint32_t index = vramBlock_allocateSpecial(glGlob.vramBlocksTex, newAddr, size);
+    if (index == 0)
+        return false;
+
+    vramBlock_deallocateBlock(glGlob.vramBlocksTex, tex->texIndex);
+
+    tex->texIndex = index;
+    tex->vramAddr = newAddr;
+    tex->texFormat = (tex->texFormat & ~0xFFFF) | (((uint32_t)newAddr >> 3) & 0xFFFF);
+
+    if (glGlob.activeTexture == name)
+        GFX_TEX_FORMAT = tex->texFormat;
+
+    move->src = oldAddr;
+    move->dst = newAddr;
+    move->size = size;
+
+    return true;
+}
+
+// Same as glCompactTexture(), but for palettes.
+static bool glCompactPalette(int name, gl_palette_data *pal,
+                             gl_compact_move *move)
+{
+    if (!pal->palIndex || !pal->vramAddr)
+        return false;
+
+    uint8_t *oldAddr = pal->vramAddr;
+    uint32_t size = pal->palSize;
+
+    uint16_t *bank = vramGetBank((uint16_t *)oldAddr);
+    int lockBit = (bank == VRAM_E) ? BIT(0) : (bank == VRAM_F) ? BIT(1) : BIT(2);
+    if (glGlob.vramLockPal & lockBit)
+        return false;
+
+    uint8_t *newAddr = vramBlock_examineSpecial(glGlob.vramBlocksPal,
+                                                (uint8_t *)VRAM_E, size,
+                                                pal->addrShift);
+    if ((newAddr == NULL) || (newAddr >= oldAddr))
+        return false;
+
+    uint32_t addr = glPaletteSlotOffset(newAddr, VRAM_EFG_CR) >> pal->addrShift;
+
+    // 4 color palettes can't be placed past the first 64 KB of palette space
+    if ((pal->addrShift == 3) && (addr >= 0x2000))
+        return false;
+
+    uint32_t index = vramBlock_allocateSpecial(glGlob.vramBlocksPal, newAddr, size);
+    if (index == 0)
+        return false;
+
+    vramBlock_deallocateBlock(glGlob.vramBlocksPal, pal->palIndex);
+
+    pal->palIndex = index;
+    pal->vramAddr = newAddr;
+    pal->addr = addr;
+
+    if (glGlob.activePalette == name)
+        GFX_PAL_FORMAT = addr;
+
+    move->src = oldAddr;
+    move->dst = newAddr;
+    move->size = size;
+
+    return true;
+}
+
+bool glCompactVRAMStep(size_t max_bytes)
+{
+    if (glGlob.isActive == 0)
+        return true;
+
+    gl_compact_move moves[GL_COMPACT_MAX_MOVES];
+    int numMoves = 0;
+    size_t moved = 0;
+    bool done = false;
+
+    // Data that hasn't been copied to VRAM yet can't be moved
+    glTexUploadsFlush(SIZE_MAX);
+
+    // Decide which textures and palettes to move. This needs the banks to be
+    // mapped normally, as the allocator skips banks not mapped for textures.
+    while (numMoves < GL_COMPACT_MAX_MOVES)
+    {
+        if (glGlob.compactTexName < 1)
+            glGlob.compactTexName = 1;
+        if (glGlob.compactPalName < 1)
+            glGlob.compactPalName = 1;
+
+        if (glGlob.compactTexName < glGlob.texCount)
+        {
+            int name = glGlob.compactTexName;
+            gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+            if (tex && (moved != 0) && (moved + tex->texSize > max_bytes))
+                break;
+
+            glGlob.compactTexName++;
+
+            if (tex && glCompactTexture(name, tex, &moves[numMoves]))
+            {
+                moved += moves[numMoves++].size;
+                glGlob.compactMoved = true;
+            }
+        }
+        else if (glGlob.compactPalName < glGlob.palCount)
+        {
+            int name = glGlob.compactPalName;
+            gl_palette_data *pal = DynamicArrayGet(&glGlob.palettePtrs, name);
+
+            if (pal && (moved != 0) && (moved + pal->palSize > max_bytes))
+                break;
+
+            glGlob.compactPalName++;
+
+            if (pal && glCompactPalette(name, pal, &moves[numMoves]))
+            {
+                moved += moves[numMoves++].size;
+                glGlob.compactMoved = true;
+            }
+        }
+        else
+        {
+            // A pass over all textures and palettes has ended. If nothing has
+            // been moved in the whole pass, there is nothing left to do.
+            glGlob.compactTexName = 1;
+            glGlob.compactPalName = 1;
+
+            bool movedInPass = glGlob.compactMoved;
+            glGlob.compactMoved = false;
+
+            if (!movedInPass)
+            {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    if (numMoves == 0)
+        return done;
+
+    // The copies use DMA channel 0, like glCallListAsync()
+    glListQueueWaitIdle();
+
+    // Map the banks used by textures and palettes as LCD to copy the data. The
+    // copies need to be done in order, as a destination may be the old
+    // location of a previous move.
+    uint32_t vramTemp = VRAM_CR;
+    uint32_t vramTempEFG = VRAM_EFG_CR;
+
+    vu8 *vramCtrl = &VRAM_A_CR;
+    for (int i = 0; i < 4; i++)
+    {
+        if ((vramCtrl[i] & 0x83) == 0x83)
+            vramCtrl[i] = VRAM_ENABLE;
+    }
+
+    vramCtrl = &VRAM_E_CR;
+    for (int i = 0; i < 3; i++)
+    {
+        if ((vramCtrl[i] & 0x83) == 0x83)
+            vramCtrl[i] = VRAM_ENABLE;
+    }
+
+    for (int i = 0; i < numMoves; i++)
+        dmaCopyHalfWords(0, moves[i].src, moves[i].dst, moves[i].size);
+
+    vramRestorePrimaryBanks(vramTemp);
+    vramRestoreBanks_EFG(vramTempEFG);
+
+    return done;
+}
+
+void glCompactVRAM(void)
+{
+    while (!glCompactVRAMStep(SIZE_MAX));
+}
+
 // Set the current named texture to the active texture. The target is ignored as
 // all DS textures are 2D.
 int glBindTexture(int target, int name)
@@ -1412,6 +1471,11 @@ int glBindTexture(int target, int name)
         return 0;
     }
 
+    // The texture format is 0 while the texture isn't in VRAM. It will be
+    // loaded again by glTexResidencyUpdate().
+    if (tex->backing)
+        texResidency_use(&glGlob.residency, &tex->residency);
+
     GFX_TEX_FORMAT = tex->texFormat;
     glGlob.activeTexture = name;
 
@@ -1472,15 +1536,7 @@ int glColorTableEXT(int target, int empty1, uint16_t width, int empty2, int empt
     }
 
     // Calculate the address, logical and actual, of where the palette will go
-    uint16_t *baseBank = vramGetBank((uint16_t *)checkAddr);
-    uint32_t addr = ((uint32_t)checkAddr - (uint32_t)baseBank);
-    uint8_t offset = 0;
-
-    if (baseBank == VRAM_F)
-        offset = (VRAM_F_CR >> 3) & 3;
-    else if (baseBank == VRAM_G)
-        offset = (VRAM_G_CR >> 3) & 3;
-    addr += ((offset & 0x1) * 0x4000) + ((offset & 0x2) * 0x8000);
+    uint32_t addr = glPaletteSlotOffset(checkAddr, VRAM_EFG_CR);
 
     addr >>= colFormatVal;
     if (colFormatVal == 3 && addr >= 0x2000)
@@ -1530,6 +1586,7 @@ int glColorTableEXT(int target, int empty1, uint16_t width, int empty2, int empt
 
     palette->vramAddr = checkAddr;
     palette->addr = addr;
+    palette->addrShift = colFormatVal;
 
     palette->connectCount = 1;
     palette->palSize = width << 1;
@@ -1542,31 +1599,8 @@ int glColorTableEXT(int target, int empty1, uint16_t width, int empty2, int empt
     if (table == NULL)
         return 1;
 
-    // Copy straight to VRAM, and assign a palette name
-    uint32_t tempVRAM = VRAM_EFG_CR;
-    uint16_t *startBank = vramGetBank((uint16_t *)palette->vramAddr);
-    uint16_t *endBank = vramGetBank((uint16_t *)((char *)palette->vramAddr + (width << 1) - 1));
-    do
-    {
-        if (startBank == VRAM_E)
-        {
-            vramSetBankE(VRAM_E_LCD);
-            startBank += 0x8000;
-        }
-        else if (startBank == VRAM_F)
-        {
-            vramSetBankF(VRAM_F_LCD);
-            startBank += 0x2000;
-        }
-        else if (startBank == VRAM_G)
-        {
-            vramSetBankG(VRAM_G_LCD);
-            startBank += 0x2000;
-        }
-    } while (startBank <= endBank);
-
-    swiCopy(table, palette->vramAddr, width | COPY_MODE_HWORD);
-    vramRestoreBanks_EFG(tempVRAM);
+    // Copy the palette to VRAM (or queue it if uploads are deferred)
+    glUpload(texture->palIndex, true, false, table, palette->vramAddr, width << 1);
 
     return 1;
 }
@@ -1590,10 +1624,10 @@ int glColorSubTableEXT(int target, int start, int count, int empty1, int empty2,
 
     if (start >= 0 && (start + count) <= (palette->palSize >> 1))
     {
-        uint32_t tempVRAM = vramSetBanks_EFG(VRAM_E_LCD, VRAM_F_LCD, VRAM_G_LCD);
-        swiCopy(data, (char *)palette->vramAddr + (start << 1),
-                count | COPY_MODE_HWORD);
-        vramRestoreBanks_EFG(tempVRAM);
+        // This goes through the queue of deferred uploads so that it isn't
+        // overwritten by a previous upload of the same palette.
+        glUpload(glGlob.activePalette, true, false, data,
+                 (char *)palette->vramAddr + (start << 1), count << 1);
 
         return 1;
     }
@@ -1614,6 +1648,9 @@ int glGetColorTableEXT(int target, int empty1, int empty2, void *table)
 
     gl_palette_data *palette = DynamicArrayGet(&glGlob.palettePtrs, glGlob.activePalette);
 
+    // Make sure that the palette has reached VRAM
+    glTexUploadsFlush(SIZE_MAX);
+
     uint32_t tempVRAM = vramSetBanks_EFG(VRAM_E_LCD, VRAM_F_LCD, VRAM_G_LCD);
     swiCopy(palette->vramAddr, table, palette->palSize >> 1 | COPY_MODE_HWORD);
     vramRestoreBanks_EFG(tempVRAM);
@@ -1754,6 +1791,36 @@ int glGetColorTableParameterEXT(int target, int pname, int *params)
     return 1;
 }
 
+// Size in bytes of the main data of a texture (without the extra data of
+// compressed textures). The sizes must be in the format of the GPU registers.
+static uint32_t glTexDataSize(GL_TEXTURE_TYPE_ENUM type, int sizeX, int sizeY)
+{
+    uint32_t size = 1 << (sizeX + sizeY + 6);
+
+    switch (type)
+    {
+        case GL_RGB:
+        case GL_RGBA:
+            size = size << 1;
+            break;
+        case GL_RGB4:
+        case GL_COMPRESSED:
+            size = size >> 2;
+            break;
+        case GL_RGB16:
+            size = size >> 1;
+            break;
+        default:
+            break;
+    }
+
+    return size;
+}
+
+static int glTexImage2DInternal(int target, GL_TEXTURE_TYPE_ENUM type,
+                                int sizeX, int sizeY, int param,
+                                const void *texture);
+
 // Similer to glTextImage2D from gl it takes a pointer to data. Empty fields and
 // target are unused but provided for code compatibility. Type is simply the
 // texture type (GL_RGB, GL_RGB8 ect...)
@@ -1763,6 +1830,19 @@ int glTexImage2D(int target, int empty1, GL_TEXTURE_TYPE_ENUM type, int sizeX, i
     (void)empty1;
     (void)empty2;
 
+    // Loading a texture the normal way stops the residency manager from
+    // handling it.
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, glGlob.activeTexture);
+    if (tex != NULL)
+        glTexReleaseBacking(tex);
+
+    return glTexImage2DInternal(target, type, sizeX, sizeY, param, texture);
+}
+
+static int glTexImage2DInternal(int target, GL_TEXTURE_TYPE_ENUM type,
+                                int sizeX, int sizeY, int param,
+                                const void *texture)
+{
     uint32_t size = 0;
     // Represents the number of bits per pixels for each format
     uint32_t typeSizes[9] =
@@ -1793,24 +1873,7 @@ int glTexImage2D(int target, int empty1, GL_TEXTURE_TYPE_ENUM type, int sizeX, i
     if ((sizeX < 0) || (sizeY < 0))
         return 0;
 
-    size = 1 << (sizeX + sizeY + 6);
-
-    switch (type)
-    {
-        case GL_RGB:
-        case GL_RGBA:
-            size = size << 1;
-            break;
-        case GL_RGB4:
-        case GL_COMPRESSED:
-            size = size >> 2;
-            break;
-        case GL_RGB16:
-            size = size >> 1;
-            break;
-        default:
-            break;
-    }
+    size = glTexDataSize(type, sizeX, sizeY);
     if (!size)
         return 0;
 
@@ -1819,6 +1882,9 @@ int glTexImage2D(int target, int empty1, GL_TEXTURE_TYPE_ENUM type, int sizeX, i
 
     gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, glGlob.activeTexture);
 
+    // Deferred uploads of the old texture would overwrite the new one
+    glUploadsDrop(glGlob.activeTexture, false);
+
     // If there is a texture already and its size and bits per pixel are the
     // same as the ones of the new texture, reuse the old buffer. If not, clear
     // the texture data so that a new buffer is allocated.
@@ -1850,6 +1916,12 @@ int glTexImage2D(int target, int empty1, GL_TEXTURE_TYPE_ENUM type, int sizeX, i
         else if (type != GL_COMPRESSED)
         {
             tex->texIndex = vramBlock_allocateBlock(glGlob.vramBlocksTex, tex->texSize, 3);
+
+            // If there isn't enough space, try to make room by evicting
+            // textures handled by the residency manager.
+            while ((tex->texIndex == 0) && texResidency_evictLRU(&glGlob.residency))
+                tex->texIndex = vramBlock_allocateBlock(glGlob.vramBlocksTex, tex->texSize, 3);
+
             // This may fail, but it is handled below.
         }
         else // if (type == GL_COMPRESSED)
@@ -1974,53 +2046,157 @@ int glTexImage2D(int target, int empty1, GL_TEXTURE_TYPE_ENUM type, int sizeX, i
 
     glTexParameter(target, param);
 
-    // Copy the texture data into either VRAM or main memory
+    // Copy the texture data to VRAM (or queue it if uploads are deferred)
     if (type != GL_NOTEXTURE && texture)
     {
-        uint32_t vramTemp = VRAM_CR;
-        uint16_t *startBank = vramGetBank((uint16_t *)tex->vramAddr);
-        uint16_t *endBank = vramGetBank((uint16_t *)((char *)tex->vramAddr + size - 1));
+        glUpload(glGlob.activeTexture, false, type == GL_RGB, texture,
+                 tex->vramAddr, size);
 
-        do
+        if (type == GL_COMPRESSED)
         {
-            if (startBank == VRAM_A)
-                vramSetBankA(VRAM_A_LCD);
-            else if (startBank == VRAM_B)
-                vramSetBankB(VRAM_B_LCD);
-            else if (startBank == VRAM_C)
-                vramSetBankC(VRAM_C_LCD);
-            else if (startBank == VRAM_D)
-                vramSetBankD(VRAM_D_LCD);
-            startBank += 0x10000;
-        } while (startBank <= endBank);
+            glUpload(glGlob.activeTexture, false, false,
+                     (const char *)texture + tex->texSize,
+                     vramBlock_getAddr(glGlob.vramBlocksTex, tex->texIndexExt),
+                     size >> 1);
+        }
+    }
+
+    return 1;
+}
+
+int glTexImage2DResident(int target, int empty1, GL_TEXTURE_TYPE_ENUM type,
+                         int sizeX, int sizeY, int empty2, int param,
+                         const void *texture, bool copy)
+{
+    (void)empty1;
+    (void)empty2;
+
+    if (!glGlob.activeTexture || (texture == NULL))
+        return 0;
+
+    if ((type == GL_NOTEXTURE) || (type > GL_RGB))
+        return 0;
+
+    if (sizeX >= 8)
+        sizeX = glTexSizeToEnum(sizeX);
+    if (sizeY >= 8)
+        sizeY = glTexSizeToEnum(sizeY);
+
+    if ((sizeX < 0) || (sizeY < 0))
+        return 0;
+
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, glGlob.activeTexture);
+    glTexReleaseBacking(tex);
+
+    uint32_t size = glTexDataSize(type, sizeX, sizeY);
+    if (type == GL_COMPRESSED)
+        size += size >> 1;
+
+    const void *backing = texture;
+    GL_TEXTURE_TYPE_ENUM backingType = type;
+
+    if (copy)
+    {
+        void *buffer = malloc(size);
+        if (buffer == NULL)
+            return 0;
 
         if (type == GL_RGB)
         {
+            // Convert the texture now so that it doesn't need to be converted
+            // every time it is loaded to VRAM.
             const uint32_t *src = texture;
-            uint32_t *dest = (uint32_t *)tex->vramAddr;
-            size >>= 2;
-            while (size--)
-            {
-                *dest++ = *src | 0x80008000;
-                src++;
-            }
+            uint32_t *dst = buffer;
+            for (uint32_t i = 0; i < size >> 2; i++)
+                dst[i] = src[i] | 0x80008000;
+
+            backingType = GL_RGBA;
         }
         else
         {
-            DC_FlushRange(texture, size);
-            dmaCopyWords(0, texture, tex->vramAddr, size);
-            if (type == GL_COMPRESSED)
-            {
-                DC_FlushRange((const char *)texture + tex->texSize, size >> 1);
-                vramSetBankB(VRAM_B_LCD);
-                dmaCopyWords(0, (const char *)texture + tex->texSize,
-                             vramBlock_getAddr(glGlob.vramBlocksTex, tex->texIndexExt),
-                             size >> 1);
-            }
+            memcpy(buffer, texture, size);
         }
-        vramRestorePrimaryBanks(vramTemp);
+
+        backing = buffer;
+    }
+
+    // Make room for the new texture if it would go over the budget
+    texResidency_enforceBudget(&glGlob.residency, size);
+
+    if (glTexImage2DInternal(target, backingType, sizeX, sizeY, param, backing) == 0)
+    {
+        if (copy)
+            free((void *)backing);
+        return 0;
+    }
+
+    tex->backing = backing;
+    tex->backingType = backingType;
+    tex->backingOwned = copy;
+    texResidency_add(&glGlob.residency, &tex->residency, size);
+
+    return 1;
+}
+
+// Loads an evicted texture to VRAM again.
+static bool glTexLoadResident(int name)
+{
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+    int oldActive = glGlob.activeTexture;
+    glGlob.activeTexture = name;
+
+    uint32_t format = tex->residentFormat;
+    int ret = glTexImage2DInternal(0, tex->backingType, (format >> 20) & 7,
+                                   (format >> 23) & 7, format & 0xE00F0000,
+                                   tex->backing);
+
+    // Restore the state of the previously active texture
+    glGlob.activeTexture = oldActive;
+    gl_texture_data *active = DynamicArrayGet(&glGlob.texturePtrs, oldActive);
+    GFX_TEX_FORMAT = (active != NULL) ? active->texFormat : 0;
+
+    if (ret == 0)
+    {
+        // glTexImage2D() clears the format when it fails
+        tex->texFormat = 0;
+        return false;
     }
 
+    return true;
+}
+
+void glTexResidencyUpdate(size_t max_bytes)
+{
+    texResidency_update(&glGlob.residency, max_bytes);
+}
+
+void glTexResidencySetBudget(size_t bytes)
+{
+    texResidency_setBudget(&glGlob.residency, bytes);
+}
+
+size_t glTexResidencyGetUsage(void)
+{
+    return glGlob.residency.residentBytes;
+}
+
+bool glTexIsResident(int name)
+{
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+    return (tex != NULL) && (tex->texIndex != 0);
+}
+
+int glTexPrefetch(int name)
+{
+    gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+    if ((tex == NULL) || (tex->backing == NULL))
+        return 0;
+
+    texResidency_prefetch(&tex->residency);
+
     return 1;
 }
 
@@ -2130,6 +2306,9 @@ void glCallList(const void *list)
 
     sassert(count != 0, "glCallList received a display list of size 0");
 
+    // Lists sent with glCallListAsync() need to go to the FIFO first
+    glListQueueWaitIdle();
+
     // Flush the area that we are going to DMA
     DC_FlushRange(ptr, count * 4);
 
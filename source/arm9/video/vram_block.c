@@ -0,0 +1,614 @@
+// SPDX-License-Identifier: Zlib
+// SPDX-FileNotice: Modified from the original version by the BlocksDS project.
+//
+// Copyright (C) 2005 Michael Noland (joat)
+// Copyright (C) 2005 Jason Rogers (dovoto)
+// Copyright (C) 2005 Dave Murphy (WinterMute)
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <nds/arm9/dynamicArray.h>
+#include <nds/arm9/sassert.h>
+#include <nds/ndstypes.h>
+
+#include "vram_block.h"
+
+// Internal VRAM allocation/deallocation functions. Calling these functions
+// outside of videoGL may interfere with normal operations.
+//
+// All blocks (empty and allocated) are kept in a list sorted by address, used
+// to merge empty blocks when a block is freed. Empty blocks are also kept in
+// lists of blocks of similar sizes, so that allocations don't need to check
+// every block. Block structs come from a pool that grows in chunks.
+
+static struct s_SingleBlock *vramBlock_newNode(s_vramBlock *mb)
+{
+    if (mb->nodePool == NULL)
+    {
+        s_SingleBlockChunk *chunk = malloc(sizeof(s_SingleBlockChunk));
+        if (chunk == NULL)
+            return NULL;
+
+        chunk->next = mb->chunks;
+        mb->chunks = chunk;
+
+        for (int i = 0; i < VRAM_BLOCK_CHUNK_NODES; i++)
+        {
+            chunk->nodes[i].node[1] = mb->nodePool;
+            mb->nodePool = &chunk->nodes[i];
+        }
+    }
+
+    struct s_SingleBlock *block = mb->nodePool;
+    mb->nodePool = block->node[1];
+    return block;
+}
+
+static void vramBlock_freeNode(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    block->node[1] = mb->nodePool;
+    mb->nodePool = block;
+}
+
+static inline uint32_t vramBlock_sizeClass(uint32_t size)
+{
+    uint32_t c = 31 - __builtin_clz(size);
+    return c < VRAM_BLOCK_CLASSES ? c : VRAM_BLOCK_CLASSES - 1;
+}
+
+static void vramBlock_freeListAdd(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    uint32_t c = vramBlock_sizeClass(block->blockSize);
+
+    block->node[2] = NULL;
+    block->node[3] = mb->freeLists[c];
+    if (mb->freeLists[c])
+        mb->freeLists[c]->node[2] = block;
+
+    mb->freeLists[c] = block;
+    mb->freeMask |= BIT(c);
+}
+
+static void vramBlock_freeListRemove(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    uint32_t c = vramBlock_sizeClass(block->blockSize);
+
+    if (block->node[2])
+        block->node[2]->node[3] = block->node[3];
+    else
+        mb->freeLists[c] = block->node[3];
+
+    if (block->node[3])
+        block->node[3]->node[2] = block->node[2];
+
+    if (mb->freeLists[c] == NULL)
+        mb->freeMask &= ~BIT(c);
+}
+
+// Sets "block" as the owner of all pages that start in the range [start, end).
+static void vramBlock_setPages(s_vramBlock *mb, struct s_SingleBlock *block,
+                               uint8_t *start, uint8_t *end)
+{
+    uint32_t pageSize = 1 << VRAM_BLOCK_PAGE_SHIFT;
+    uint32_t first = ((uint32_t)start - (uint32_t)mb->startAddr + pageSize - 1)
+                     >> VRAM_BLOCK_PAGE_SHIFT;
+    uint32_t last = ((uint32_t)end - (uint32_t)mb->startAddr + pageSize - 1)
+                    >> VRAM_BLOCK_PAGE_SHIFT;
+
+    for (uint32_t i = first; (i < last) && (i < mb->pageCount); i++)
+        mb->pageBlocks[i] = block;
+}
+
+// Returns the block that contains the specified address.
+static struct s_SingleBlock *vramBlock_find(s_vramBlock *mb, uint8_t *addr)
+{
+    uint32_t page = ((uint32_t)addr - (uint32_t)mb->startAddr)
+                    >> VRAM_BLOCK_PAGE_SHIFT;
+
+    struct s_SingleBlock *block = mb->pageBlocks[page];
+
+    while (block && addr >= block->AddrSet + block->blockSize)
+        block = block->node[1];
+
+    return block;
+}
+
+// Returns the first empty block starting from the specified block.
+static struct s_SingleBlock *vramBlock_nextEmpty(struct s_SingleBlock *block)
+{
+    while (block && block->indexOut)
+        block = block->node[1];
+
+    return block;
+}
+
+// Returns the first address of an empty block, starting at "start", where an
+// allocation fits without overlapping any of the banks that can't be used, or
+// NULL if it doesn't fit.
+static uint8_t *vramBlock_fitInBlock(struct s_SingleBlock *block, uint8_t *start,
+                                     uint8_t **bankLock, uint32_t *bankSize,
+                                     uint32_t size, uint8_t align)
+{
+    uint8_t *end = block->AddrSet + block->blockSize;
+    uint8_t *addr = start > block->AddrSet ? start : block->AddrSet;
+
+    while (1)
+    {
+        addr = (uint8_t *)(((uint32_t)addr + ((1 << align) - 1))
+                           & (~((1 << align) - 1)));
+
+        if ((addr >= end) || ((uint32_t)(end - addr) < size))
+            return NULL;
+
+        bool overlaps = false;
+
+        for (int i = 0; bankLock[i] != NULL; i++)
+        {
+            if ((addr < bankLock[i] + bankSize[i]) && (addr + size > bankLock[i]))
+            {
+                addr = bankLock[i] + bankSize[i];
+                overlaps = true;
+                break;
+            }
+        }
+
+        if (!overlaps)
+            return addr;
+    }
+}
+
+int vramBlock_init(s_vramBlock *mb)
+{
+    for (int i = 0; i < VRAM_BLOCK_CLASSES; i++)
+        mb->freeLists[i] = NULL;
+
+    mb->freeMask = 0;
+    mb->nodePool = NULL;
+    mb->chunks = NULL;
+
+    // Construct a new block that covers the whole area
+    struct s_SingleBlock *newBlock = vramBlock_newNode(mb);
+    if (newBlock == NULL)
+        return 0;
+
+    newBlock->indexOut = 0;
+    newBlock->AddrSet = mb->startAddr;
+    newBlock->blockSize = (uint32_t)mb->endAddr - (uint32_t)mb->startAddr;
+    newBlock->node[0] = newBlock->node[1] = NULL;
+
+    vramBlock_setPages(mb, newBlock, mb->startAddr, mb->endAddr);
+    vramBlock_freeListAdd(mb, newBlock);
+
+    // Default settings and initializations for up to 16 blocks (will increase
+    // as limit is reached).
+    mb->blockCount = 1;
+    mb->deallocCount = 0;
+
+    mb->lastExamined = NULL;
+    mb->lastExaminedAddr = NULL;
+    mb->lastExaminedSize = 0;
+
+    if (DynamicArrayInit(&mb->blockPtrs, 16) == NULL)
+    {
+        free(mb->chunks);
+        return 0;
+    }
+    if (DynamicArrayInit(&mb->deallocBlocks, 16) == NULL)
+    {
+        DynamicArrayDelete(&mb->blockPtrs);
+        free(mb->chunks);
+        return 0;
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        // This should always work because we've already allocated 16 elements
+        DynamicArraySet(&mb->blockPtrs, i, (void *)0);
+        DynamicArraySet(&mb->deallocBlocks, i, (void *)0);
+    }
+
+    return 1;
+}
+
+s_vramBlock *vramBlock_Construct(uint8_t *start, uint8_t *end)
+{
+    // Block Container is constructed, with a starting and ending address. Then
+    // initialization of the first block is made.
+    struct s_vramBlock *mb = malloc(sizeof(s_vramBlock));
+    if (mb == NULL)
+        return NULL;
+
+    if (start > end)
+    {
+        mb->startAddr = end;
+        mb->endAddr = start;
+    }
+    else
+    {
+        mb->startAddr = start;
+        mb->endAddr = end;
+    }
+
+    uint32_t size = (uint32_t)mb->endAddr - (uint32_t)mb->startAddr;
+    mb->pageCount = (size + (1 << VRAM_BLOCK_PAGE_SHIFT) - 1)
+                    >> VRAM_BLOCK_PAGE_SHIFT;
+    mb->pageBlocks = malloc(mb->pageCount * sizeof(struct s_SingleBlock *));
+    if (mb->pageBlocks == NULL)
+    {
+        free(mb);
+        return NULL;
+    }
+
+    if (vramBlock_init(mb) == 0)
+    {
+        free(mb->pageBlocks);
+        free(mb);
+        return NULL;
+    }
+
+    return mb;
+}
+
+void vramBlock_terminate(s_vramBlock *mb)
+{
+    // All block structs live in the chunks of the pool
+    s_SingleBlockChunk *chunk = mb->chunks;
+
+    while (chunk != NULL)
+    {
+        s_SingleBlockChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    mb->chunks = NULL;
+    mb->nodePool = NULL;
+
+    DynamicArrayDelete(&mb->deallocBlocks);
+    DynamicArrayDelete(&mb->blockPtrs);
+}
+
+void vramBlock_Deconstruct(s_vramBlock *mb)
+{
+    // Container must exist for deconstructing
+    if (mb)
+    {
+        vramBlock_terminate(mb);
+        free(mb->pageBlocks);
+        free(mb);
+    }
+}
+
+struct s_SingleBlock *vramBlock__allocateBlock(s_vramBlock *mb,
+                                               struct s_SingleBlock *block,
+                                               uint8_t *addr, uint32_t size)
+{
+    // Initial tests to ensure allocation is valid
+    if (!size || !addr || !block || block->indexOut || addr < block->AddrSet
+        || (addr + size) > (block->AddrSet + block->blockSize))
+        return NULL;
+
+    // The empty block is split in up to 3 parts: empty space before the
+    // allocation, the allocation, and empty space after it.
+    uint8_t *blockEnd = block->AddrSet + block->blockSize;
+    uint8_t *starts[3] = { block->AddrSet, addr, addr + size };
+    uint32_t sizes[3] = {
+        (uint32_t)addr - (uint32_t)block->AddrSet,
+        size,
+        (uint32_t)blockEnd - (uint32_t)(addr + size)
+    };
+
+    // The original struct is used for the biggest part so that fewer pages
+    // need to be updated.
+    int keep = 0;
+    for (int i = 1; i < 3; i++)
+    {
+        if (sizes[i] > sizes[keep])
+            keep = i;
+    }
+
+    struct s_SingleBlock *parts[3] = { NULL, NULL, NULL };
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (sizes[i] == 0)
+            continue;
+
+        if (i == keep)
+        {
+            parts[i] = block;
+            continue;
+        }
+
+        parts[i] = vramBlock_newNode(mb);
+        if (parts[i] == NULL)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                if (parts[j] && parts[j] != block)
+                    vramBlock_freeNode(mb, parts[j]);
+            }
+            return NULL;
+        }
+    }
+
+    vramBlock_freeListRemove(mb, block);
+
+    struct s_SingleBlock *prev = block->node[0];
+    struct s_SingleBlock *next = block->node[1];
+
+    for (int i = 0; i < 3; i++)
+    {
+        struct s_SingleBlock *part = parts[i];
+        if (part == NULL)
+            continue;
+
+        part->indexOut = 0;
+        part->AddrSet = starts[i];
+        part->blockSize = sizes[i];
+
+        part->node[0] = prev;
+        if (prev)
+            prev->node[1] = part;
+        prev = part;
+
+        if (part != block)
+            vramBlock_setPages(mb, part, part->AddrSet, part->AddrSet + part->blockSize);
+
+        if (i != 1)
+            vramBlock_freeListAdd(mb, part);
+    }
+
+    prev->node[1] = next;
+    if (next)
+        next->node[0] = prev;
+
+    return parts[1];
+}
+
+uint32_t vramBlock__deallocateBlock(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    // Test to see if this is an allocated block
+    if (!block->indexOut)
+        return 0;
+
+    block->indexOut = 0;
+
+    struct s_SingleBlock *prev = block->node[0];
+    struct s_SingleBlock *next = block->node[1];
+
+    bool mergePrev = prev && !prev->indexOut;
+    bool mergeNext = next && !next->indexOut;
+
+    uint8_t *start = mergePrev ? prev->AddrSet : block->AddrSet;
+    uint8_t *end = mergeNext ? next->AddrSet + next->blockSize
+                             : block->AddrSet + block->blockSize;
+
+    struct s_SingleBlock *before = mergePrev ? prev->node[0] : prev;
+    struct s_SingleBlock *after = mergeNext ? next->node[1] : next;
+
+    // Keep the struct of the biggest block, and give the pages of the other
+    // ones to it.
+    struct s_SingleBlock *keep = block;
+    if (mergePrev && prev->blockSize > keep->blockSize)
+        keep = prev;
+    if (mergeNext && next->blockSize > keep->blockSize)
+        keep = next;
+
+    if (mergePrev)
+    {
+        vramBlock_freeListRemove(mb, prev);
+        if (prev != keep)
+        {
+            vramBlock_setPages(mb, keep, prev->AddrSet, prev->AddrSet + prev->blockSize);
+            vramBlock_freeNode(mb, prev);
+        }
+    }
+
+    if (mergeNext)
+    {
+        vramBlock_freeListRemove(mb, next);
+        if (next != keep)
+        {
+            vramBlock_setPages(mb, keep, next->AddrSet, next->AddrSet + next->blockSize);
+            vramBlock_freeNode(mb, next);
+        }
+    }
+
+    if (block != keep)
+    {
+        vramBlock_setPages(mb, keep, block->AddrSet, block->AddrSet + block->blockSize);
+        vramBlock_freeNode(mb, block);
+    }
+
+    keep->AddrSet = start;
+    keep->blockSize = (uint32_t)end - (uint32_t)start;
+    keep->indexOut = 0;
+
+    keep->node[0] = before;
+    if (before)
+        before->node[1] = keep;
+
+    keep->node[1] = after;
+    if (after)
+        after->node[0] = keep;
+
+    vramBlock_freeListAdd(mb, keep);
+
+    return 1;
+}
+
+uint8_t *vramBlock_examineSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size,
+                                  uint8_t align)
+{
+    // Simple validity tests
+    if (!addr || !mb->freeMask || !size || align >= 8)
+        return NULL;
+
+    // Set these value to 0/NULL (should only be filled in with valid data in
+    // case of error), and copy the address to start checking.
+    mb->lastExamined = NULL;
+    mb->lastExaminedAddr = NULL;
+    mb->lastExaminedSize = 0;
+    uint8_t *checkAddr = addr;
+
+    if (checkAddr >= mb->endAddr)
+        return NULL;
+    if (checkAddr < mb->startAddr)
+        checkAddr = mb->startAddr;
+
+    uint8_t *bankLock[5];
+    uint32_t bankSize[5];
+    vramBlock_getLockedBanks(checkAddr, bankLock, bankSize);
+
+    // Check the empty blocks in address order, starting with the first one at
+    // the address or after it.
+    struct s_SingleBlock *block = vramBlock_nextEmpty(vramBlock_find(mb, checkAddr));
+
+    while (block)
+    {
+        uint8_t *found = vramBlock_fitInBlock(block, checkAddr, bankLock,
+                                              bankSize, size, align);
+        if (found)
+        {
+            mb->lastExamined = block;
+            mb->lastExaminedAddr = found;
+            mb->lastExaminedSize = size;
+            return found;
+        }
+
+        block = vramBlock_nextEmpty(block->node[1]);
+    }
+
+    return NULL;
+}
+
+uint32_t vramBlock_allocateSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size)
+{
+    // Simple validity tests. Special allocations require "examination" data
+    if (!addr || !size || !mb->lastExamined || !mb->lastExaminedAddr)
+        return 0;
+
+    if (mb->lastExaminedAddr != addr || mb->lastExaminedSize != size)
+        return 0;
+
+    // Can only get here if prior tests passed, meaning a spot is available, and
+    // can be allocated
+    struct s_SingleBlock *newBlock = vramBlock__allocateBlock(mb, mb->lastExamined, addr, size);
+    if (newBlock == NULL)
+        return 0;
+
+    // with current implementation, it should never be false if it gets to here
+    uint32_t curBlock;
+
+    // Use a prior index if one exists. Else, obtain a new index
+    if (mb->deallocCount)
+        curBlock = (uint32_t)DynamicArrayGet(&mb->deallocBlocks, mb->deallocCount--);
+    else
+        curBlock = mb->blockCount++;
+
+    DynamicArraySet(&mb->blockPtrs, curBlock, (void *)newBlock);
+    // Clear out examination data
+    mb->lastExamined = NULL;
+    mb->lastExaminedAddr = NULL;
+    mb->lastExaminedSize = 0;
+    newBlock->indexOut = curBlock;
+    return curBlock;
+}
+
+uint32_t vramBlock_allocateBlock(s_vramBlock *mb, uint32_t size, uint8_t align)
+{
+    // Simple valid tests, such as if there are no more empty blocks
+    if (mb->freeMask == 0 || !size || align >= 8)
+        return 0;
+
+    uint8_t *bankLock[5];
+    uint32_t bankSize[5];
+    vramBlock_getLockedBanks(mb->startAddr, bankLock, bankSize);
+
+    // Look for space in the size class of the allocation, and then in the
+    // bigger classes. Blocks in the class of the allocation may be too small,
+    // but any block in a bigger class is big enough unless alignment or locked
+    // banks get in the way, so the search normally stops at the first block.
+    uint32_t mask = mb->freeMask & ~(BIT(vramBlock_sizeClass(size)) - 1);
+
+    while (mask)
+    {
+        uint32_t c = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        for (struct s_SingleBlock *block = mb->freeLists[c]; block != NULL;
+             block = block->node[3])
+        {
+            uint8_t *addr = vramBlock_fitInBlock(block, block->AddrSet,
+                                                 bankLock, bankSize, size, align);
+            if (addr == NULL)
+                continue;
+
+            mb->lastExamined = block;
+            mb->lastExaminedAddr = addr;
+            mb->lastExaminedSize = size;
+
+            return vramBlock_allocateSpecial(mb, addr, size);
+        }
+    }
+
+    return 0;
+}
+
+// TODO: The return value of this function isn't checked anywhere, but I'm not
+// sure if this is the right approach. All we can do if we fail to deallocate
+// memory is crash.
+uint32_t vramBlock_deallocateBlock(s_vramBlock *mb, uint32_t index)
+{
+    // Retrieve the block from the index array, and see if it exists. If it
+    // does, and is deallocated (which it should), remove from index list
+    struct s_SingleBlock *block = DynamicArrayGet(&mb->blockPtrs, index);
+
+    if (block && vramBlock__deallocateBlock(mb, block))
+    {
+        // Clear the current element
+        DynamicArraySet(&mb->blockPtrs, index, NULL);
+
+        // Add the block to the array of deallocated blocks
+        if (!DynamicArraySet(&mb->deallocBlocks, ++mb->deallocCount, (void *)index))
+        {
+            // It's pretty hard to recover from this. At least, try to detect it
+            // in debug builds.
+            sassert(false, "Can't add block to deallocBlocks");
+            return 0;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+int vramBlock_deallocateAll(s_vramBlock *mb)
+{
+    // Reset the entire container
+    vramBlock_terminate(mb);
+    if (vramBlock_init(mb) == 0)
+        return 0;
+
+    return 1;
+}
+
+uint8_t *vramBlock_getAddr(s_vramBlock *mb, uint32_t index)
+{
+    struct s_SingleBlock *getBlock = DynamicArrayGet(&mb->blockPtrs, index);
+    if (getBlock)
+        return getBlock->AddrSet;
+
+    return NULL;
+}
+
+// TODO: This is unused. Remove?
+uint32_t vramBlock_getSize(s_vramBlock *mb, uint32_t index)
+{
+    struct s_SingleBlock *getBlock = DynamicArrayGet(&mb->blockPtrs, index);
+    if (getBlock)
+        return getBlock->blockSize;
+
+    return 0;
+}
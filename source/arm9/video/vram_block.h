@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Zlib
+// SPDX-FileNotice: Modified from the original version by the BlocksDS project.
+//
+// Copyright (C) 2005 Michael Noland (joat)
+// Copyright (C) 2005 Jason Rogers (dovoto)
+// Copyright (C) 2005 Dave Murphy (WinterMute)
+
+// Allocator of texture and palette VRAM used by videoGL. It doesn't access the
+// hardware directly, so it can be built for the host to test it (see
+// tests/host). The only thing it needs from the hardware is the list of banks
+// that can't be used, which videoGL provides with vramBlock_getLockedBanks().
+
+#ifndef LIBNDS_ARM9_VIDEO_VRAM_BLOCK_H__
+#define LIBNDS_ARM9_VIDEO_VRAM_BLOCK_H__
+
+#include <stdint.h>
+
+#include <nds/arm9/dynamicArray.h>
+
+// Structures specific to allocating and deallocating texture and palette VRAM
+// ---------------------------------------------------------------------------
+
+typedef struct s_SingleBlock
+{
+    uint32_t indexOut;
+    uint8_t *AddrSet;
+
+    // 0-1: prev/next memory block
+    // 2-3: prev/next empty block of the same size class (only empty blocks)
+    struct s_SingleBlock *node[4];
+
+    uint32_t blockSize;
+} s_SingleBlock;
+
+// Number of size classes of empty blocks. Class N holds blocks with a size
+// between 2^N and 2^(N+1) - 1 bytes (the last class holds anything bigger).
+#define VRAM_BLOCK_CLASSES      20
+
+// The memory area is divided in pages of this size. For each page, the block
+// that contains its first byte is saved, so that the block that contains an
+// address can be found without walking the list of blocks.
+#define VRAM_BLOCK_PAGE_SHIFT   12
+
+// Block structs are allocated in groups of this size, and reused after they are
+// freed, so that splitting a block doesn't need to call malloc().
+#define VRAM_BLOCK_CHUNK_NODES  32
+
+typedef struct s_SingleBlockChunk
+{
+    struct s_SingleBlockChunk *next;
+    s_SingleBlock nodes[VRAM_BLOCK_CHUNK_NODES];
+} s_SingleBlockChunk;
+
+typedef struct s_vramBlock
+{
+    uint8_t *startAddr, *endAddr;
+
+    // Lists of empty blocks of each size class, and bitmap of non-empty lists
+    struct s_SingleBlock *freeLists[VRAM_BLOCK_CLASSES];
+    uint32_t freeMask;
+
+    // Block that contains the start of each page
+    struct s_SingleBlock **pageBlocks;
+    uint32_t pageCount;
+
+    // Unused block structs (linked with node[1]) and chunks that hold them
+    struct s_SingleBlock *nodePool;
+    s_SingleBlockChunk *chunks;
+
+    struct s_SingleBlock *lastExamined;
+    uint8_t *lastExaminedAddr;
+    uint32_t lastExaminedSize;
+
+    DynamicArray blockPtrs;
+    DynamicArray deallocBlocks;
+
+    uint32_t blockCount;
+    uint32_t deallocCount;
+} s_vramBlock;
+
+// Fills the arrays with the banks that can't be used right now, either because
+// they aren't mapped as texture or palette banks, or because they are locked.
+// Both arrays must have at least 5 elements, and they are terminated by a NULL
+// entry. It is implemented by videoGL.
+void vramBlock_getLockedBanks(uint8_t *addr, uint8_t **bankLock,
+                              uint32_t *bankSize);
+
+int vramBlock_init(s_vramBlock *mb);
+s_vramBlock *vramBlock_Construct(uint8_t *start, uint8_t *end);
+void vramBlock_terminate(s_vramBlock *mb);
+void vramBlock_Deconstruct(s_vramBlock *mb);
+struct s_SingleBlock *vramBlock__allocateBlock(s_vramBlock *mb,
+                                               struct s_SingleBlock *block,
+                                               uint8_t *addr, uint32_t size);
+uint32_t vramBlock__deallocateBlock(s_vramBlock *mb, struct s_SingleBlock *block);
+uint8_t *vramBlock_examineSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size,
+                                  uint8_t align);
+uint32_t vramBlock_allocateSpecial(s_vramBlock *mb, uint8_t *addr, uint32_t size);
+uint32_t vramBlock_allocateBlock(s_vramBlock *mb, uint32_t size, uint8_t align);
+uint32_t vramBlock_deallocateBlock(s_vramBlock *mb, uint32_t index);
+int vramBlock_deallocateAll(s_vramBlock *mb);
+uint8_t *vramBlock_getAddr(s_vramBlock *mb, uint32_t index);
+uint32_t vramBlock_getSize(s_vramBlock *mb, uint32_t index);
+
+#endif // LIBNDS_ARM9_VIDEO_VRAM_BLOCK_H__
@@ -0,0 +1,375 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef ARM9
+#include <nds/arm9/sassert.h>
+#endif
+#include <nds/cojob.h>
+#include <nds/cothread.h>
+
+typedef enum
+{
+    COJOB_WAITING, // Waiting for the job it depends on to end
+    COJOB_QUEUED,
+    COJOB_RUNNING,
+    COJOB_DONE
+} cojob_state_t;
+
+struct cojob_future
+{
+    cojob_fn_t fn;
+    cojob_then_fn_t then_fn; // Used instead of fn by continuations
+    void *arg;
+    int result;
+    uint8_t state;
+    bool orphan; // The user has freed the future before it could be freed
+    uint16_t users; // Continuations that haven't ended yet
+
+    // Job that has to end before this one is started (only for continuations)
+    struct cojob_future *previous;
+    // Next job in the queue, or next continuation of the same job
+    struct cojob_future *next;
+    // List of jobs that have to be queued when this one ends, in the order in
+    // which they were added.
+    struct cojob_future *continuations;
+    struct cojob_future *continuations_tail;
+};
+
+// Queue of jobs ready to be run. Idle workers block on it.
+static cojob_future_t *cojob_queue_head;
+static cojob_future_t *cojob_queue_tail;
+
+static cothread_t *cojob_workers;
+static unsigned int cojob_num_workers;
+static bool cojob_exiting;
+
+static void cojob_queue_push(cojob_future_t *job)
+{
+    job->state = COJOB_QUEUED;
+    job->next = NULL;
+
+    if (cojob_queue_tail == NULL)
+        cojob_queue_head = job;
+    else
+        cojob_queue_tail->next = job;
+
+    cojob_queue_tail = job;
+}
+
+static cojob_future_t *cojob_queue_pop(void)
+{
+    cojob_future_t *job = cojob_queue_head;
+
+    if (job != NULL)
+    {
+        cojob_queue_head = job->next;
+        if (cojob_queue_head == NULL)
+            cojob_queue_tail = NULL;
+    }
+
+    return job;
+}
+
+static void cojob_complete(cojob_future_t *job, int result)
+{
+    job->result = result;
+    job->state = COJOB_DONE;
+
+    // Queue all jobs that depend on this one
+    cojob_future_t *p = job->continuations;
+    job->continuations = NULL;
+    job->continuations_tail = NULL;
+
+    while (p != NULL)
+    {
+        cojob_future_t *next = p->next;
+        cojob_queue_push(p);
+        cothread_wake_one(&cojob_queue_head);
+        p = next;
+    }
+
+    // Wake up any thread waiting for this job
+    cothread_wake_all(job);
+
+    // Continuations get a pointer to the previous future, so it can't be freed
+    // until all of them have ended.
+    cojob_future_t *previous = job->previous;
+    if (previous != NULL)
+    {
+        previous->users--;
+        if (previous->orphan && (previous->users == 0))
+            free(previous);
+    }
+
+    if (job->orphan && (job->users == 0))
+        free(job);
+}
+
+static int cojob_worker(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        // Don't take new jobs after cojob_exit() has been called. Jobs that keep
+        // submitting more jobs would never let the queue become empty.
+        if (cojob_exiting)
+            break;
+
+        cojob_future_t *job = cojob_queue_pop();
+        if (job == NULL)
+        {
+            cothread_block_on(&cojob_queue_head);
+            continue;
+        }
+
+        job->state = COJOB_RUNNING;
+
+        int result;
+        if (job->previous != NULL)
+            result = job->then_fn(job->previous, job->arg);
+        else
+            result = job->fn(job->arg);
+
+        cojob_complete(job, result);
+    }
+
+    return 0;
+}
+
+int cojob_init(unsigned int workers, size_t stack_size)
+{
+    if ((workers == 0) || (cojob_num_workers != 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (stack_size == 0)
+        stack_size = COJOB_DEFAULT_STACK_SIZE;
+
+    cojob_workers = calloc(workers, sizeof(cothread_t));
+    if (cojob_workers == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    cojob_exiting = false;
+
+    for (unsigned int i = 0; i < workers; i++)
+    {
+        cothread_t id = cothread_create(cojob_worker, NULL, stack_size, 0);
+        if (id == -1)
+        {
+            int err = errno;
+            cojob_exit();
+            errno = err;
+            return -1;
+        }
+
+        cojob_workers[cojob_num_workers++] = id;
+    }
+
+    return 0;
+}
+
+void cojob_exit(void)
+{
+#ifdef ARM9
+    // A worker would wait forever for itself to exit
+    for (unsigned int i = 0; i < cojob_num_workers; i++)
+    {
+        sassert(cojob_workers[i] != cothread_get_current(),
+                "cojob_exit() can't be called from a job");
+    }
+#endif
+
+    // Workers end their current job and exit without taking any other job from
+    // the queue, so jobs that are queued stay there.
+    cojob_exiting = true;
+    cothread_wake_all(&cojob_queue_head);
+
+    for (unsigned int i = 0; i < cojob_num_workers; i++)
+    {
+        while (!cothread_has_joined(cojob_workers[i]))
+            cothread_block_on((void *)cojob_workers[i]);
+
+        cothread_delete(cojob_workers[i]);
+    }
+
+    free(cojob_workers);
+    cojob_workers = NULL;
+    cojob_num_workers = 0;
+}
+
+static cojob_future_t *cojob_future_alloc(void *arg)
+{
+    cojob_future_t *job = calloc(1, sizeof(cojob_future_t));
+    if (job == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    job->arg = arg;
+    job->state = COJOB_WAITING;
+
+    return job;
+}
+
+static cojob_future_t *cojob_future_new(cojob_fn_t fn, void *arg)
+{
+    if (fn == NULL)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cojob_future_t *job = cojob_future_alloc(arg);
+    if (job != NULL)
+        job->fn = fn;
+
+    return job;
+}
+
+cojob_future_t *cojob_submit(cojob_fn_t fn, void *arg)
+{
+    cojob_future_t *job = cojob_future_new(fn, arg);
+    if (job == NULL)
+        return NULL;
+
+    cojob_queue_push(job);
+    cothread_wake_one(&cojob_queue_head);
+
+    return job;
+}
+
+int cojob_submit_batch(const cojob_desc_t *jobs, size_t count,
+                       cojob_future_t **futures)
+{
+    if ((jobs == NULL) || (count == 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Allocate all futures first so that no job is submitted on failure
+
+    cojob_future_t *first = NULL;
+    cojob_future_t *last = NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        cojob_future_t *job = cojob_future_new(jobs[i].fn, jobs[i].arg);
+        if (job == NULL)
+        {
+            while (first != NULL)
+            {
+                cojob_future_t *next = first->next;
+                free(first);
+                first = next;
+            }
+            return -1;
+        }
+
+        if (futures != NULL)
+            futures[i] = job;
+        else
+            job->orphan = true;
+
+        if (last == NULL)
+            first = job;
+        else
+            last->next = job;
+        last = job;
+    }
+
+    while (first != NULL)
+    {
+        cojob_future_t *next = first->next;
+        cojob_queue_push(first);
+        first = next;
+    }
+
+    // Wake up as many workers as jobs have been added
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!cothread_wake_one(&cojob_queue_head))
+            break;
+    }
+
+    return 0;
+}
+
+cojob_future_t *cojob_then(cojob_future_t *future, cojob_then_fn_t fn,
+                           void *arg)
+{
+    if ((future == NULL) || (fn == NULL) || (future->users == UINT16_MAX))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cojob_future_t *job = cojob_future_alloc(arg);
+    if (job == NULL)
+        return NULL;
+
+    job->then_fn = fn;
+    job->previous = future;
+    future->users++;
+
+    if (future->state == COJOB_DONE)
+    {
+        cojob_queue_push(job);
+        cothread_wake_one(&cojob_queue_head);
+    }
+    else
+    {
+        // Continuations are queued in the same order as they are added
+        job->next = NULL;
+        if (future->continuations_tail == NULL)
+            future->continuations = job;
+        else
+            future->continuations_tail->next = job;
+        future->continuations_tail = job;
+    }
+
+    return job;
+}
+
+bool cojob_future_is_ready(const cojob_future_t *future)
+{
+    return future->state == COJOB_DONE;
+}
+
+int cojob_future_wait(cojob_future_t *future)
+{
+    // cojob_complete() wakes up all threads blocked on the future
+    while (future->state != COJOB_DONE)
+        cothread_block_on(future);
+
+    return future->result;
+}
+
+int cojob_future_get(const cojob_future_t *future)
+{
+    return future->result;
+}
+
+void cojob_future_free(cojob_future_t *future)
+{
+    if (future == NULL)
+        return;
+
+    if ((future->state == COJOB_DONE) && (future->users == 0))
+        free(future);
+    else
+        future->orphan = true;
+}
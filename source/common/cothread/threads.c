@@ -19,6 +19,10 @@
 #include <nds/cothread.h>
 #include <nds/interrupts.h>
 #include <nds/ndstypes.h>
+#include <nds/system.h>
+#include <nds/timers.h>
+
+#include "common/libnds_internal.h"
 
 // Generate a reference to __retarget_lock_acquire(). This will force the linker
 // to add the version of the function included in libnds.
@@ -58,13 +62,15 @@ __asm__(".equ __retarget_lock_acquire_reference, __retarget_lock_acquire");
 // never freed, so this is only needed when a second thread is created.
 static void (*free_fn)(void *) = NULL;
 
-// Thread that is currently running
-static cothread_info_t *cothread_active_thread = NULL;
-
 // This context is the start of the linked list that contains the contexts of
 // all threads. It is also used for the main() thread, which can never be freed.
 static cothread_info_t cothread_list;
 
+// Thread that is currently running. Any code that runs before the scheduler is
+// started runs as part of the main() thread, so that mutexes can identify the
+// owner correctly.
+static cothread_info_t *cothread_active_thread = &cothread_list;
+
 //-------------------------------------------------------------------
 
 // Linker symbols
@@ -117,323 +123,1443 @@ volatile uint32_t cothread_irq_flags;
 volatile uint32_t cothread_irq_aux_flags;
 #endif
 
-// This function returns true if there is any thread that isn't waiting for an
-// interrupt to happen, false otherwise.
-#ifdef ARM9
-ITCM_CODE
-#endif
-static bool cothread_scheduler_refresh_irq_flags(void)
-{
-    bool any_thread_available = false;
+// Threads that can be resumed right away. There is one queue per priority
+// level, and threads are resumed in FIFO order within a level. Every thread
+// that isn't running, hasn't ended and isn't waiting for an interrupt is in one
+// of these queues. They are linked with the "sched_next" field.
+static cothread_info_t *cothread_ready_head[COTHREAD_PRIORITY_LEVELS];
+static cothread_info_t *cothread_ready_tail[COTHREAD_PRIORITY_LEVELS];
 
-    // We need to fetch and clear the current flags in a critical section in
-    // case there is an interrupt right when we are reading and clearing the
-    // variable.
+// One bit per priority level. A bit is set if the queue of that level isn't
+// empty. The lowest bit set is the highest priority level with threads ready.
+static uint32_t cothread_ready_levels;
 
-    int oldIME = enterCriticalSection();
+// Threads blocked on an object (a mutex, a semaphore, a condition variable or
+// a thread they want to join). They are kept in a small hash table indexed by
+// the address of the object, linked with the "sched_next" field. Threads are
+// appended to the end of the lists so that threads of the same priority are
+// woken up in FIFO order.
+#define COTHREAD_WAIT_BUCKETS 16
 
-    uint32_t flags = cothread_irq_flags;
-    cothread_irq_flags = 0;
-#ifdef ARM7
-    uint32_t flags_aux = cothread_irq_aux_flags;
-    cothread_irq_aux_flags = 0;
-#endif
+static cothread_info_t *cothread_wait_bucket[COTHREAD_WAIT_BUCKETS];
 
-    leaveCriticalSection(oldIME);
+static inline unsigned int cothread_wait_hash(const void *object)
+{
+    uintptr_t addr = (uintptr_t)object;
 
-    cothread_info_t *p = &cothread_list;
+    return ((addr >> 2) ^ (addr >> 6)) & (COTHREAD_WAIT_BUCKETS - 1);
+}
 
-    for (; p != NULL; p = p->next)
-    {
-        if (p->wait_irq_flags)
-            p->wait_irq_flags &= ~flags;
-#ifdef ARM7
-        if (p->wait_irq_aux_flags)
-            p->wait_irq_aux_flags &= ~flags_aux;
-#endif
+// List of threads with a deadline, linked with the "deadline_next" field.
+static cothread_info_t *cothread_deadline_list;
 
-        if (p->wait_irq_flags == 0)
-            any_thread_available = true;
+// Number of VBlank interrupts seen by the scheduler. It is used to check if a
+// thread with a deadline has already run during the current frame.
+static uint32_t cothread_frame_count;
+
+// Threads waiting for interrupts. There is one list per IRQ bit, linked with
+// the "sched_next" field. A thread is only ever present in the list of the
+// lowest bit that it is still waiting for. When that bit is set, the thread is
+// moved to the list of the next bit it is waiting for or, if there are no bits
+// left, to the ready queue. This way the scheduler never has to look at threads
+// that are blocked.
+static cothread_info_t *cothread_wait_list[32];
 #ifdef ARM7
-        if (p->wait_irq_aux_flags == 0)
-            any_thread_available = true;
+static cothread_info_t *cothread_wait_aux_list[32];
 #endif
-    }
-
-    return any_thread_available;
-}
 
-//-------------------------------------------------------------------
-
-static void cothread_list_add_ctx(cothread_info_t *ctx)
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_ready_push(cothread_info_t *ctx)
 {
-    // Find last node of the list
-
-    cothread_info_t *p = &cothread_list;
+    unsigned int level = ctx->priority;
 
-    while (p->next != NULL)
-        p = p->next;
+    ctx->sched_next = NULL;
 
-    // Append the new context to the end
+    if (cothread_ready_tail[level] == NULL)
+        cothread_ready_head[level] = ctx;
+    else
+        cothread_ready_tail[level]->sched_next = ctx;
 
-    p->next = ctx;
+    cothread_ready_tail[level] = ctx;
+    cothread_ready_levels |= BIT(level);
 }
 
 #ifdef ARM9
 ITCM_CODE
 #endif
-static void cothread_list_remove_ctx(cothread_info_t *ctx)
+static cothread_info_t *cothread_ready_pop(void)
 {
-    // The first element of cothread_list is statically allocated. It is the
-    // main() thread, which can never be deleted.
+    if (cothread_ready_levels == 0)
+        return NULL;
 
-    cothread_info_t *p = &cothread_list;
+    unsigned int level = __builtin_ctz(cothread_ready_levels);
 
-    for (; p->next != NULL; p = p->next)
+    cothread_info_t *ctx = cothread_ready_head[level];
+
+    cothread_ready_head[level] = ctx->sched_next;
+    if (cothread_ready_head[level] == NULL)
     {
-        if (p->next == ctx)
-        {
-            // Skip the context that we have just found
-            p->next = ((cothread_info_t *)p->next)->next;
-            return;
-        }
+        cothread_ready_tail[level] = NULL;
+        cothread_ready_levels &= ~BIT(level);
     }
 
-    // Reaching this point means that there is a bug somewhere in the code.
+    return ctx;
 }
 
-static bool cothread_list_contains_ctx(cothread_info_t *ctx)
+// Returns true if the thread is in one of the ready queues. It must not be
+// called with the thread that is currently running.
+static bool cothread_is_ready(cothread_info_t *ctx)
 {
-    cothread_info_t *p = &cothread_list;
-
-    while (1)
-    {
-        if (p == ctx)
-            return true;
+    if (ctx->joined || ctx->wait_object)
+        return false;
 
-        if (p->next == NULL)
-            return false;
+#ifdef ARM7
+    if (ctx->wait_irq_aux_flags)
+        return false;
+#endif
 
-        p = p->next;
-    }
+    return ctx->wait_irq_flags == 0;
 }
 
-//-------------------------------------------------------------------
-
-static void cothread_delete_internal(cothread_info_t *ctx)
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_wait_list_push(cothread_info_t **lists, uint32_t wait_flags,
+                                    cothread_info_t *ctx)
 {
-    cothread_list_remove_ctx(ctx);
+    unsigned int bit = __builtin_ctz(wait_flags);
 
-    if (ctx->stack_base)
-        free_fn(ctx->stack_base);
+    ctx->sched_next = lists[bit];
+    lists[bit] = ctx;
+}
 
-    free(ctx->tls);
+// Add a thread that has just been preempted to the right queue depending on
+// the interrupts it is waiting for.
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_sched_enqueue(cothread_info_t *ctx)
+{
+    if (ctx->wait_object)
+    {
+        cothread_info_t **p =
+            &cothread_wait_bucket[cothread_wait_hash(ctx->wait_object)];
 
-    free_fn(ctx);
+        while (*p != NULL)
+            p = (cothread_info_t **)&((*p)->sched_next);
+
+        ctx->sched_next = NULL;
+        *p = ctx;
+    }
+    else if (ctx->wait_irq_flags)
+        cothread_wait_list_push(cothread_wait_list, ctx->wait_irq_flags, ctx);
+#ifdef ARM7
+    else if (ctx->wait_irq_aux_flags)
+        cothread_wait_list_push(cothread_wait_aux_list, ctx->wait_irq_aux_flags,
+                                ctx);
+#endif
+    else
+        cothread_ready_push(ctx);
 }
 
-int cothread_delete(cothread_t thread)
+// Remove a thread from the ready queue or wait list it's in. This is only
+// needed when a thread that hasn't ended is deleted or when its priority
+// changes, so it doesn't need to be fast.
+static void cothread_sched_unlink(cothread_info_t *ctx)
 {
-    cothread_info_t *ctx = (cothread_info_t *)thread;
+    cothread_info_t **p;
+    unsigned int level = ctx->priority;
+    bool ready = false;
 
-    if (ctx == cothread_active_thread)
+    if (ctx->wait_object)
     {
-        errno = EPERM;
-        return -1;
+        p = &cothread_wait_bucket[cothread_wait_hash(ctx->wait_object)];
     }
-
-    if (!cothread_list_contains_ctx(ctx))
+    else if (ctx->wait_irq_flags)
     {
-        errno = EINVAL;
-        return -1;
+        p = &cothread_wait_list[__builtin_ctz(ctx->wait_irq_flags)];
+    }
+#ifdef ARM7
+    else if (ctx->wait_irq_aux_flags)
+    {
+        p = &cothread_wait_aux_list[__builtin_ctz(ctx->wait_irq_aux_flags)];
+    }
+#endif
+    else
+    {
+        p = &cothread_ready_head[level];
+        ready = true;
     }
 
-    cothread_delete_internal(ctx);
-
-    return 0;
-}
-
-static cothread_t cothread_create_internal(cothread_info_t *ctx,
-                                           int (*entrypoint)(void *), void *arg,
-                                           void *stack_top, void *tls,
-                                           unsigned int flags)
-{
-    ctx->flags = flags;
-    ctx->tls = tls;
+    cothread_info_t *prev = NULL;
 
-    // Initialize context
-    __ndsabi_coro_make_noctx((void *)ctx, stack_top, entrypoint, arg);
+    for (; *p != NULL; p = (cothread_info_t **)&((*p)->sched_next))
+    {
+        if (*p == ctx)
+        {
+            *p = ctx->sched_next;
+
+            if (ready)
+            {
+                if (ctx == cothread_ready_tail[level])
+                    cothread_ready_tail[level] = prev;
+                if (cothread_ready_head[level] == NULL)
+                    cothread_ready_levels &= ~BIT(level);
+            }
+            return;
+        }
 
-    return (cothread_t)ctx;
+        prev = *p;
+    }
 }
 
-cothread_t cothread_create_manual(int (*entrypoint)(void *), void *arg,
-                                  void *stack_base, size_t stack_size,
-                                  unsigned int flags)
+// Set the current priority of a thread, moving it to the right ready queue if
+// it's waiting to be resumed.
+static void cothread_change_priority(cothread_info_t *ctx, unsigned int priority)
 {
-    // stack_size can be zero, like for the main() thread.
-
-    if ((stack_base == NULL) || (entrypoint == NULL))
-        goto invalid_args;
+    if (ctx->priority == priority)
+        return;
 
-    // They must be aligned to 8 bytes
-    if (((stack_size & 7) != 0) || (((uintptr_t)stack_base & 7) != 0))
-        goto invalid_args;
-
-    // Setup context
-
-    cothread_info_t *ctx = calloc(1, sizeof(cothread_info_t));
-    if (ctx == NULL)
+    if ((ctx != cothread_active_thread) && cothread_is_ready(ctx))
     {
-        errno = ENOMEM;
-        return -1;
+        cothread_sched_unlink(ctx);
+        ctx->priority = priority;
+        cothread_ready_push(ctx);
+    }
+    else
+    {
+        ctx->priority = priority;
     }
+}
 
-    size_t __tls_size = (uintptr_t)__tls_end - (uintptr_t)__tls_start;
+static void cothread_deadline_list_remove(cothread_info_t *ctx)
+{
+    cothread_info_t **p = &cothread_deadline_list;
 
-    void *tls = malloc(__tls_size);
-    if (tls == NULL)
+    for (; *p != NULL; p = (cothread_info_t **)&((*p)->deadline_next))
     {
-        free(ctx);
-        errno = ENOMEM;
-        return -1;
+        if (*p == ctx)
+        {
+            *p = ctx->deadline_next;
+            return;
+        }
     }
+}
 
-    init_tls(tls);
+// Look for threads with a deadline that have reached it without having run
+// during the current frame. If there is any, the one with the earliest deadline
+// is removed from the ready queue and returned so that it runs before any other
+// thread, regardless of its priority.
+#ifdef ARM9
+ITCM_CODE
+#endif
+static cothread_info_t *cothread_deadline_pick(void)
+{
+    // Number of scanlines since the start of the VBlank period
+    unsigned int line = REG_VCOUNT;
+    if (line >= 192)
+        line -= 192;
+    else
+        line += 263 - 192;
 
-    // Assign the free() function to the pointer because now we are sure that we
-    // will need to free the resources of the newly created thread eventually.
+    cothread_info_t *best = NULL;
 
-    free_fn = free;
+    for (cothread_info_t *p = cothread_deadline_list; p != NULL;
+         p = p->deadline_next)
+    {
+        if (p->last_frame == cothread_frame_count)
+            continue;
 
-    // Add context to the scheduler
-    cothread_list_add_ctx(ctx);
+        if (line < p->deadline)
+            continue;
 
-    void *stack_top = (void *)((uintptr_t)stack_base + stack_size);
+        if (!cothread_is_ready(p))
+            continue;
 
-    return cothread_create_internal(ctx, entrypoint, arg, stack_top, tls, flags);
+        if ((best == NULL) || (p->deadline < best->deadline))
+            best = p;
+    }
 
-invalid_args:
-    errno = EINVAL;
-    return -1;
+    if (best != NULL)
+        cothread_sched_unlink(best);
+
+    return best;
 }
 
-cothread_t cothread_create(int (*entrypoint)(void *), void *arg,
-                           size_t stack_size, unsigned int flags)
+// Returns the highest priority thread blocked on the specified object, or NULL
+// if there are none. If there are several threads with the same priority, it
+// returns the one that has been waiting for the longest time.
+static cothread_info_t *cothread_wait_find(const void *object)
 {
-    // Setup stack
+    cothread_info_t *best = NULL;
+    cothread_info_t *p = cothread_wait_bucket[cothread_wait_hash(object)];
 
-    if ((stack_size & 7) != 0)
+    for (; p != NULL; p = p->sched_next)
     {
-        errno = EINVAL;
-        return -1;
+        if (p->wait_object != object)
+            continue;
+
+        if ((best == NULL) || (p->priority < best->priority))
+            best = p;
     }
 
-    if (stack_size == 0)
-        stack_size = DEFAULT_STACK_SIZE_CHILD;
+    return best;
+}
 
-    // The stack must be aligned to 8 bytes
-    void *stack_base = memalign(8, stack_size);
-    if (stack_base == NULL)
-    {
-        errno = ENOMEM;
-        return -1;
-    }
+//-------------------------------------------------------------------
 
-    // Create thread
+// Threads that wait with a timeout are also kept in a timer wheel, linked with
+// the "timer_next" field. The hardware timer only runs while there is at least
+// one thread in the wheel, and it ticks once per millisecond. The interrupt
+// handler only increments the tick counter, the scheduler does the rest.
+//
+// Threads are added to the slot of the tick in which they have to be woken up.
+// Timeouts longer than the number of slots wrap around, so a slot may contain
+// threads that have to be woken up in a later round of the wheel.
+#define COTHREAD_WHEEL_SLOTS 64
 
-    cothread_t id = cothread_create_manual(entrypoint, arg,
-                                           stack_base, stack_size, flags);
-    if (id == -1)
-    {
-        free_fn(stack_base);
-        return -1;
-    }
+static cothread_info_t *cothread_wheel[COTHREAD_WHEEL_SLOTS];
+static unsigned int cothread_wheel_count;
 
-    // Set this stack pointer as owned by cothread
+// Last tick processed by the scheduler
+static uint32_t cothread_wheel_tick;
 
-    cothread_info_t *ctx = (cothread_info_t *)id;
-    ctx->stack_base = stack_base;
+// Ticks counted by the timer interrupt handler
+static volatile uint32_t cothread_timer_ticks;
 
-    return id;
-}
+static int cothread_timer = COTHREAD_DEFAULT_SLEEP_TIMER;
 
+// Set by cothread_profiling_start(), which uses two timers starting at
+// cothread_profiling_timer.
+static bool cothread_profiling;
+static int cothread_profiling_timer;
 
-int cothread_detach(cothread_t thread)
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_timer_handler(void)
 {
-    cothread_info_t *ctx = (cothread_info_t *)thread;
+    cothread_timer_ticks++;
+}
 
-    if (!cothread_list_contains_ctx(ctx))
+static void cothread_wheel_add(cothread_info_t *ctx, uint32_t timeout_ms)
+{
+    if (cothread_wheel_count == 0)
     {
-        errno = EINVAL;
-        return -1;
+        cothread_wheel_tick = cothread_timer_ticks;
+        timerStart(cothread_timer, ClockDivider_64, TIMER_FREQ_64(1000),
+                   cothread_timer_handler);
     }
 
-    ctx->flags |= COTHREAD_DETACHED;
+    // Ticks are compared with signed arithmetic, so longer timeouts would
+    // expire right away.
+    if (timeout_ms > INT32_MAX - 1)
+        timeout_ms = INT32_MAX - 1;
 
-    return 0;
+    // The first tick may happen right away, so add one tick to make sure that
+    // the thread waits at least for the requested time.
+    ctx->wake_tick = cothread_timer_ticks + timeout_ms + 1;
+    ctx->timer_armed = true;
+
+    unsigned int slot = ctx->wake_tick & (COTHREAD_WHEEL_SLOTS - 1);
+    ctx->timer_next = cothread_wheel[slot];
+    cothread_wheel[slot] = ctx;
+
+    cothread_wheel_count++;
 }
 
-bool cothread_has_joined(cothread_t thread)
+static void cothread_wheel_stop_if_empty(void)
 {
-    cothread_info_t *ctx = (cothread_info_t *)thread;
-
-    if (!cothread_list_contains_ctx(ctx))
-    {
-        errno = EINVAL;
-        return false;
-    }
+    if (cothread_wheel_count > 0)
+        return;
 
-    return ctx->joined != 0;
+    irqDisable(IRQ_TIMER(cothread_timer));
+    timerStop(cothread_timer);
 }
 
-int cothread_get_exit_code(cothread_t thread)
+static void cothread_wheel_remove(cothread_info_t *ctx)
 {
-    cothread_info_t *ctx = (cothread_info_t *)thread;
-
-    if (!cothread_list_contains_ctx(ctx))
-    {
-        errno = EINVAL;
-        return -1;
-    }
+    unsigned int slot = ctx->wake_tick & (COTHREAD_WHEEL_SLOTS - 1);
+    cothread_info_t **p = &cothread_wheel[slot];
 
-    if (ctx->joined == 0)
+    for (; *p != NULL; p = (cothread_info_t **)&((*p)->timer_next))
     {
-        errno = EBUSY;
-        return -1;
+        if (*p == ctx)
+        {
+            *p = ctx->timer_next;
+            ctx->timer_armed = false;
+            cothread_wheel_count--;
+            cothread_wheel_stop_if_empty();
+            return;
+        }
     }
-
-    return ctx->arg;
 }
 
-void cothread_yield(void)
+static void cothread_wake(cothread_info_t *ctx)
 {
-    cothread_info_t *ctx = cothread_active_thread;
+    cothread_sched_unlink(ctx);
+    ctx->wait_object = NULL;
 
-    __ndsabi_coro_yield((void *)ctx, 0);
+    if (ctx->timer_armed)
+        cothread_wheel_remove(ctx);
+
+    cothread_ready_push(ctx);
 }
 
-void cothread_yield_irq(uint32_t flags)
+// Wake up all threads whose timeout has expired since the last call.
+static void cothread_wheel_process(void)
 {
-#ifdef ARM9
-    sassert(REG_IME != 0, "IRQs must be enabled");
-#endif
+    uint32_t now = cothread_timer_ticks;
 
-    cothread_info_t *ctx = cothread_active_thread;
-
-    ctx->wait_irq_flags = flags;
+    // If many ticks have happened since the last call, each slot only needs to
+    // be checked once.
+    uint32_t elapsed = now - cothread_wheel_tick;
+    if (elapsed > COTHREAD_WHEEL_SLOTS)
+        cothread_wheel_tick = now - COTHREAD_WHEEL_SLOTS;
 
-    __ndsabi_coro_yield((void *)ctx, 0);
-}
+    while (cothread_wheel_tick != now)
+    {
+        cothread_wheel_tick++;
 
-#ifdef ARM7
-void cothread_yield_irq_aux(uint32_t flags)
-{
-    cothread_info_t *ctx = cothread_active_thread;
+        unsigned int slot = cothread_wheel_tick & (COTHREAD_WHEEL_SLOTS - 1);
+        cothread_info_t **p = &cothread_wheel[slot];
 
-    ctx->wait_irq_aux_flags = flags;
+        while (*p != NULL)
+        {
+            cothread_info_t *ctx = *p;
+
+            // Threads of a later round of the wheel stay in the slot
+            if ((int32_t)(ctx->wake_tick - now) > 0)
+            {
+                p = (cothread_info_t **)&(ctx->timer_next);
+                continue;
+            }
+
+            *p = ctx->timer_next;
+            ctx->timer_armed = false;
+            cothread_wheel_count--;
+
+            ctx->timed_out = true;
+            cothread_sched_unlink(ctx);
+            ctx->wait_object = NULL;
+            cothread_ready_push(ctx);
+        }
+    }
 
-    __ndsabi_coro_yield((void *)ctx, 0);
+    cothread_wheel_stop_if_empty();
+}
+
+// Wake up all threads waiting for the specified IRQ bits.
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_wait_lists_wake(cothread_info_t **lists, uint32_t flags,
+                                     bool aux)
+{
+    while (flags)
+    {
+        unsigned int bit = __builtin_ctz(flags);
+        flags &= ~BIT(bit);
+
+        // Detach the whole list before iterating it, threads that still have
+        // to wait will be added to lists of higher bits.
+        cothread_info_t *ctx = lists[bit];
+        lists[bit] = NULL;
+
+        while (ctx != NULL)
+        {
+            cothread_info_t *next = ctx->sched_next;
+#ifdef ARM7
+            uint32_t *wait_flags = aux ? &ctx->wait_irq_aux_flags
+                                       : &ctx->wait_irq_flags;
+#else
+            (void)aux;
+            uint32_t *wait_flags = &ctx->wait_irq_flags;
+#endif
+            *wait_flags &= ~(flags | BIT(bit));
+
+            if (*wait_flags)
+                cothread_wait_list_push(lists, *wait_flags, ctx);
+            else
+                cothread_ready_push(ctx);
+
+            ctx = next;
+        }
+    }
+}
+
+// This function moves all threads that were waiting for the interrupts that
+// have happened since the last call to the ready queue.
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_scheduler_refresh_irq_flags(void)
+{
+    // We need to fetch and clear the current flags in a critical section in
+    // case there is an interrupt right when we are reading and clearing the
+    // variable.
+
+    int oldIME = enterCriticalSection();
+
+    uint32_t flags = cothread_irq_flags;
+    cothread_irq_flags = 0;
+#ifdef ARM7
+    uint32_t flags_aux = cothread_irq_aux_flags;
+    cothread_irq_aux_flags = 0;
+#endif
+
+    leaveCriticalSection(oldIME);
+
+    if (flags & IRQ_VBLANK)
+        cothread_frame_count++;
+
+    if (flags)
+        cothread_wait_lists_wake(cothread_wait_list, flags, false);
+#ifdef ARM7
+    if (flags_aux)
+        cothread_wait_lists_wake(cothread_wait_aux_list, flags_aux, true);
+#endif
+
+    if (cothread_wheel_count > 0)
+        cothread_wheel_process();
+}
+
+//-------------------------------------------------------------------
+
+// Queue of work deferred from interrupt handlers. Interrupt handlers (which may
+// be nested) add items at the head with interrupts disabled for a few
+// instructions. The scheduler is the only consumer, so it can remove items from
+// the tail without disabling interrupts.
+//
+// The scheduler only runs in the ARM9, so this isn't available in the ARM7.
+
+#ifdef ARM9
+
+typedef struct
+{
+    cothread_deferred_fn_t fn;
+    void *arg;
+} cothread_deferred_t;
+
+static cothread_deferred_t cothread_deferred[COTHREAD_DEFERRED_MAX];
+static volatile uint32_t cothread_deferred_head;
+static volatile uint32_t cothread_deferred_tail;
+
+// Thread local storage used while deferred functions run, so that they don't
+// use the variables of the last thread that has run (like errno).
+static void *cothread_deferred_tls;
+
+ITCM_CODE
+bool cothread_defer(cothread_deferred_fn_t fn, void *arg)
+{
+    bool ret = false;
+
+    int oldIME = enterCriticalSection();
+
+    uint32_t head = cothread_deferred_head;
+
+    if (head - cothread_deferred_tail < COTHREAD_DEFERRED_MAX)
+    {
+        cothread_deferred_t *item =
+            &cothread_deferred[head % COTHREAD_DEFERRED_MAX];
+        item->fn = fn;
+        item->arg = arg;
+
+        cothread_deferred_head = head + 1;
+        ret = true;
+    }
+
+    leaveCriticalSection(oldIME);
+
+    return ret;
+}
+
+ITCM_CODE
+static void cothread_deferred_run(void)
+{
+    // Deferred functions don't run inside any thread
+    cothread_active_thread = NULL;
+    set_tls(cothread_deferred_tls);
+
+    uint32_t tail = cothread_deferred_tail;
+
+    while (tail != cothread_deferred_head)
+    {
+        // Copy the item before releasing the slot so that an interrupt handler
+        // can reuse the slot while the function runs.
+        cothread_deferred_t item =
+            cothread_deferred[tail % COTHREAD_DEFERRED_MAX];
+
+        tail++;
+        cothread_deferred_tail = tail;
+
+        item.fn(item.arg);
+    }
+}
+
+#endif // ARM9
+
+//-------------------------------------------------------------------
+
+static void cothread_list_add_ctx(cothread_info_t *ctx)
+{
+    // The order of this list doesn't matter, the scheduler uses the ready
+    // queue to decide which thread runs next. Insert the new context right
+    // after the main() thread so that we don't need to walk the list.
+
+    ctx->next = cothread_list.next;
+    cothread_list.next = ctx;
+
+    // New threads can start running right away
+    cothread_ready_push(ctx);
+}
+
+#ifdef ARM9
+ITCM_CODE
+#endif
+static void cothread_list_remove_ctx(cothread_info_t *ctx)
+{
+    // The first element of cothread_list is statically allocated. It is the
+    // main() thread, which can never be deleted.
+
+    cothread_info_t *p = &cothread_list;
+
+    for (; p->next != NULL; p = p->next)
+    {
+        if (p->next == ctx)
+        {
+            // Skip the context that we have just found
+            p->next = ((cothread_info_t *)p->next)->next;
+            return;
+        }
+    }
+
+    // Reaching this point means that there is a bug somewhere in the code.
+}
+
+static bool cothread_list_contains_ctx(cothread_info_t *ctx)
+{
+    cothread_info_t *p = &cothread_list;
+
+    while (1)
+    {
+        if (p == ctx)
+            return true;
+
+        if (p->next == NULL)
+            return false;
+
+        p = p->next;
+    }
+}
+
+//-------------------------------------------------------------------
+
+// Threads created with cothread_create() use one allocation (a slab) for the
+// context, the TLS and the stack, in that order. When the thread is deleted,
+// the slab is kept in a pool so that threads created later with the same stack
+// size can reuse it without going through the heap.
+//
+// The stack of a slab in the pool is still filled with COTHREAD_STACK_FILL_BYTE
+// except for the part that the previous thread used, so only that part needs to
+// be filled again when the slab is reused.
+
+// Header placed at the start of a slab while it's in the pool
+typedef struct cothread_slab
+{
+    struct cothread_slab *next;
+    size_t stack_size;
+    size_t dirty; // Bytes at the top of the stack that need to be filled again
+} cothread_slab_t;
+
+static cothread_slab_t *cothread_pool;
+static unsigned int cothread_pool_count;
+
+#define ALIGN_UP_8(x) (((x) + 7) & ~(size_t)7)
+
+static size_t cothread_slab_tls_size(void)
+{
+    return ALIGN_UP_8((uintptr_t)__tls_end - (uintptr_t)__tls_start);
+}
+
+static size_t cothread_slab_size(size_t stack_size)
+{
+    return ALIGN_UP_8(sizeof(cothread_info_t)) + cothread_slab_tls_size()
+           + stack_size;
+}
+
+static void *cothread_slab_get(size_t stack_size, size_t *dirty)
+{
+    cothread_slab_t **p = &cothread_pool;
+
+    for (; *p != NULL; p = &((*p)->next))
+    {
+        if ((*p)->stack_size == stack_size)
+        {
+            cothread_slab_t *slab = *p;
+            *p = slab->next;
+            cothread_pool_count--;
+            *dirty = slab->dirty;
+            return slab;
+        }
+    }
+
+    // The contents of new slabs are unknown
+    *dirty = stack_size;
+    return memalign(8, cothread_slab_size(stack_size));
+}
+
+static void cothread_slab_put(void *ptr, size_t stack_size, size_t dirty)
+{
+    if (cothread_pool_count >= COTHREAD_POOL_MAX_SLABS)
+    {
+        free_fn(ptr);
+        return;
+    }
+
+    cothread_slab_t *slab = ptr;
+    slab->stack_size = stack_size;
+    slab->dirty = dirty;
+    slab->next = cothread_pool;
+    cothread_pool = slab;
+    cothread_pool_count++;
+}
+
+int cothread_pool_reserve(size_t stack_size, unsigned int count)
+{
+    if ((stack_size & 7) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (stack_size == 0)
+        stack_size = DEFAULT_STACK_SIZE_CHILD;
+
+    int added = 0;
+
+    while ((count > 0) && (cothread_pool_count < COTHREAD_POOL_MAX_SLABS))
+    {
+        void *slab = memalign(8, cothread_slab_size(stack_size));
+        if (slab == NULL)
+            break;
+
+        free_fn = free;
+        cothread_slab_put(slab, stack_size, stack_size);
+
+        count--;
+        added++;
+    }
+
+    return added;
+}
+
+void cothread_pool_trim(void)
+{
+    while (cothread_pool != NULL)
+    {
+        cothread_slab_t *slab = cothread_pool;
+        cothread_pool = slab->next;
+        free_fn(slab);
+    }
+
+    cothread_pool_count = 0;
+}
+
+// Fill the stack with a known pattern so that the maximum usage can be measured
+// later, and place a canary at the bottom of the stack to detect overflows.
+// Only the top "dirty" bytes are filled, the rest must already hold the pattern.
+static void cothread_stack_prepare(cothread_info_t *ctx, void *stack_base,
+                                   size_t stack_size, size_t dirty)
+{
+    if (stack_size < 8)
+        return;
+
+    memset((uint8_t *)stack_base + stack_size - dirty, COTHREAD_STACK_FILL_BYTE,
+           dirty);
+    *(uint32_t *)stack_base = COTHREAD_STACK_CANARY;
+
+    ctx->stack_limit = stack_base;
+    ctx->stack_size = stack_size;
+}
+
+// Returns the number of bytes at the top of the stack that don't hold the fill
+// pattern anymore.
+static size_t cothread_stack_used(cothread_info_t *ctx)
+{
+    const uint8_t *p = ctx->stack_limit;
+    size_t unused = sizeof(uint32_t); // Skip the canary
+
+    // Skip whole words first. This is called every time a thread is deleted.
+    const uint32_t fill = COTHREAD_STACK_FILL_BYTE * 0x01010101U;
+    while ((unused < ctx->stack_size) && (*(const uint32_t *)(p + unused) == fill))
+        unused += sizeof(uint32_t);
+
+    while ((unused < ctx->stack_size) && (p[unused] == COTHREAD_STACK_FILL_BYTE))
+        unused++;
+
+    return ctx->stack_size - unused;
+}
+
+int cothread_get_stack_usage(cothread_t thread)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The stack of the main() thread isn't tracked
+    if (ctx->stack_limit == NULL)
+    {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    return cothread_stack_used(ctx);
+}
+
+//-------------------------------------------------------------------
+
+static void cothread_delete_internal(cothread_info_t *ctx)
+{
+    cothread_list_remove_ctx(ctx);
+
+    if (ctx->deadline != COTHREAD_NO_DEADLINE)
+        cothread_deadline_list_remove(ctx);
+
+    if (ctx->slab)
+    {
+        // If the canary has been overwritten, the whole stack is dirty
+        size_t dirty = ctx->stack_size;
+        if (*(uint32_t *)ctx->stack_limit == COTHREAD_STACK_CANARY)
+            dirty = cothread_stack_used(ctx);
+
+        cothread_slab_put(ctx, ctx->stack_size, dirty);
+        return;
+    }
+
+    if (ctx->stack_base)
+        free_fn(ctx->stack_base);
+
+    free(ctx->tls);
+
+    free_fn(ctx);
+}
+
+int cothread_delete(cothread_t thread)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (ctx == cothread_active_thread)
+    {
+        errno = EPERM;
+        return -1;
+    }
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Threads that have ended aren't in any queue of the scheduler
+    if (!ctx->joined)
+        cothread_sched_unlink(ctx);
+
+    if (ctx->timer_armed)
+        cothread_wheel_remove(ctx);
+
+    // Threads waiting to join this one would never be woken up otherwise. They
+    // will see that the thread doesn't exist anymore.
+    cothread_wake_all(ctx);
+
+    cothread_delete_internal(ctx);
+
+    return 0;
+}
+
+static cothread_t cothread_create_internal(cothread_info_t *ctx,
+                                           int (*entrypoint)(void *), void *arg,
+                                           void *stack_top, void *tls,
+                                           unsigned int flags)
+{
+    unsigned int priority = (flags & COTHREAD_PRIORITY_MASK)
+                            >> COTHREAD_PRIORITY_SHIFT;
+
+    // A value of 0 means that the default priority has to be used
+    if (priority == 0)
+        priority = COTHREAD_PRIORITY_NORMAL;
+    else
+        priority--;
+
+    ctx->flags = flags;
+    ctx->tls = tls;
+    ctx->priority = priority;
+    ctx->base_priority = priority;
+    ctx->deadline = COTHREAD_NO_DEADLINE;
+
+    // Initialize context
+    __ndsabi_coro_make_noctx((void *)ctx, stack_top, entrypoint, arg);
+
+    return (cothread_t)ctx;
+}
+
+cothread_t cothread_create_manual(int (*entrypoint)(void *), void *arg,
+                                  void *stack_base, size_t stack_size,
+                                  unsigned int flags)
+{
+    // stack_size can be zero, like for the main() thread.
+
+    if ((stack_base == NULL) || (entrypoint == NULL))
+        goto invalid_args;
+
+    if (((flags & COTHREAD_PRIORITY_MASK) >> COTHREAD_PRIORITY_SHIFT)
+            > COTHREAD_PRIORITY_LEVELS)
+        goto invalid_args;
+
+    // They must be aligned to 8 bytes
+    if (((stack_size & 7) != 0) || (((uintptr_t)stack_base & 7) != 0))
+        goto invalid_args;
+
+    // Setup context
+
+    cothread_info_t *ctx = calloc(1, sizeof(cothread_info_t));
+    if (ctx == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t __tls_size = (uintptr_t)__tls_end - (uintptr_t)__tls_start;
+
+    void *tls = malloc(__tls_size);
+    if (tls == NULL)
+    {
+        free(ctx);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    init_tls(tls);
+
+    // Assign the free() function to the pointer because now we are sure that we
+    // will need to free the resources of the newly created thread eventually.
+
+    free_fn = free;
+
+    cothread_stack_prepare(ctx, stack_base, stack_size, stack_size);
+
+    void *stack_top = (void *)((uintptr_t)stack_base + stack_size);
+
+    cothread_t id = cothread_create_internal(ctx, entrypoint, arg, stack_top,
+                                             tls, flags);
+
+    // Add context to the scheduler
+    cothread_list_add_ctx(ctx);
+
+    return id;
+
+invalid_args:
+    errno = EINVAL;
+    return -1;
+}
+
+cothread_t cothread_create(int (*entrypoint)(void *), void *arg,
+                           size_t stack_size, unsigned int flags)
+{
+    if ((stack_size & 7) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (entrypoint == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (((flags & COTHREAD_PRIORITY_MASK) >> COTHREAD_PRIORITY_SHIFT)
+            > COTHREAD_PRIORITY_LEVELS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (stack_size == 0)
+        stack_size = DEFAULT_STACK_SIZE_CHILD;
+
+    // Get a slab with the context, TLS and stack, from the pool if possible.
+    // The stack must be aligned to 8 bytes, which is guaranteed by the layout.
+
+    size_t dirty;
+    uint8_t *slab = cothread_slab_get(stack_size, &dirty);
+    if (slab == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Assign the free() function to the pointer because now we are sure that we
+    // will need to free the resources of the newly created thread eventually.
+
+    free_fn = free;
+
+    cothread_info_t *ctx = (cothread_info_t *)slab;
+    void *tls = slab + ALIGN_UP_8(sizeof(cothread_info_t));
+    void *stack_base = (uint8_t *)tls + cothread_slab_tls_size();
+
+    memset(ctx, 0, sizeof(cothread_info_t));
+    ctx->slab = true;
+
+    init_tls(tls);
+
+    cothread_stack_prepare(ctx, stack_base, stack_size, dirty);
+
+    void *stack_top = (void *)((uintptr_t)stack_base + stack_size);
+
+    cothread_t id = cothread_create_internal(ctx, entrypoint, arg, stack_top,
+                                             tls, flags);
+
+    // Add context to the scheduler
+    cothread_list_add_ctx(ctx);
+
+    return id;
+}
+
+
+int cothread_detach(cothread_t thread)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx->flags |= COTHREAD_DETACHED;
+
+    return 0;
+}
+
+bool cothread_has_joined(cothread_t thread)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    return ctx->joined != 0;
+}
+
+int cothread_get_exit_code(cothread_t thread)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ctx->joined == 0)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    return ctx->arg;
+}
+
+int cothread_set_priority(cothread_t thread, int priority)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if ((priority < COTHREAD_PRIORITY_HIGHEST) ||
+        (priority > COTHREAD_PRIORITY_LOWEST))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Keep any priority inherited from a mutex that other threads are waiting
+    // for, it will be dropped when the mutex is released.
+    ctx->base_priority = priority;
+    if ((ctx->contended_mutexes == 0) || (priority < ctx->priority))
+        cothread_change_priority(ctx, priority);
+
+    return 0;
+}
+
+int cothread_get_priority(cothread_t thread)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ctx->base_priority;
+}
+
+int cothread_set_deadline(cothread_t thread, int scanlines)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if (scanlines >= 263)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ctx->deadline != COTHREAD_NO_DEADLINE)
+        cothread_deadline_list_remove(ctx);
+
+    if (scanlines < 0)
+    {
+        ctx->deadline = COTHREAD_NO_DEADLINE;
+    }
+    else
+    {
+        ctx->deadline = scanlines;
+        ctx->last_frame = cothread_frame_count - 1;
+        ctx->deadline_next = cothread_deadline_list;
+        cothread_deadline_list = ctx;
+    }
+
+    return 0;
+}
+
+void cothread_block_on(void *object)
+{
+    cothread_info_t *ctx = cothread_active_thread;
+
+    // The scheduler will add the thread to the wait list of the object
+    ctx->wait_object = object;
+
+    __ndsabi_coro_yield((void *)ctx, 0);
+}
+
+bool cothread_block_on_timeout(void *object, uint32_t timeout_ms)
+{
+    cothread_info_t *ctx = cothread_active_thread;
+
+    if (timeout_ms == 0)
+        return false;
+
+    ctx->timed_out = false;
+    cothread_wheel_add(ctx, timeout_ms);
+
+    cothread_block_on(object);
+
+    return !ctx->timed_out;
+}
+
+void cothread_sleep_ms(uint32_t ms)
+{
+    cothread_info_t *ctx = cothread_active_thread;
+
+    if (ms == 0)
+    {
+        cothread_yield();
+        return;
+    }
+
+    // Block on an address that nobody else uses so that only the timer can
+    // wake up this thread.
+    cothread_block_on_timeout(&ctx->wake_tick, ms);
+}
+
+void cothread_sleep_frames(uint32_t frames)
+{
+    while (frames--)
+        cothread_yield_irq(IRQ_VBLANK);
+}
+
+int cothread_set_sleep_timer(int timer)
+{
+    if ((timer < 0) || (timer > 3))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (cothread_wheel_count > 0)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    // The profiler uses two timers, see cothread_profiling_start()
+    if (cothread_profiling && ((timer == cothread_profiling_timer)
+                               || (timer == cothread_profiling_timer + 1)))
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    cothread_timer = timer;
+    return 0;
+}
+
+int cothread_join_timeout(cothread_t thread, uint32_t timeout_ms)
+{
+    errno = 0;
+
+    if (cothread_has_joined(thread))
+        return 0;
+
+    // The thread doesn't exist
+    if (errno != 0)
+        return -1;
+
+    // The scheduler wakes up any thread blocked on a thread when it ends
+    if (!cothread_block_on_timeout((void *)thread, timeout_ms))
+    {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    // Threads are also woken up if the thread is deleted with cothread_delete()
+    if (!cothread_has_joined(thread))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+bool cothread_wake_one(void *object)
+{
+    cothread_info_t *ctx = cothread_wait_find(object);
+    if (ctx == NULL)
+        return false;
+
+    cothread_wake(ctx);
+    return true;
+}
+
+int cothread_wake_all(void *object)
+{
+    int count = 0;
+
+    cothread_info_t *p = cothread_wait_bucket[cothread_wait_hash(object)];
+
+    while (p != NULL)
+    {
+        cothread_info_t *next = p->sched_next;
+
+        if (p->wait_object == object)
+        {
+            cothread_wake(p);
+            count++;
+        }
+
+        p = next;
+    }
+
+    return count;
+}
+
+bool comutex_acquire_contended_timeout(comutex_t *mutex, uint32_t timeout_ms)
+{
+    cothread_info_t *self = cothread_active_thread;
+    cothread_info_t *owner = (cothread_info_t *)(*mutex & ~COMUTEX_WAITERS);
+
+#ifdef ARM9
+    sassert(self != NULL, "Mutexes must be used from threads");
+    sassert(owner != self, "Mutex already owned by this thread");
+#endif
+
+    if (timeout_ms == 0)
+        return false;
+
+    if ((*mutex & COMUTEX_WAITERS) == 0)
+    {
+        *mutex |= COMUTEX_WAITERS;
+        owner->contended_mutexes++;
+    }
+
+    if (owner->priority > self->priority)
+        cothread_change_priority(owner, self->priority);
+
+    self->wait_mutex_owner = owner;
+
+    bool acquired = cothread_block_on_timeout(mutex, timeout_ms);
+
+    // comutex_release_contended() updates this if the mutex is handed over to
+    // another waiter while this thread is still waiting.
+    owner = self->wait_mutex_owner;
+    self->wait_mutex_owner = NULL;
+
+    if (acquired)
+    {
+        // The mutex has been handed over to this thread
+#ifdef ARM9
+        sassert((cothread_info_t *)(*mutex & ~COMUTEX_WAITERS) == self,
+                "Mutex not owned after acquiring it");
+#endif
+        return true;
+    }
+
+    // If nobody else is waiting for the mutex, the owner isn't contended
+    // anymore. The mutex may have been released after the timeout and before
+    // this thread was resumed. In that case the owner has already dropped its
+    // count, and the mutex is either free or owned by a thread that didn't
+    // inherit any priority from this one, so it must be left alone.
+    if (cothread_wait_find(mutex) != NULL)
+        return false;
+
+    if ((owner == NULL) || ((*mutex & COMUTEX_WAITERS) == 0))
+        return false;
+
+    if ((cothread_info_t *)(*mutex & ~COMUTEX_WAITERS) != owner)
+        return false;
+
+    *mutex = (comutex_t)owner;
+    owner->contended_mutexes--;
+
+    if (owner->contended_mutexes == 0)
+        cothread_change_priority(owner, owner->base_priority);
+
+    return false;
+}
+
+void comutex_acquire_contended(comutex_t *mutex)
+{
+    cothread_info_t *self = cothread_active_thread;
+    cothread_info_t *owner = (cothread_info_t *)(*mutex & ~COMUTEX_WAITERS);
+
+#ifdef ARM9
+    sassert(self != NULL, "Mutexes must be used from threads");
+    sassert(owner != self, "Mutex already owned by this thread");
+#endif
+
+    if ((*mutex & COMUTEX_WAITERS) == 0)
+    {
+        *mutex |= COMUTEX_WAITERS;
+        owner->contended_mutexes++;
+    }
+
+    // Priority inheritance: the owner runs at least at our priority until it
+    // releases the mutex.
+    if (owner->priority > self->priority)
+        cothread_change_priority(owner, self->priority);
+
+    cothread_block_on(mutex);
+
+    // When we get here, comutex_release_contended() has already handed the
+    // ownership of the mutex to this thread.
+#ifdef ARM9
+    sassert((cothread_info_t *)(*mutex & ~COMUTEX_WAITERS) == self,
+            "Mutex not owned after acquiring it");
+#endif
+}
+
+void comutex_release_contended(comutex_t *mutex)
+{
+    cothread_info_t *self = cothread_active_thread;
+
+#ifdef ARM9
+    sassert((self != NULL) && ((cothread_info_t *)(*mutex & ~COMUTEX_WAITERS) == self),
+            "Mutex released by a thread that doesn't own it");
+#endif
+
+    self->contended_mutexes--;
+
+    // Hand the mutex over to the highest priority waiter. If it doesn't exist
+    // (it may have been deleted) the mutex is simply released.
+    cothread_info_t *next = cothread_wait_find(mutex);
+    if (next == NULL)
+    {
+        *mutex = 0;
+    }
+    else
+    {
+        cothread_wake(next);
+
+        *mutex = (comutex_t)next;
+
+        // If more threads are waiting, the new owner inherits their priority
+        cothread_info_t *waiter = cothread_wait_find(mutex);
+        if (waiter != NULL)
+        {
+            *mutex |= COMUTEX_WAITERS;
+            next->contended_mutexes++;
+
+            if (next->priority > waiter->priority)
+                cothread_change_priority(next, waiter->priority);
+
+            // Let waiters that time out know which thread has to drop the
+            // count of contended mutexes.
+            cothread_info_t *p = cothread_wait_bucket[cothread_wait_hash(mutex)];
+            for (; p != NULL; p = p->sched_next)
+            {
+                if (p->wait_object == mutex)
+                    p->wait_mutex_owner = next;
+            }
+        }
+    }
+
+    // Drop any inherited priority once this thread doesn't own any mutex that
+    // other threads are waiting for. The current thread isn't in any queue, so
+    // it can be changed directly.
+    if (self->contended_mutexes == 0)
+        self->priority = self->base_priority;
+}
+
+void cothread_yield(void)
+{
+    cothread_info_t *ctx = cothread_active_thread;
+
+    __ndsabi_coro_yield((void *)ctx, 0);
+}
+
+void cothread_yield_irq(uint32_t flags)
+{
+#ifdef ARM9
+    sassert(REG_IME != 0, "IRQs must be enabled");
+#endif
+
+    cothread_info_t *ctx = cothread_active_thread;
+
+    ctx->wait_irq_flags = flags;
+
+    __ndsabi_coro_yield((void *)ctx, 0);
+}
+
+#ifdef ARM7
+void cothread_yield_irq_aux(uint32_t flags)
+{
+    cothread_info_t *ctx = cothread_active_thread;
+
+    ctx->wait_irq_aux_flags = flags;
+
+    __ndsabi_coro_yield((void *)ctx, 0);
 }
 #endif
 
@@ -444,38 +1570,265 @@ cothread_t cothread_get_current(void)
     return (cothread_t)cothread_active_thread;
 }
 
+//-------------------------------------------------------------------
+
+// Profiling. When it's disabled, the scheduler only checks one variable per
+// context switch. When it's enabled, timestamps are read from the timers
+// configured with cpuStartTiming(). The flag is defined with the sleep timer.
+
+static cothread_scheduler_stats_t cothread_sched_stats;
+
+static cothread_trace_event_t *cothread_trace_buffer;
+static size_t cothread_trace_size;
+static size_t cothread_trace_count; // Total number of events recorded
+
+int cothread_profiling_start(int timer)
+{
+    if ((timer < 0) || (timer > 2))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // cpuStartTiming() uses "timer" and "timer + 1", and they can't overlap
+    // with the timer used to wake up sleeping threads.
+    if ((cothread_timer == timer) || (cothread_timer == timer + 1))
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    cothread_profiling_reset();
+
+    cpuStartTiming(timer);
+    cothread_profiling_timer = timer;
+    cothread_profiling = true;
+
+    return 0;
+}
+
+void cothread_profiling_stop(void)
+{
+    cothread_profiling = false;
+    cpuEndTiming();
+}
+
+void cothread_profiling_reset(void)
+{
+    memset(&cothread_sched_stats, 0, sizeof(cothread_sched_stats));
+
+    for (cothread_info_t *p = &cothread_list; p != NULL; p = p->next)
+    {
+        p->run_ticks = 0;
+        p->resume_count = 0;
+        p->irq_wait_count = 0;
+        p->block_count = 0;
+    }
+
+    cothread_trace_count = 0;
+}
+
+int cothread_get_stats(cothread_t thread, cothread_stats_t *stats)
+{
+    cothread_info_t *ctx = (cothread_info_t *)thread;
+
+    if ((stats == NULL) || !cothread_list_contains_ctx(ctx))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stats->run_ticks = ctx->run_ticks;
+    stats->resume_count = ctx->resume_count;
+    stats->irq_wait_count = ctx->irq_wait_count;
+    stats->block_count = ctx->block_count;
+
+    return 0;
+}
+
+void cothread_get_scheduler_stats(cothread_scheduler_stats_t *stats)
+{
+    *stats = cothread_sched_stats;
+}
+
+void cothread_trace_start(cothread_trace_event_t *buffer, size_t count)
+{
+    cothread_trace_count = 0;
+    cothread_trace_buffer = buffer;
+    cothread_trace_size = (buffer == NULL) ? 0 : count;
+}
+
+void cothread_trace_stop(void)
+{
+    cothread_trace_size = 0;
+    cothread_trace_buffer = NULL;
+}
+
 #ifdef ARM9
 ITCM_CODE
 #endif
-static int cothread_scheduler_start(void)
+static void cothread_trace_record(uint32_t type, cothread_t thread,
+                                  uint32_t timestamp, uint32_t duration)
+{
+    if (cothread_trace_size == 0)
+        return;
+
+    cothread_trace_event_t *ev =
+        &cothread_trace_buffer[cothread_trace_count % cothread_trace_size];
+
+    ev->timestamp = timestamp;
+    ev->duration = duration;
+    ev->thread = thread;
+    ev->type = type;
+
+    cothread_trace_count++;
+}
+
+const char *cothread_trace_type_name(uint32_t type)
+{
+    static const char *names[] = {
+        [COTHREAD_TRACE_YIELD] = "yield",
+        [COTHREAD_TRACE_WAIT_IRQ] = "wait_irq",
+        [COTHREAD_TRACE_BLOCK] = "block",
+        [COTHREAD_TRACE_END] = "end",
+        [COTHREAD_TRACE_IDLE] = "idle",
+    };
+
+    if (type > COTHREAD_TRACE_IDLE)
+        return "?";
+
+    return names[type];
+}
+
+size_t cothread_trace_read(cothread_trace_event_t *events, size_t max_events)
 {
-    cothread_info_t *ctx = &cothread_list;
+    if ((cothread_trace_size == 0) || (events == NULL))
+        return 0;
+
+    size_t count = cothread_trace_count;
+    size_t start = 0;
+
+    // If the buffer has wrapped around, start at the oldest event
+    if (count > cothread_trace_size)
+    {
+        start = count - cothread_trace_size;
+        count = cothread_trace_size;
+    }
+
+    if (count > max_events)
+        count = max_events;
+
+    for (size_t i = 0; i < count; i++)
+        events[i] = cothread_trace_buffer[(start + i) % cothread_trace_size];
 
+    return count;
+}
+
+#ifdef ARM9
+ITCM_CODE
+#endif
+static int cothread_scheduler_start(void)
+{
     while (1)
     {
-        bool delete_current_thread = false;
-        cothread_info_t *ctx_to_delete = NULL;
+        // Move to the ready queue any thread whose interrupt has happened.
+        cothread_scheduler_refresh_irq_flags();
 
-        // If the thread has finished, skip it
-        if (ctx->joined)
-            goto next_thread;
+#ifdef ARM9
+        // Run work deferred by interrupt handlers before resuming any thread.
+        // It may wake up threads, so it has to be done before picking one.
+        if (cothread_deferred_head != cothread_deferred_tail)
+            cothread_deferred_run();
+#endif
+
+        cothread_info_t *ctx = NULL;
+
+        // Threads that have reached their deadline go first. If there are none,
+        // pick the highest priority thread that is ready.
+        if (cothread_deadline_list != NULL)
+            ctx = cothread_deadline_pick();
+        if (ctx == NULL)
+            ctx = cothread_ready_pop();
+
+        if (ctx == NULL)
+        {
+            uint32_t idle_start = 0;
+            if (cothread_profiling)
+                idle_start = cpuGetTiming();
 
-        // If this thread is waiting for any interrupt to happen, skip it
+            // If no thread is ready that means that all threads are waiting
+            // for an interrupt to happen. Use BIOS calls to enter low power
+            // mode.
 #ifdef ARM9
-        if (ctx->wait_irq_flags)
-            goto next_thread;
+            CP15_WaitForInterrupt();
 #elif defined(ARM7)
-        if (ctx->wait_irq_flags || ctx->wait_irq_aux_flags)
-            goto next_thread;
+            swiHalt();
 #endif
 
+            if (cothread_profiling)
+            {
+                uint32_t idle_ticks = cpuGetTiming() - idle_start;
+
+                cothread_sched_stats.idle_ticks += idle_ticks;
+                cothread_sched_stats.idle_count++;
+                cothread_trace_record(COTHREAD_TRACE_IDLE, 0, idle_start,
+                                      idle_ticks);
+            }
+            continue;
+        }
+
         // Set this thread as the active one and resume it.
         cothread_active_thread = ctx;
+        ctx->last_frame = cothread_frame_count;
 
         set_tls(ctx->tls);
 
+        uint32_t run_start = 0;
+        if (cothread_profiling)
+            run_start = cpuGetTiming();
+
         int ret = __ndsabi_coro_resume((void *)ctx);
 
+        if (cothread_profiling)
+        {
+            uint32_t run_ticks = cpuGetTiming() - run_start;
+            uint32_t type;
+
+            ctx->run_ticks += run_ticks;
+            ctx->resume_count++;
+            cothread_sched_stats.switch_count++;
+
+            if (ctx->joined)
+            {
+                type = COTHREAD_TRACE_END;
+            }
+            else if (ctx->wait_object)
+            {
+                type = COTHREAD_TRACE_BLOCK;
+                ctx->block_count++;
+            }
+#ifdef ARM7
+            else if (ctx->wait_irq_flags || ctx->wait_irq_aux_flags)
+#else
+            else if (ctx->wait_irq_flags)
+#endif
+            {
+                type = COTHREAD_TRACE_WAIT_IRQ;
+                ctx->irq_wait_count++;
+            }
+            else
+            {
+                type = COTHREAD_TRACE_YIELD;
+            }
+
+            cothread_trace_record(type, (cothread_t)ctx, run_start, run_ticks);
+        }
+
+        // Check that the thread hasn't overflowed its stack
+        if ((ctx->stack_limit != NULL) &&
+            (*(uint32_t *)ctx->stack_limit != COTHREAD_STACK_CANARY))
+            libndsCrash("Thread stack overflow");
+
         // Check if the thread has just ended
         if (ctx->joined)
         {
@@ -486,43 +1839,22 @@ static int cothread_scheduler_start(void)
 
             // This is a regular thread.
 
+            // Wake up any thread waiting to join this one.
+            cothread_wake_all(ctx);
+
             // If it is detached, delete it. If not, save the exit code so that
             // the user can check it later.
             if (ctx->flags & COTHREAD_DETACHED)
-                delete_current_thread = true;
+                cothread_delete_internal(ctx);
             else
                 ctx->arg = ret;
-        }
-
-next_thread:
-
-        if (delete_current_thread)
-            ctx_to_delete = ctx;
-
-        bool any_thread_active = true;
 
-        // Get the next thread
-        ctx = ctx->next;
-        if (ctx == NULL)
-        {
-            ctx = &cothread_list;
-            any_thread_active = cothread_scheduler_refresh_irq_flags();
+            continue;
         }
 
-        if (delete_current_thread)
-            cothread_delete_internal(ctx_to_delete);
-
-        if (any_thread_active == false)
-        {
-            // If no thread is active that means that all threads are
-            // waiting for an interrupt to happen. Use BIOS calls to enter
-            // low power mode.
-#ifdef ARM9
-            CP15_WaitForInterrupt();
-#elif defined(ARM7)
-            swiHalt();
-#endif
-        }
+        // The thread has yielded. Put it back in the ready queue, or in the
+        // wait list of the interrupt it is waiting for.
+        cothread_sched_enqueue(ctx);
     }
 }
 
@@ -555,6 +1887,19 @@ int cothread_start(int argc, char **argv, void *main_stack_top)
 #ifdef ARM9
     main_args.argc = argc;
     main_args.argv = argv;
+
+    // If there aren't thread local variables any address works
+    cothread_deferred_tls = __tls_start;
+
+    size_t tls_size = (uintptr_t)__tls_end - (uintptr_t)__tls_start;
+    if (tls_size > 0)
+    {
+        cothread_deferred_tls = malloc(tls_size);
+        if (cothread_deferred_tls == NULL)
+            libndsCrash("Deferred work TLS");
+
+        init_tls(cothread_deferred_tls);
+    }
 #endif
 #ifdef ARM7
     (void)argc;
@@ -570,6 +1915,8 @@ int cothread_start(int argc, char **argv, void *main_stack_top)
                                              cothread_main, NULL,
                                              main_stack_top, __tls_start, 0);
 
+    cothread_ready_push(&cothread_list);
+
     cothread_scheduler_start();
 
     // If the scheduler returns it's because main() has returned.
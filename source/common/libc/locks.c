@@ -3,6 +3,7 @@
 // Copyright (c) 2024 Antonio Niño Díaz
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <nds.h>
 #include <nds/cothread.h>
@@ -18,122 +19,112 @@ struct __lock
     comutex_t mutex;
     int recursion;
     void *thread_owner;
-    bool used;
+    struct __lock *next_free; // Link in the list of closed locks
 };
 
-#define MAX_LOCKS   (FOPEN_MAX + 1)
-static struct __lock locks[MAX_LOCKS];
-
 struct __lock __lock___libc_recursive_mutex;
 
+// Locks are allocated from the heap. Closed locks are kept in a small list so
+// that they can be reused without going through the heap, which is common when
+// files are opened and closed repeatedly.
+#define LOCK_CACHE_SIZE 8
+
+static struct __lock *free_locks;
+static unsigned int free_locks_count;
+
 void __retarget_lock_init_recursive(_LOCK_T *lock)
 {
-    int selection = -1;
-    for (int i = 0; i < MAX_LOCKS; i++)
+    struct __lock *new_lock = free_locks;
+
+    if (new_lock != NULL)
     {
-        if (!locks[i].used)
-        {
-            selection = i;
-            break;
-        }
+        free_locks = new_lock->next_free;
+        free_locks_count--;
+    }
+    else
+    {
+        new_lock = malloc(sizeof(struct __lock));
+        if (new_lock == NULL)
+            libndsCrash("Lock init");
     }
 
-    if (selection == -1)
-        libndsCrash("Lock init");
-
-    *lock = &(locks[selection]);
+    comutex_init(&(new_lock->mutex));
+    new_lock->recursion = 0;
+    new_lock->thread_owner = NULL;
+    new_lock->next_free = NULL;
 
-    comutex_init(&((*lock)->mutex));
-    (*lock)->recursion = 0;
-    (*lock)->thread_owner = NULL; //__aeabi_read_tp();
-    (*lock)->used = true;
+    *lock = new_lock;
 }
 
 void __retarget_lock_close_recursive(_LOCK_T lock)
 {
-    for (int i = 0; i < MAX_LOCKS; i++)
+    // The global lock is statically allocated
+    if (lock == &__lock___libc_recursive_mutex)
+        return;
+
+    if (free_locks_count < LOCK_CACHE_SIZE)
     {
-        if (&locks[i] == lock)
-        {
-            locks[i].used = false;
-            return;
-        }
+        lock->next_free = free_locks;
+        free_locks = lock;
+        free_locks_count++;
+    }
+    else
+    {
+        free(lock);
     }
-
-    libndsCrash("Lock close");
 }
 
 void __retarget_lock_acquire_recursive(_LOCK_T lock)
 {
     void *this_thread = __aeabi_read_tp();
 
-    // Loop until this thread owns the lock, or no thread owns it
-    while (1)
+    if (lock->thread_owner == this_thread)
     {
-        bool acquired = false;
-
-        comutex_acquire(&(lock->mutex));
-
-        if (lock->thread_owner == this_thread)
-        {
-            lock->recursion++;
-            acquired = true;
-        }
-        else if (lock->thread_owner == NULL)
-        {
-            lock->thread_owner = this_thread;
-            lock->recursion++;
-            acquired = true;
-        }
-
-        comutex_release(&(lock->mutex));
+        lock->recursion++;
+        return;
+    }
 
-        if (acquired)
-            break;
+    // The mutex is held for as long as the lock is owned, so other threads
+    // block in the mutex instead of polling the lock.
+    comutex_acquire(&(lock->mutex));
 
-        cothread_yield();
-    }
+    lock->thread_owner = this_thread;
+    lock->recursion = 1;
 }
 
 int __retarget_lock_try_acquire_recursive(_LOCK_T lock)
 {
     void *this_thread = __aeabi_read_tp();
-    bool acquired = false;
-
-    comutex_acquire(&(lock->mutex));
 
     if (lock->thread_owner == this_thread)
     {
         lock->recursion++;
-        acquired = true;
-    }
-    else if (lock->thread_owner == NULL)
-    {
-        lock->thread_owner = this_thread;
-        lock->recursion++;
-        acquired = true;
+        return true;
     }
 
-    comutex_release(&(lock->mutex));
+    if (!comutex_try_acquire(&(lock->mutex)))
+        return false;
 
-    return acquired;
+    lock->thread_owner = this_thread;
+    lock->recursion = 1;
+
+    return true;
 }
 
 void __retarget_lock_release_recursive(_LOCK_T lock)
 {
     void *this_thread = __aeabi_read_tp();
 
-    comutex_acquire(&(lock->mutex));
-
     if (lock->thread_owner != this_thread)
         libndsCrash("Lock release");
 
     lock->recursion--;
 
     if (lock->recursion == 0)
+    {
         lock->thread_owner = NULL;
-
-    comutex_release(&(lock->mutex));
+        comutex_release(&(lock->mutex));
+    }
 }
 
 void __retarget_lock_init(_LOCK_T *lock)
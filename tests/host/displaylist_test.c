@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Test of the display list recorder (source/arm9/video/displaylist.c), built
+// for the host.
+//
+// It checks the table of parameters of each command, the packed format of
+// recorded lists, overflows, and that glListDecode() gives back the same
+// commands that have been recorded, and rejects broken lists. Random lists are
+// recorded and decoded to compare them with the commands that were added.
+// Finally, it checks that glListCommand() asserts if the number of parameters
+// doesn't match the command.
+//
+// Usage: displaylist_test [iterations] [seed]
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <nds/arm9/displaylist.h>
+
+#define CHECK(cond, ...)                                            \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                          \
+            printf(__VA_ARGS__);                                    \
+            printf("\n");                                           \
+            exit(1);                                                \
+        }                                                           \
+    } while (0)
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Valid commands and their number of parameters
+static const struct
+{
+    u8 id;
+    int params;
+} commands[] = {
+    { 0x00, 0 }, { 0x10, 1 }, { 0x11, 0 }, { 0x12, 1 }, { 0x13, 1 },
+    { 0x14, 1 }, { 0x15, 0 }, { 0x16, 16 }, { 0x17, 12 }, { 0x18, 16 },
+    { 0x19, 12 }, { 0x1A, 9 }, { 0x1B, 3 }, { 0x1C, 3 }, { 0x20, 1 },
+    { 0x21, 1 }, { 0x22, 1 }, { 0x23, 2 }, { 0x24, 1 }, { 0x25, 1 },
+    { 0x26, 1 }, { 0x27, 1 }, { 0x28, 1 }, { 0x29, 1 }, { 0x2A, 1 },
+    { 0x2B, 1 }, { 0x30, 1 }, { 0x31, 1 }, { 0x32, 1 }, { 0x33, 1 },
+    { 0x34, 32 }, { 0x40, 1 }, { 0x41, 0 }, { 0x50, 1 }, { 0x60, 1 },
+    { 0x70, 3 }, { 0x71, 2 }, { 0x72, 1 },
+};
+
+#define NUM_COMMANDS (int)(sizeof(commands) / sizeof(commands[0]))
+
+// Commands received by the decode callback
+typedef struct
+{
+    u8 command[512];
+    u32 params[4096];
+    u32 num_params[512];
+    int count;
+    u32 total_params;
+} decoded_list;
+
+static void decode_callback(u8 command, const u32 *params, u32 num_params,
+                            void *userdata)
+{
+    decoded_list *d = userdata;
+
+    CHECK(d->count < 512, "too many commands");
+    CHECK(d->total_params + num_params <= 4096, "too many parameters");
+
+    d->command[d->count] = command;
+    d->num_params[d->count] = num_params;
+    d->count++;
+
+    memcpy(&d->params[d->total_params], params, num_params * sizeof(u32));
+    d->total_params += num_params;
+}
+
+static void test_params(void)
+{
+    int valid = 0;
+
+    for (int id = 0; id < 256; id++)
+    {
+        int expected = -1;
+
+        for (int i = 0; i < NUM_COMMANDS; i++)
+        {
+            if (commands[i].id == id)
+                expected = commands[i].params;
+        }
+
+        if (expected >= 0)
+            valid++;
+
+        CHECK(glListCommandParams(id) == expected,
+              "command 0x%02X: %d parameters, expected %d", id,
+              glListCommandParams(id), expected);
+    }
+
+    CHECK(valid == NUM_COMMANDS, "repeated commands in the test");
+}
+
+static void test_format(void)
+{
+    u32 buffer[16];
+    GLDisplayList list;
+
+    // The buffer needs space for the size word at least
+    CHECK(!glListInit(&list, NULL, sizeof(buffer)), "accepted NULL buffer");
+    CHECK(!glListInit(&list, buffer, 3), "accepted small buffer");
+    CHECK(glListInit(&list, buffer, sizeof(u32)), "rejected minimum buffer");
+
+    const u32 *empty = glListFinish(&list);
+    CHECK(empty == buffer, "empty list not returned");
+    CHECK(empty[0] == 0, "empty list has size %u", (unsigned)empty[0]);
+    CHECK(glListDecode(empty, decode_callback, &(decoded_list){ 0 }) == 0,
+          "empty list has commands");
+
+    // Five commands need two header words. Unused slots are NOP.
+    CHECK(glListInit(&list, buffer, sizeof(buffer)), "glListInit failed");
+    glListBegin(&list, GL_TRIANGLES);
+    glListColor(&list, 0x7FFF);
+    glListVertex3v16(&list, 1, 2, 3);
+    glListPushMatrix(&list);
+    glListEnd(&list);
+
+    const u32 expected[] = {
+        6,
+        0x11232040, // BEGIN_VTXS, COLOR, VTX_16, MTX_PUSH
+        GL_TRIANGLES,
+        0x7FFF,
+        (2 << 16) | 1,
+        3,
+        0x00000041, // END_VTXS, NOP, NOP, NOP
+    };
+    const u32 *data = glListFinish(&list);
+    CHECK(data != NULL, "glListFinish failed");
+    for (u32 i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        CHECK(data[i] == expected[i], "word %u is 0x%08X, expected 0x%08X",
+              (unsigned)i, (unsigned)data[i], (unsigned)expected[i]);
+    }
+
+    decoded_list d = { 0 };
+    CHECK(glListDecode(data, decode_callback, &d) == 5, "wrong number of commands");
+    CHECK((d.command[0] == 0x40) && (d.command[4] == 0x41), "wrong commands");
+    CHECK(d.total_params == 4, "wrong number of parameters");
+
+    // Reset empties the list
+    glListReset(&list);
+    data = glListFinish(&list);
+    CHECK(data[0] == 0, "glListReset didn't empty the list");
+
+    // A command that doesn't fit sets the overflow flag. The list can't be
+    // finished until it has been reset.
+    u32 small[4];
+    CHECK(glListInit(&list, small, sizeof(small)), "glListInit failed");
+    glListColor(&list, 1);
+    glListColor(&list, 2);
+    CHECK(!glListCommand1(&list, FIFO_COLOR, 3), "command didn't overflow");
+    CHECK(list.overflow, "overflow flag not set");
+    CHECK(glListFinish(&list) == NULL, "overflowed list finished");
+    glListReset(&list);
+    CHECK(glListFinish(&list) != NULL, "glListReset didn't clear overflow");
+
+    // The header word counts when checking the space left. There is space for
+    // the parameter of the command, but not for the new header word.
+    CHECK(glListInit(&list, small, 3 * sizeof(u32)), "glListInit failed");
+    glListPushMatrix(&list);
+    glListPushMatrix(&list);
+    glListPushMatrix(&list);
+    glListPushMatrix(&list);
+    CHECK(!list.overflow, "commands without parameters didn't fit");
+    CHECK(!glListCommand1(&list, FIFO_COLOR, 1), "command fit without header");
+}
+
+static void test_decode_errors(void)
+{
+    decoded_list d = { 0 };
+
+    // Invalid command ID
+    const u32 invalid[] = { 2, 0x00000001, 0 };
+    CHECK(glListDecode(invalid, decode_callback, &d) == -1, "invalid command");
+
+    // Parameters past the end of the list
+    const u32 truncated[] = { 2, 0x00000023, 0 };
+    CHECK(glListDecode(truncated, decode_callback, &d) == -1, "truncated list");
+
+    // The callback can be NULL to count the commands
+    const u32 nops[] = { 3, 0x00001511, 0x00000000, 0x00000015 };
+    CHECK(glListDecode(nops, NULL, NULL) == 3, "wrong number of commands");
+}
+
+static void test_random(int iterations)
+{
+    static u32 buffer[1024];
+    static u32 params[4096];
+    static u8 ids[512];
+    static u32 num[512];
+
+    for (int it = 0; it < iterations; it++)
+    {
+        GLDisplayList list;
+        size_t size = (4 + (rng() % 1020)) * sizeof(u32);
+
+        CHECK(glListInit(&list, buffer, size), "glListInit failed");
+
+        int count = 0;
+        u32 total = 0;
+        bool overflow = false;
+        int length = rng() % 512;
+
+        for (int i = 0; i < length; i++)
+        {
+            int c = 1 + (rng() % (NUM_COMMANDS - 1)); // Skip NOP
+            u8 id = commands[c].id;
+            u32 n = commands[c].params;
+
+            u32 *p = &params[total];
+            for (u32 j = 0; j < n; j++)
+                p[j] = rng();
+
+            // Smaller commands may still fit after an overflow, but the list
+            // stays broken.
+            if (!glListCommand(&list, id, p, n))
+            {
+                overflow = true;
+            }
+            else if (!overflow)
+            {
+                ids[count] = id;
+                num[count] = n;
+                count++;
+                total += n;
+            }
+
+            CHECK(list.overflow == overflow, "wrong overflow flag");
+
+            CHECK(list.size <= list.capacity, "list bigger than the buffer");
+        }
+
+        const u32 *data = glListFinish(&list);
+        if (overflow)
+        {
+            CHECK(data == NULL, "overflowed list finished");
+            continue;
+        }
+
+        CHECK(data != NULL, "glListFinish failed");
+
+        decoded_list d = { 0 };
+        CHECK(glListDecode(data, decode_callback, &d) == count,
+              "decoded %d commands, expected %d", d.count, count);
+        CHECK(d.total_params == total, "wrong number of parameters");
+
+        for (int i = 0; i < count; i++)
+        {
+            CHECK((d.command[i] == ids[i]) && (d.num_params[i] == num[i]),
+                  "command %d is 0x%02X, expected 0x%02X", i, d.command[i], ids[i]);
+        }
+        CHECK(memcmp(d.params, params, total * sizeof(u32)) == 0,
+              "wrong parameters");
+    }
+}
+
+// Runs a command with the wrong number of parameters in a child process and
+// checks that it asserts.
+static void check_asserts(u8 command, u32 num_params)
+{
+    fflush(stdout);
+
+    pid_t pid = fork();
+    CHECK(pid >= 0, "fork failed");
+
+    if (pid == 0)
+    {
+        // Don't show the message of the assertion
+        freopen("/dev/null", "w", stdout);
+
+        u32 buffer[64];
+        u32 params[32] = { 0 };
+        GLDisplayList list;
+
+        glListInit(&list, buffer, sizeof(buffer));
+        glListCommand(&list, command, params, num_params);
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && (WEXITSTATUS(status) != 0),
+          "command 0x%02X with %u parameters didn't assert", command,
+          (unsigned)num_params);
+}
+
+static void test_assert(void)
+{
+    check_asserts(FIFO_VERTEX16, 1);
+    check_asserts(FIFO_VERTEX16, 3);
+    check_asserts(REG2ID(MATRIX_PUSH), 1);
+    check_asserts(0x01, 0); // Invalid command
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+    rng_state = (argc > 2) ? strtoul(argv[2], NULL, 0) : 12345;
+    if (rng_state == 0)
+        rng_state = 1;
+
+    test_params();
+    test_format();
+    test_decode_errors();
+    test_random(iterations);
+    test_assert();
+
+    printf("displaylist_test: %d iterations OK\n", iterations);
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Functions of libnds that the code under test needs, implemented for the host.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <nds/arm9/sassert.h>
+
+// Failed assertions print the message and exit with an error code
+void __sassert(const char *fileName, int lineNumber, const char *conditionString,
+               const char *format, ...)
+{
+    va_list args;
+
+    printf("%s:%d: assertion failed: %s\n", fileName, lineNumber, conditionString);
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+
+    exit(1);
+}
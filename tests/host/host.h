@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Included before any other file by the Makefile. It removes the attributes of
+// the headers of libnds that only make sense when building for ARM.
+
+#include <nds/ndstypes.h>
+
+#undef ARM_CODE
+#define ARM_CODE
+#undef THUMB_CODE
+#define THUMB_CODE
@@ -0,0 +1,546 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Test of the mesh loader (source/arm9/video/mesh.c) and the mesh converter
+// (tools/meshconv), built for the host.
+//
+// The Makefile converts fixtures/mesh.obj with meshconv. This test loads the
+// result from a file and from RAM, decodes the header, textures and display
+// lists, and compares the text dump with fixtures/mesh.txt. Then it checks that
+// damaged copies of the file are rejected, and that texture data is kept
+// while texture uploads are deferred.
+//
+// The functions of videoGL used by the loader are replaced by stubs that
+// record the calls.
+//
+// Usage: mesh_test mesh.bin expected.txt
+//        mesh_test --dump mesh.bin
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/displaylist.h>
+#include <nds/arm9/mesh.h>
+
+#define CHECK(cond, ...)                                            \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                          \
+            printf(__VA_ARGS__);                                    \
+            printf("\n");                                           \
+            exit(1);                                                \
+        }                                                           \
+    } while (0)
+
+// Stubs of videoGL
+// ----------------
+
+#define STUB_TEXTURES 16
+
+typedef struct
+{
+    bool allocated;
+    int type, size_x, size_y, param;
+    const void *data;
+    u8 data_start[8]; // Copy of the start of the data and the palette. The
+    u16 colors[16];   // data may be freed as soon as it has been uploaded.
+    int num_colors;
+} stub_texture;
+
+static stub_texture stub_textures[STUB_TEXTURES];
+static int stub_bound;
+static size_t stub_pending; // Value returned by glTexUploadsPending()
+static int stub_fail_palette; // Make glColorTableEXT() fail
+static int stub_deleted; // Textures deleted with glDeleteTextures()
+static const void *stub_flushed[STUB_TEXTURES]; // Buffers flushed
+static int stub_num_flushed;
+
+int glGenTextures(int n, int *names)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int name = 0;
+
+        for (int t = 1; t < STUB_TEXTURES; t++)
+        {
+            if (!stub_textures[t].allocated)
+            {
+                name = t;
+                break;
+            }
+        }
+
+        if (name == 0)
+            return 0;
+
+        memset(&stub_textures[name], 0, sizeof(stub_texture));
+        stub_textures[name].allocated = true;
+        names[i] = name;
+    }
+
+    return 1;
+}
+
+int glDeleteTextures(int n, int *names)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (names[i] == 0)
+            continue;
+
+        CHECK(stub_textures[names[i]].allocated, "texture %d deleted twice", names[i]);
+        stub_textures[names[i]].allocated = false;
+        stub_deleted++;
+    }
+
+    return 1;
+}
+
+int glBindTexture(int target, int name)
+{
+    (void)target;
+
+    stub_bound = name;
+    return 1;
+}
+
+int glTexImage2D(int target, int empty1, GL_TEXTURE_TYPE_ENUM type, int sizeX,
+                 int sizeY, int empty2, int param, const void *texture)
+{
+    (void)target;
+    (void)empty1;
+    (void)empty2;
+
+    stub_texture *tex = &stub_textures[stub_bound];
+
+    CHECK(tex->allocated, "glTexImage2D() without a texture");
+
+    tex->type = type;
+    tex->size_x = sizeX;
+    tex->size_y = sizeY;
+    tex->param = param;
+    tex->data = texture;
+    memcpy(tex->data_start, texture, sizeof(tex->data_start));
+
+    return 1;
+}
+
+int glColorTableEXT(int target, int empty1, uint16_t width, int empty2,
+                    int empty3, const void *table)
+{
+    (void)target;
+    (void)empty1;
+    (void)empty2;
+    (void)empty3;
+
+    stub_texture *tex = &stub_textures[stub_bound];
+
+    CHECK(tex->allocated, "glColorTableEXT() without a texture");
+
+    if (stub_fail_palette)
+        return 0;
+
+    tex->num_colors = width;
+    memcpy(tex->colors, table, ((width < 16) ? width : 16) * sizeof(u16));
+
+    return 1;
+}
+
+size_t glTexUploadsPending(void)
+{
+    return stub_pending;
+}
+
+bool glTexUploadsFlushBuffer(const void *src, size_t size)
+{
+    (void)size;
+
+    // The textures of the mesh must be deleted before, so that their uploads
+    // are dropped instead of copied.
+    CHECK(stub_deleted > 0, "buffer flushed before deleting the textures");
+    CHECK(stub_num_flushed < STUB_TEXTURES, "too many flushed buffers");
+
+    stub_flushed[stub_num_flushed++] = src;
+
+    return false;
+}
+
+void glCallList(const void *list)
+{
+    (void)list;
+}
+
+static void stub_reset(void)
+{
+    memset(stub_textures, 0, sizeof(stub_textures));
+    stub_bound = 0;
+    stub_pending = 0;
+    stub_fail_palette = 0;
+    stub_deleted = 0;
+    stub_num_flushed = 0;
+}
+
+// Helpers
+// -------
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+} text_buffer;
+
+static void text_printf(text_buffer *text, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (text->size + len + 1 > text->capacity)
+    {
+        text->capacity = (text->size + len + 1) * 2;
+        text->data = realloc(text->data, text->capacity);
+        CHECK(text->data != NULL, "out of memory");
+    }
+
+    va_start(args, fmt);
+    vsnprintf(text->data + text->size, len + 1, fmt, args);
+    va_end(args);
+
+    text->size += len;
+}
+
+static void *load_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL, "can't open %s", path);
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // Allocate one more byte so that text files can be used as strings. The
+    // memory returned by malloc() is aligned enough for the loader.
+    char *data = calloc(1, len + 1);
+    CHECK(data != NULL, "out of memory");
+    CHECK(fread(data, 1, len, f) == (size_t)len, "can't read %s", path);
+
+    fclose(f);
+
+    *size = len;
+    return data;
+}
+
+static const char *command_name(u8 command)
+{
+    switch (command)
+    {
+        case 0x20:
+            return "COLOR";
+        case 0x21:
+            return "NORMAL";
+        case 0x22:
+            return "TEXCOORD";
+        case 0x23:
+            return "VTX_16";
+        case 0x40:
+            return "BEGIN_VTXS";
+        case 0x41:
+            return "END_VTXS";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+static int sign_extend(u32 value, int bits)
+{
+    return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+// Prints commands with their parameters decoded to make the fixture readable
+static void dump_command(u8 command, const u32 *params, u32 num_params,
+                         void *userdata)
+{
+    text_buffer *text = userdata;
+
+    text_printf(text, "    %s", command_name(command));
+
+    switch (command)
+    {
+        case 0x21: // NORMAL (1.0.9 per component)
+            text_printf(text, " %d %d %d", sign_extend(params[0], 10),
+                        sign_extend(params[0] >> 10, 10),
+                        sign_extend(params[0] >> 20, 10));
+            break;
+        case 0x22: // TEXCOORD (1.11.4 per component)
+            text_printf(text, " %d %d", (s16)(params[0] & 0xFFFF),
+                        (s16)(params[0] >> 16));
+            break;
+        case 0x23: // VTX_16 (1.3.12 per component)
+            text_printf(text, " %d %d %d", (s16)(params[0] & 0xFFFF),
+                        (s16)(params[0] >> 16), (s16)(params[1] & 0xFFFF));
+            break;
+        default:
+            for (u32 i = 0; i < num_params; i++)
+                text_printf(text, " 0x%X", (unsigned int)params[i]);
+            break;
+    }
+
+    text_printf(text, "\n");
+}
+
+static void dump_mesh(const GLMesh *mesh, text_buffer *text)
+{
+    const GLMeshHeader *h = &mesh->header;
+
+    text_printf(text, "version %d materials %d textures %d\n", h->version,
+                h->num_materials, h->num_textures);
+    text_printf(text, "bounds %d %d %d %d %d %d\n", h->bounds[0], h->bounds[1],
+                h->bounds[2], h->bounds[3], h->bounds[4], h->bounds[5]);
+
+    for (int i = 0; i < h->num_textures; i++)
+    {
+        const stub_texture *tex = &stub_textures[mesh->textures[i]];
+        text_printf(text, "texture %d: type %d size %d %d param 0x%X colors %d\n",
+                    i, tex->type, tex->size_x, tex->size_y, tex->param,
+                    tex->num_colors);
+
+        text_printf(text, "    data");
+        for (int b = 0; b < 8; b++)
+            text_printf(text, " %02X", tex->data_start[b]);
+        text_printf(text, "\n");
+
+        text_printf(text, "    palette");
+        for (int c = 0; (c < tex->num_colors) && (c < 16); c++)
+            text_printf(text, " %04X", tex->colors[c]);
+        text_printf(text, "\n");
+    }
+
+    for (int i = 0; i < h->num_materials; i++)
+    {
+        const GLMeshMaterialInfo *mat = &mesh->materials[i];
+
+        text_printf(text, "material %d: poly_fmt 0x%X texture %d\n", i,
+                    (unsigned int)mat->poly_fmt, mat->texture);
+
+        int count = glListDecode(glMeshGetList(mesh, i), dump_command, text);
+        CHECK(count > 0, "failed to decode list of material %d", i);
+    }
+}
+
+static void compare_dump(const GLMesh *mesh, const char *expected,
+                         const char *source)
+{
+    text_buffer text = { 0 };
+
+    dump_mesh(mesh, &text);
+
+    if (strcmp(text.data, expected) != 0)
+    {
+        printf("mesh loaded from %s doesn't match the fixture:\n%s", source,
+               text.data);
+        exit(1);
+    }
+
+    free(text.data);
+}
+
+// Tests
+// -----
+
+static void test_load(const char *path, const char *expected)
+{
+    GLMesh mesh;
+    size_t size;
+    void *file = load_file(path, &size);
+
+    // From a file
+    stub_reset();
+    CHECK(glMeshLoadFile(path, &mesh) == GL_MESH_NO_ERROR, "glMeshLoadFile() failed");
+    CHECK(mesh.owns_data, "lists read from a file must be allocated");
+    compare_dump(&mesh, expected, "a file");
+    glMeshFree(&mesh);
+    CHECK(stub_deleted == 1, "textures not deleted");
+
+    // From RAM. The lists must be used in place.
+    stub_reset();
+    CHECK(glMeshLoadMem(file, size, &mesh) == GL_MESH_NO_ERROR, "glMeshLoadMem() failed");
+    CHECK(!mesh.owns_data, "lists loaded from RAM must not be copied");
+    CHECK(((const u8 *)mesh.lists >= (const u8 *)file)
+          && ((const u8 *)mesh.lists < (const u8 *)file + size),
+          "lists loaded from RAM must be used in place");
+    compare_dump(&mesh, expected, "RAM");
+    glMeshFree(&mesh);
+
+    free(file);
+}
+
+// Finds the offset of the first chunk with the provided ID inside "NMSH"
+static size_t find_chunk(const u8 *file, size_t size, const char *id)
+{
+    size_t pos = 16;
+
+    while (pos + 8 <= size)
+    {
+        u32 chunk_size;
+        memcpy(&chunk_size, file + pos + 4, 4);
+
+        if (memcmp(file + pos, id, 4) == 0)
+            return pos;
+
+        pos += 8 + chunk_size;
+    }
+
+    CHECK(false, "chunk %s not found", id);
+    return 0;
+}
+
+static void expect_error(const void *data, size_t size, GLMeshError expected,
+                         const char *what)
+{
+    GLMesh mesh;
+
+    stub_reset();
+
+    GLMeshError ret = glMeshLoadMem(data, size, &mesh);
+    CHECK(ret == expected, "%s: expected error %d, got %d", what, expected, ret);
+
+    // On error, everything must be freed
+    for (int i = 0; i < STUB_TEXTURES; i++)
+        CHECK(!stub_textures[i].allocated, "%s: texture %d leaked", what, i);
+}
+
+static void test_invalid(const char *path)
+{
+    size_t size;
+    u8 *file = load_file(path, &size);
+    u8 *copy = malloc(size);
+    CHECK(copy != NULL, "out of memory");
+
+    size_t tex = find_chunk(file, size, "TEX ");
+    size_t mtrl = find_chunk(file, size, "MTRL");
+    size_t dlst = find_chunk(file, size, "DLST");
+
+    // Truncated files
+    for (size_t len = 0; len < size; len += 4)
+        expect_error(file, len, GL_MESH_INVALID_FORMAT, "truncated file");
+
+    // Texture data size that doesn't match the format and size of the texture
+    memcpy(copy, file, size);
+    copy[tex + 8 + 8] -= 8; // data_size
+    expect_error(copy, size, GL_MESH_INVALID_FORMAT, "texture data size");
+
+    // Invalid texture format and size
+    memcpy(copy, file, size);
+    copy[tex + 8 + 0] = GL_RGB + 1; // type
+    expect_error(copy, size, GL_MESH_INVALID_FORMAT, "texture type");
+
+    memcpy(copy, file, size);
+    copy[tex + 8 + 1] = TEXTURE_SIZE_1024 + 1; // size_x
+    expect_error(copy, size, GL_MESH_INVALID_FORMAT, "texture size");
+
+    // Palette bigger than the chunk
+    memcpy(copy, file, size);
+    copy[tex + 8 + 12] = 0xFF; // num_colors
+    expect_error(copy, size, GL_MESH_INVALID_FORMAT, "palette size");
+
+    // Material that uses a texture that doesn't exist
+    memcpy(copy, file, size);
+    copy[mtrl + 8 + 4] = 5; // texture
+    expect_error(copy, size, GL_MESH_INVALID_FORMAT, "material texture");
+
+    // Display list that goes past the end of the chunk
+    memcpy(copy, file, size);
+    copy[dlst + 8 + 1] += 1; // Size of the first list (+256 words)
+    expect_error(copy, size, GL_MESH_INVALID_FORMAT, "list size");
+
+    // Unsupported version
+    memcpy(copy, file, size);
+    copy[16 + 8] = GL_MESH_VERSION + 1;
+    expect_error(copy, size, GL_MESH_INVALID_VERSION, "version");
+
+    free(copy);
+    free(file);
+}
+
+static void test_deferred(const char *path)
+{
+    GLMesh mesh;
+
+    // When uploads are pending, the data read from the file must be kept until
+    // glMeshFree(), which must flush it after deleting the textures.
+    stub_reset();
+    stub_pending = 32;
+    CHECK(glMeshLoadFile(path, &mesh) == GL_MESH_NO_ERROR, "glMeshLoadFile() failed");
+
+    const void *data = mesh.texture_data[0];
+    CHECK(data != NULL, "texture data not kept while uploads are pending");
+    CHECK(stub_textures[mesh.textures[0]].data == data,
+          "texture loaded from a different buffer");
+
+    glMeshFree(&mesh);
+    CHECK((stub_num_flushed == 1) && (stub_flushed[0] == data),
+          "texture data not flushed before freeing it");
+
+    // If the palette fails to load after the texture has been queued, the
+    // data must be kept until the texture is deleted as well.
+    stub_reset();
+    stub_pending = 32;
+    stub_fail_palette = 1;
+    CHECK(glMeshLoadFile(path, &mesh) == GL_MESH_TEXTURE_FAILED,
+          "glMeshLoadFile() didn't fail");
+    CHECK((stub_deleted == 1) && (stub_num_flushed == 1),
+          "texture data not flushed after an error");
+
+    // Without pending uploads nothing is kept
+    stub_reset();
+    CHECK(glMeshLoadFile(path, &mesh) == GL_MESH_NO_ERROR, "glMeshLoadFile() failed");
+    CHECK(mesh.texture_data[0] == NULL, "texture data kept without pending uploads");
+    glMeshFree(&mesh);
+    CHECK(stub_num_flushed == 0, "unexpected flush");
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc == 3) && (strcmp(argv[1], "--dump") == 0))
+    {
+        GLMesh mesh;
+        text_buffer text = { 0 };
+
+        CHECK(glMeshLoadFile(argv[2], &mesh) == GL_MESH_NO_ERROR,
+              "glMeshLoadFile() failed");
+        dump_mesh(&mesh, &text);
+        printf("%s", text.data);
+        return 0;
+    }
+
+    if (argc != 3)
+    {
+        printf("Usage: mesh_test mesh.bin expected.txt\n"
+               "       mesh_test --dump mesh.bin\n");
+        return 1;
+    }
+
+    size_t size;
+    char *expected = load_file(argv[2], &size);
+
+    test_load(argv[1], expected);
+    test_invalid(argv[1]);
+    test_deferred(argv[1]);
+
+    free(expected);
+
+    printf("mesh_test: OK\n");
+
+    return 0;
+}
@@ -0,0 +1,568 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Test of the texture residency manager of videoGL
+// (source/arm9/video/tex_residency.c), built for the host.
+//
+// The callbacks of the manager are implemented with a model of the textures
+// and of the VRAM available for them. First, a few scenarios are checked step
+// by step. Then, random operations are done and these things are checked:
+//
+// - The bytes counted as resident are the sum of the sizes of the resident
+//   textures, and only resident textures are in VRAM.
+// - Evicted textures are the least recently used ones, and they are never the
+//   active texture or a texture used in the current frame.
+// - After enforcing the budget, the textures fit in it, or there is nothing
+//   left that can be evicted.
+// - texResidency_update() loads pending textures in order, stops at the first
+//   one that fails, and doesn't go over the limit of bytes (unless it only
+//   loads one texture).
+//
+// Usage: tex_residency_test [iterations] [seed]
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tex_residency.h"
+
+#define MAX_TEXTURES 16
+
+typedef struct
+{
+    bool exists;
+    bool managed;
+    bool inVram;
+    s_texResidencyEntry entry;
+} texture_t;
+
+static texture_t textures[MAX_TEXTURES];
+static int active_texture;
+
+static size_t vram_size;  // VRAM available for textures
+static size_t vram_used;  // Used by managed and unmanaged textures
+static size_t vram_other; // Used by textures not handled by the manager
+
+static s_texResidency res;
+
+// Log of the calls to the callbacks
+static int evicted[MAX_TEXTURES * 4];
+static int num_evicted;
+static int loaded[MAX_TEXTURES * 4];
+static int num_loaded;
+static int failed_load;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+#define CHECK(cond, ...)                                            \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                          \
+            printf(__VA_ARGS__);                                    \
+            printf("\n");                                           \
+            exit(1);                                                \
+        }                                                           \
+    } while (0)
+
+// Returns true if the texture can be evicted by texResidency_evictLRU()
+static bool evictable(int name)
+{
+    texture_t *t = &textures[name];
+
+    return t->exists && t->managed && (t->entry.state == TEX_RESIDENCY_RESIDENT)
+           && (name != active_texture) && (t->entry.lastUsedFrame != res.frame);
+}
+
+// Callbacks
+// ---------
+
+static int cb_count(void)
+{
+    return MAX_TEXTURES;
+}
+
+static int cb_active(void)
+{
+    return active_texture;
+}
+
+static s_texResidencyEntry *cb_get(int name)
+{
+    if ((name <= 0) || (name >= MAX_TEXTURES))
+        return NULL;
+
+    texture_t *t = &textures[name];
+    if (!t->exists || !t->managed)
+        return NULL;
+
+    return &t->entry;
+}
+
+static void cb_evict(int name)
+{
+    CHECK((name > 0) && (name < MAX_TEXTURES), "evicted invalid name %d", name);
+    CHECK(evictable(name), "texture %d can't be evicted", name);
+    CHECK(textures[name].inVram, "texture %d isn't in VRAM", name);
+
+    // It must be the least recently used texture
+    for (int i = 1; i < MAX_TEXTURES; i++)
+    {
+        if (evictable(i))
+        {
+            CHECK(textures[i].entry.lastUsedFrame
+                  >= textures[name].entry.lastUsedFrame,
+                  "evicted %d (frame %" PRIu32 ") before %d (frame %" PRIu32 ")",
+                  name, textures[name].entry.lastUsedFrame,
+                  i, textures[i].entry.lastUsedFrame);
+        }
+    }
+
+    textures[name].inVram = false;
+    vram_used -= textures[name].entry.size;
+
+    CHECK(num_evicted < MAX_TEXTURES * 4, "too many evictions");
+    evicted[num_evicted++] = name;
+}
+
+static bool cb_load(int name)
+{
+    CHECK((name > 0) && (name < MAX_TEXTURES), "loaded invalid name %d", name);
+
+    texture_t *t = &textures[name];
+
+    CHECK(t->entry.state == TEX_RESIDENCY_PENDING, "texture %d isn't pending", name);
+    CHECK(!t->inVram, "texture %d is already in VRAM", name);
+    CHECK(t->entry.lastUsedFrame == res.frame, "texture %d not used", name);
+
+    // Like glTexImage2D(), try to make room by evicting other textures
+    while (vram_used + t->entry.size > vram_size)
+    {
+        if (!texResidency_evictLRU(&res))
+        {
+            failed_load = name;
+            return false;
+        }
+    }
+
+    t->inVram = true;
+    vram_used += t->entry.size;
+
+    CHECK(num_loaded < MAX_TEXTURES * 4, "too many loads");
+    loaded[num_loaded++] = name;
+
+    return true;
+}
+
+static const s_texResidencyCallbacks callbacks =
+{
+    .count = cb_count,
+    .active = cb_active,
+    .get = cb_get,
+    .evict = cb_evict,
+    .load = cb_load,
+};
+
+// Helpers that do the same as videoGL
+// -----------------------------------
+
+static void reset(size_t vram)
+{
+    for (int i = 0; i < MAX_TEXTURES; i++)
+        textures[i] = (texture_t){ 0 };
+
+    active_texture = 0;
+    vram_size = vram;
+    vram_used = 0;
+    vram_other = 0;
+    num_evicted = 0;
+    num_loaded = 0;
+
+    texResidency_init(&res, &callbacks);
+}
+
+static void clear_log(void)
+{
+    num_evicted = 0;
+    num_loaded = 0;
+    failed_load = 0;
+}
+
+// glGenTextures() + glBindTexture() + glTexImage2DResident()
+static bool add_texture(int name, uint32_t size)
+{
+    texture_t *t = &textures[name];
+
+    t->exists = true;
+    t->managed = false;
+    active_texture = name;
+
+    texResidency_enforceBudget(&res, size);
+
+    while (vram_used + size > vram_size)
+    {
+        if (!texResidency_evictLRU(&res))
+            return false;
+    }
+
+    vram_used += size;
+    t->inVram = true;
+    t->managed = true;
+    texResidency_add(&res, &t->entry, size);
+
+    return true;
+}
+
+// glTexImage2D() on a texture handled by the manager (or glDeleteTextures())
+static void release_texture(int name)
+{
+    texture_t *t = &textures[name];
+
+    if (t->inVram)
+        vram_used -= t->entry.size;
+
+    if (t->managed)
+        texResidency_remove(&res, &t->entry);
+
+    t->managed = false;
+    t->inVram = false;
+}
+
+// glBindTexture()
+static void bind_texture(int name)
+{
+    active_texture = name;
+
+    if (textures[name].managed)
+        texResidency_use(&res, &textures[name].entry);
+}
+
+static void check_invariants(void)
+{
+    size_t resident = 0;
+    size_t in_vram = 0;
+
+    for (int i = 1; i < MAX_TEXTURES; i++)
+    {
+        texture_t *t = &textures[i];
+
+        if (!t->exists || !t->managed)
+            continue;
+
+        bool is_resident = t->entry.state == TEX_RESIDENCY_RESIDENT;
+
+        CHECK(is_resident == t->inVram, "texture %d: state %d, in VRAM %d",
+              i, t->entry.state, t->inVram);
+        CHECK(t->entry.lastUsedFrame <= res.frame, "texture %d used in the future", i);
+
+        if (is_resident)
+            resident += t->entry.size;
+        if (t->inVram)
+            in_vram += t->entry.size;
+    }
+
+    CHECK(res.residentBytes == resident, "%zu resident bytes, expected %zu",
+          res.residentBytes, resident);
+    CHECK(vram_used == in_vram + vram_other, "VRAM accounting is wrong");
+    CHECK(vram_used <= vram_size, "VRAM overflow");
+}
+
+static void check_budget(size_t extra)
+{
+    if (res.budget == 0)
+        return;
+
+    if (res.residentBytes + extra <= res.budget)
+        return;
+
+    for (int i = 1; i < MAX_TEXTURES; i++)
+        CHECK(!evictable(i), "over budget but texture %d can be evicted", i);
+}
+
+static void check_state(int name, uint8_t state)
+{
+    CHECK(textures[name].entry.state == state, "texture %d: state %d, expected %d",
+          name, textures[name].entry.state, state);
+}
+
+// Scenarios
+// ---------
+
+static void test_budget(void)
+{
+    reset(0x10000);
+
+    // Four textures that fit in the budget
+    texResidency_setBudget(&res, 4000);
+    for (int i = 1; i <= 4; i++)
+    {
+        CHECK(add_texture(i, 1000), "failed to add texture %d", i);
+        texResidency_update(&res, 0);
+    }
+    check_invariants();
+    CHECK(res.residentBytes == 4000, "%zu resident bytes", res.residentBytes);
+
+    // Use them in a different order
+    clear_log();
+    bind_texture(3);
+    bind_texture(1);
+    texResidency_update(&res, 0);
+    bind_texture(4);
+    texResidency_update(&res, 0);
+    CHECK(num_evicted == 0, "evicted textures with no pressure");
+
+    // A new texture goes over the budget. Texture 2 is the oldest one.
+    clear_log();
+    CHECK(add_texture(5, 1000), "failed to add texture 5");
+    check_invariants();
+    CHECK((num_evicted == 1) && (evicted[0] == 2), "didn't evict texture 2");
+    check_state(2, TEX_RESIDENCY_EVICTED);
+
+    // Lowering the budget evicts in LRU order: 3, 1. Texture 4 has been used
+    // in the previous frame and texture 5 is active.
+    clear_log();
+    texResidency_update(&res, 0);
+    texResidency_setBudget(&res, 2000);
+    check_invariants();
+    CHECK((num_evicted == 2) && (evicted[0] == 3) && (evicted[1] == 1),
+          "wrong eviction order");
+    CHECK(res.residentBytes == 2000, "%zu resident bytes", res.residentBytes);
+
+    // Textures used in the current frame are never evicted, even if that means
+    // going over the budget.
+    clear_log();
+    bind_texture(4);
+    texResidency_setBudget(&res, 1000);
+    check_invariants();
+    CHECK(num_evicted == 0, "evicted a texture used in this frame");
+    CHECK(res.residentBytes == 2000, "%zu resident bytes", res.residentBytes);
+    check_budget(0);
+
+    // In the next frame texture 5 isn't active anymore
+    texResidency_update(&res, 0);
+    texResidency_setBudget(&res, 1000);
+    check_invariants();
+    CHECK((num_evicted == 1) && (evicted[0] == 5), "didn't evict texture 5");
+}
+
+static void test_reload(void)
+{
+    reset(0x10000);
+
+    for (int i = 1; i <= 4; i++)
+        CHECK(add_texture(i, 1000 * i), "failed to add texture %d", i);
+    texResidency_update(&res, 0);
+
+    bind_texture(0);
+    texResidency_update(&res, 0);
+
+    // Evict everything
+    texResidency_setBudget(&res, 1);
+    check_invariants();
+    for (int i = 1; i <= 4; i++)
+        check_state(i, TEX_RESIDENCY_EVICTED);
+    CHECK(res.residentBytes == 0, "%zu resident bytes", res.residentBytes);
+
+    // Binding and prefetching make textures pending. Prefetching doesn't
+    // change the frame in which they were used.
+    uint32_t frame = textures[3].entry.lastUsedFrame;
+    texResidency_setBudget(&res, 0);
+    bind_texture(2);
+    texResidency_prefetch(&textures[3].entry);
+    texResidency_prefetch(&textures[4].entry);
+    check_state(1, TEX_RESIDENCY_EVICTED);
+    check_state(2, TEX_RESIDENCY_PENDING);
+    check_state(3, TEX_RESIDENCY_PENDING);
+    check_state(4, TEX_RESIDENCY_PENDING);
+    CHECK(textures[3].entry.lastUsedFrame == frame, "prefetch changed the frame");
+
+    // Nothing is loaded until the next update. The limit is 5000 bytes, so
+    // textures 2 and 3 are loaded, but not 4.
+    clear_log();
+    texResidency_update(&res, 5000);
+    check_invariants();
+    CHECK((num_loaded == 2) && (loaded[0] == 2) && (loaded[1] == 3),
+          "wrong textures loaded");
+    check_state(4, TEX_RESIDENCY_PENDING);
+
+    // The first texture is always loaded, even if it's bigger than the limit
+    clear_log();
+    texResidency_update(&res, 100);
+    check_invariants();
+    CHECK((num_loaded == 1) && (loaded[0] == 4), "texture 4 not loaded");
+    CHECK(res.residentBytes == 9000, "%zu resident bytes", res.residentBytes);
+
+    // Binding a resident texture doesn't make it pending
+    bind_texture(4);
+    check_state(4, TEX_RESIDENCY_RESIDENT);
+
+    // Releasing an evicted texture doesn't change the resident bytes
+    release_texture(1);
+    release_texture(4);
+    check_invariants();
+    CHECK(res.residentBytes == 5000, "%zu resident bytes", res.residentBytes);
+}
+
+static void test_vram_full(void)
+{
+    // There is only VRAM for two textures. Loading a pending texture evicts
+    // the oldest one.
+    reset(2000);
+
+    CHECK(add_texture(1, 1000), "failed to add texture 1");
+    texResidency_update(&res, 0);
+    CHECK(add_texture(2, 1000), "failed to add texture 2");
+    texResidency_update(&res, 0);
+
+    clear_log();
+    CHECK(add_texture(3, 1000), "failed to add texture 3");
+    CHECK((num_evicted == 1) && (evicted[0] == 1), "didn't evict texture 1");
+    check_invariants();
+
+    // Texture 1 is used again, and 2 is evicted to load it
+    clear_log();
+    bind_texture(1);
+    texResidency_update(&res, 0x10000);
+    check_invariants();
+    CHECK((num_evicted == 1) && (evicted[0] == 2), "didn't evict texture 2");
+    CHECK((num_loaded == 1) && (loaded[0] == 1), "didn't load texture 1");
+
+    // Textures 1 and 3 are used in this frame, so texture 2 can't be loaded.
+    // It stays pending, and the update stops there.
+    clear_log();
+    bind_texture(3);
+    bind_texture(2);
+    texResidency_prefetch(&textures[2].entry);
+    release_texture(3);
+    textures[3].exists = false;
+    vram_other = 1000;
+    vram_used += 1000;
+    bind_texture(1);
+    texResidency_update(&res, 0x10000);
+    check_invariants();
+    CHECK((num_loaded == 0) && (failed_load == 2), "texture 2 loaded");
+    check_state(2, TEX_RESIDENCY_PENDING);
+    check_state(1, TEX_RESIDENCY_RESIDENT);
+}
+
+// Random operations
+// -----------------
+
+static void fuzz(int iterations)
+{
+    reset(0x8000 + (rng() & 0x7FFF));
+
+    for (int it = 0; it < iterations; it++)
+    {
+        int name = 1 + (rng() % (MAX_TEXTURES - 1));
+        texture_t *t = &textures[name];
+
+        clear_log();
+
+        switch (rng() % 8)
+        {
+            case 0:
+            {
+                release_texture(name);
+                uint32_t size = 256 << (rng() % 6);
+                if (add_texture(name, size))
+                    check_budget(0);
+                else
+                    t->managed = false;
+                break;
+            }
+            case 1:
+                release_texture(name);
+                t->exists = false;
+                if (active_texture == name)
+                    active_texture = 0;
+                break;
+            case 2:
+            case 3:
+                if (t->exists)
+                    bind_texture(name);
+                else
+                    bind_texture(0);
+                break;
+            case 4:
+                if (t->managed)
+                    texResidency_prefetch(&t->entry);
+                break;
+            case 5:
+            {
+                size_t budget = (rng() & 1) ? 0 : (rng() % 0x10000);
+                texResidency_setBudget(&res, budget);
+                check_budget(0);
+                break;
+            }
+            default:
+            {
+                bool pending[MAX_TEXTURES];
+                for (int i = 0; i < MAX_TEXTURES; i++)
+                {
+                    pending[i] = textures[i].exists && textures[i].managed
+                                 && (textures[i].entry.state == TEX_RESIDENCY_PENDING);
+                }
+
+                size_t max_bytes = rng() % 0x4000;
+                texResidency_update(&res, max_bytes);
+
+                // Pending textures are loaded in order, with no gaps, until
+                // one fails or the limit is reached.
+                size_t total = 0;
+                int next = 1;
+                for (int i = 0; i < num_loaded; i++)
+                {
+                    int n = loaded[i];
+                    CHECK(pending[n], "texture %d wasn't pending", n);
+                    for (; next < n; next++)
+                        CHECK(!pending[next], "texture %d skipped", next);
+                    next = n + 1;
+                    total += textures[n].entry.size;
+                }
+                CHECK((num_loaded <= 1) || (total <= max_bytes),
+                      "loaded %zu bytes, limit %zu", total, max_bytes);
+                if (failed_load != 0)
+                {
+                    for (; next < failed_load; next++)
+                        CHECK(!pending[next], "texture %d skipped", next);
+                    check_state(failed_load, TEX_RESIDENCY_PENDING);
+                }
+                break;
+            }
+        }
+
+        check_invariants();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+    rng_state = (argc > 2) ? strtoul(argv[2], NULL, 0) : 12345;
+    if (rng_state == 0)
+        rng_state = 1;
+
+    test_budget();
+    test_reload();
+    test_vram_full();
+    fuzz(iterations);
+
+    printf("tex_residency_test: %d iterations OK\n", iterations);
+
+    return 0;
+}
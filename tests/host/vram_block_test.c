@@ -0,0 +1,469 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Fuzzer and benchmark of the texture and palette VRAM allocator of videoGL
+// (source/arm9/video/vram_block.c), built for the host.
+//
+// The allocator never dereferences the addresses it manages, so it is given
+// the real VRAM addresses of the DS. After every operation the internal state
+// is checked against a model of the allocations:
+//
+// - The list of blocks covers the whole area, sorted and without gaps.
+// - Two empty blocks are never next to each other.
+// - Every empty block is in the list of its size class, and only empty blocks
+//   are in those lists. The bitmap of non-empty lists is correct.
+// - The page index points to the block that holds the start of each page.
+// - Allocations don't overlap, are aligned, and avoid locked banks.
+// - If vramBlock_allocateBlock() or vramBlock_examineSpecial() fail, there was
+//   no space for the allocation.
+//
+// Usage: vram_block_test [iterations] [seed]
+//        vram_block_test --bench
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vram_block.h"
+
+// Addresses of the LCD mapping of VRAM banks A to H
+#define VRAM_A_ADDR 0x06800000u
+#define VRAM_E_ADDR 0x06880000u
+#define VRAM_F_ADDR 0x06890000u
+#define VRAM_H_ADDR 0x06898000u
+
+#define MAX_ALLOCATIONS 2048
+
+typedef struct
+{
+    uint32_t index;
+    uint32_t addr;
+    uint32_t size;
+} allocation_t;
+
+static allocation_t allocations[MAX_ALLOCATIONS];
+static int num_allocations;
+
+// Bit N set: bank N is locked (A-D for textures, E-G for palettes)
+static uint32_t locked_tex;
+static uint32_t locked_pal;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Same logic as the implementation in videoGL.c, with the lock state taken
+// from the variables of the test instead of the VRAM control registers.
+void vramBlock_getLockedBanks(uint8_t *addr, uint8_t **bankLock,
+                              uint32_t *bankSize)
+{
+    uint32_t curBank = 0;
+
+    if ((uintptr_t)addr >= VRAM_E_ADDR)
+    {
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            if (!(locked_pal & (1u << i)))
+                continue;
+
+            bankLock[curBank] = (uint8_t *)(uintptr_t)(i == 0 ? VRAM_E_ADDR
+                                            : VRAM_F_ADDR + (i - 1) * 0x4000);
+            bankSize[curBank] = (i == 0) ? 0x10000 : 0x4000;
+            curBank++;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            if (!(locked_tex & (1u << i)))
+                continue;
+
+            bankLock[curBank] = (uint8_t *)(uintptr_t)(VRAM_A_ADDR + i * 0x20000);
+            bankSize[curBank] = 0x20000;
+            curBank++;
+        }
+    }
+
+    bankLock[curBank] = NULL;
+    bankSize[curBank] = 0;
+}
+
+#define CHECK(cond, ...)                                            \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                          \
+            printf(__VA_ARGS__);                                    \
+            printf("\n");                                           \
+            exit(1);                                                \
+        }                                                           \
+    } while (0)
+
+static uint32_t addr_of(const void *p)
+{
+    return (uint32_t)(uintptr_t)p;
+}
+
+static uint32_t size_class(uint32_t size)
+{
+    uint32_t c = 31 - __builtin_clz(size);
+    return c < VRAM_BLOCK_CLASSES ? c : VRAM_BLOCK_CLASSES - 1;
+}
+
+static bool in_locked_bank(s_vramBlock *mb, uint32_t addr, uint32_t size)
+{
+    uint8_t *bankLock[5];
+    uint32_t bankSize[5];
+
+    vramBlock_getLockedBanks(mb->startAddr, bankLock, bankSize);
+
+    for (int i = 0; bankLock[i] != NULL; i++)
+    {
+        uint32_t start = addr_of(bankLock[i]);
+        if ((addr < start + bankSize[i]) && (addr + size > start))
+            return true;
+    }
+
+    return false;
+}
+
+static void check_invariants(s_vramBlock *mb)
+{
+    uint32_t start = addr_of(mb->startAddr);
+    uint32_t end = addr_of(mb->endAddr);
+
+    // Find the first block from the page index
+    struct s_SingleBlock *first = mb->pageBlocks[0];
+    CHECK(first != NULL, "no block for page 0");
+    while (first->node[0] != NULL)
+        first = first->node[0];
+
+    CHECK(addr_of(first->AddrSet) == start, "first block at 0x%08" PRIX32,
+          addr_of(first->AddrSet));
+
+    int num_empty = 0;
+    int num_used = 0;
+    uint32_t expected = start;
+    struct s_SingleBlock *prev = NULL;
+
+    for (struct s_SingleBlock *b = first; b != NULL; b = b->node[1])
+    {
+        CHECK(b->node[0] == prev, "broken back link");
+        CHECK(addr_of(b->AddrSet) == expected, "gap or overlap at 0x%08" PRIX32,
+              expected);
+        CHECK(b->blockSize > 0, "empty block struct");
+
+        if (b->indexOut == 0)
+        {
+            CHECK((prev == NULL) || (prev->indexOut != 0),
+                  "two empty blocks next to each other");
+
+            // The block must be in the list of its size class
+            bool found = false;
+            for (struct s_SingleBlock *f = mb->freeLists[size_class(b->blockSize)];
+                 f != NULL; f = f->node[3])
+            {
+                if (f == b)
+                    found = true;
+            }
+            CHECK(found, "empty block not in its size class list");
+
+            num_empty++;
+        }
+        else
+        {
+            CHECK(DynamicArrayGet(&mb->blockPtrs, b->indexOut) == b,
+                  "index %" PRIu32 " doesn't point to its block", b->indexOut);
+            num_used++;
+        }
+
+        expected += b->blockSize;
+        prev = b;
+    }
+
+    CHECK(expected == end, "blocks end at 0x%08" PRIX32, expected);
+    CHECK(num_used == num_allocations, "%d used blocks, %d allocations",
+          num_used, num_allocations);
+
+    // Free lists only hold empty blocks of the right class
+    int num_listed = 0;
+    for (uint32_t c = 0; c < VRAM_BLOCK_CLASSES; c++)
+    {
+        struct s_SingleBlock *p = NULL;
+
+        for (struct s_SingleBlock *f = mb->freeLists[c]; f != NULL; f = f->node[3])
+        {
+            CHECK(f->indexOut == 0, "used block in free list");
+            CHECK(size_class(f->blockSize) == c, "block in wrong size class");
+            CHECK(f->node[2] == p, "broken free list back link");
+            p = f;
+            num_listed++;
+        }
+
+        bool bit = (mb->freeMask >> c) & 1;
+        CHECK(bit == (mb->freeLists[c] != NULL), "wrong bit %" PRIu32 " in mask", c);
+    }
+    CHECK(num_listed == num_empty, "%d blocks in lists, %d empty blocks",
+          num_listed, num_empty);
+
+    // Page index
+    for (uint32_t i = 0; i < mb->pageCount; i++)
+    {
+        uint32_t page = start + (i << VRAM_BLOCK_PAGE_SHIFT);
+        struct s_SingleBlock *b = mb->pageBlocks[i];
+
+        CHECK((addr_of(b->AddrSet) <= page)
+              && (page < addr_of(b->AddrSet) + b->blockSize),
+              "page %" PRIu32 " points to the wrong block", i);
+    }
+}
+
+static void check_allocation(s_vramBlock *mb, uint32_t index, uint32_t size,
+                             uint8_t align)
+{
+    uint32_t addr = addr_of(vramBlock_getAddr(mb, index));
+
+    CHECK(addr != 0, "no address for index %" PRIu32, index);
+    CHECK((addr & ((1u << align) - 1)) == 0, "unaligned address");
+    CHECK((addr >= addr_of(mb->startAddr)) && (addr + size <= addr_of(mb->endAddr)),
+          "allocation out of bounds");
+    CHECK(!in_locked_bank(mb, addr, size), "allocation in a locked bank");
+    CHECK(vramBlock_getSize(mb, index) == size, "wrong size");
+
+    for (int i = 0; i < num_allocations; i++)
+    {
+        CHECK(allocations[i].index != index, "index reused while allocated");
+        CHECK((addr >= allocations[i].addr + allocations[i].size)
+              || (addr + size <= allocations[i].addr), "overlapping allocations");
+    }
+
+    CHECK(num_allocations < MAX_ALLOCATIONS, "too many allocations");
+    allocations[num_allocations++] = (allocation_t){ index, addr, size };
+}
+
+// Returns true if there is any place at or after "from" where the allocation
+// fits
+static bool allocation_fits(s_vramBlock *mb, uint32_t from, uint32_t size,
+                            uint8_t align)
+{
+    uint32_t step = 1u << align;
+
+    for (struct s_SingleBlock *b = mb->pageBlocks[0]; b != NULL; b = b->node[1])
+    {
+        if (b->indexOut != 0)
+            continue;
+
+        uint32_t bstart = addr_of(b->AddrSet);
+        uint32_t bend = bstart + b->blockSize;
+
+        if (bstart < from)
+            bstart = from;
+
+        for (uint32_t a = (bstart + step - 1) & ~(step - 1); a + size <= bend; a += step)
+        {
+            if (!in_locked_bank(mb, a, size))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static uint32_t random_size(void)
+{
+    // Mostly small textures and palettes, sometimes big ones
+    switch (rng() % 4)
+    {
+        case 0:
+            return 8 << (rng() % 5);
+        case 1:
+            return 64 << (rng() % 8);
+        case 2:
+            return (1 + rng() % 64) * 8;
+        default:
+            return (1 + rng() % 512) * 128;
+    }
+}
+
+static void fuzz(s_vramBlock *mb, uint32_t *locked, uint32_t num_banks,
+                 uint8_t align, int iterations)
+{
+    num_allocations = 0;
+    *locked = 0;
+
+    for (int it = 0; it < iterations; it++)
+    {
+        uint32_t op = rng() % 100;
+
+        if (op < 45)
+        {
+            uint32_t size = random_size();
+            uint32_t index = vramBlock_allocateBlock(mb, size, align);
+
+            if (index != 0)
+                check_allocation(mb, index, size, align);
+            else
+                CHECK(!allocation_fits(mb, 0, size, align),
+                      "allocation of %" PRIu32 " bytes failed with free space", size);
+        }
+        else if (op < 55)
+        {
+            uint32_t size = random_size();
+            uint32_t span = addr_of(mb->endAddr) - addr_of(mb->startAddr);
+            uint8_t *addr = mb->startAddr + (rng() % span);
+
+            uint8_t *found = vramBlock_examineSpecial(mb, addr, size, align);
+            if (found != NULL)
+            {
+                uint32_t index = vramBlock_allocateSpecial(mb, found, size);
+                CHECK(index != 0, "examined address can't be allocated");
+                CHECK(found >= addr, "examined address before the requested one");
+                check_allocation(mb, index, size, align);
+            }
+            else
+            {
+                CHECK(!allocation_fits(mb, addr_of(addr), size, align),
+                      "examination of %" PRIu32 " bytes failed with free space", size);
+            }
+        }
+        else if (op < 97)
+        {
+            if (num_allocations == 0)
+                continue;
+
+            int i = rng() % num_allocations;
+            CHECK(vramBlock_deallocateBlock(mb, allocations[i].index) == 1,
+                  "deallocation failed");
+            CHECK(vramBlock_getAddr(mb, allocations[i].index) == NULL,
+                  "deallocated index still has an address");
+
+            allocations[i] = allocations[--num_allocations];
+        }
+        else if (op < 99)
+        {
+            // Lock or unlock a bank. Allocations already in it are kept.
+            *locked ^= 1u << (rng() % num_banks);
+        }
+        else
+        {
+            CHECK(vramBlock_deallocateAll(mb) == 1, "deallocateAll failed");
+            num_allocations = 0;
+        }
+
+        check_invariants(mb);
+    }
+
+    // Free everything. All blocks must be merged into one.
+    while (num_allocations > 0)
+    {
+        CHECK(vramBlock_deallocateBlock(mb, allocations[0].index) == 1,
+              "deallocation failed");
+        allocations[0] = allocations[--num_allocations];
+        check_invariants(mb);
+    }
+
+    struct s_SingleBlock *b = mb->pageBlocks[0];
+    CHECK((b->node[0] == NULL) && (b->node[1] == NULL), "blocks not merged");
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(void)
+{
+    const int rounds = 200;
+    const int live = 512;
+    static uint32_t indices[512];
+
+    s_vramBlock *mb = vramBlock_Construct((uint8_t *)(uintptr_t)VRAM_A_ADDR,
+                                          (uint8_t *)(uintptr_t)VRAM_E_ADDR);
+    CHECK(mb != NULL, "vramBlock_Construct failed");
+
+    uint64_t ops = 0;
+    double start = now_seconds();
+
+    // Keep the area fragmented: fill it with small textures and replace them
+    // in random order.
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < live; i++)
+        {
+            if (indices[i] == 0)
+            {
+                indices[i] = vramBlock_allocateBlock(mb, 64 << (rng() % 6), 3);
+                ops++;
+            }
+        }
+
+        for (int i = 0; i < live / 2; i++)
+        {
+            int j = rng() % live;
+            if (indices[j] != 0)
+            {
+                vramBlock_deallocateBlock(mb, indices[j]);
+                indices[j] = 0;
+                ops++;
+            }
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+
+    printf("%" PRIu64 " operations in %.3f s (%.1f ns per operation)\n",
+           ops, elapsed, elapsed * 1e9 / ops);
+
+    vramBlock_Deconstruct(mb);
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0))
+    {
+        bench();
+        return 0;
+    }
+
+    int iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+    rng_state = (argc > 2) ? strtoul(argv[2], NULL, 0) : 12345;
+    if (rng_state == 0)
+        rng_state = 1;
+
+    // Textures: VRAM A-D, aligned to 8 bytes
+    s_vramBlock *tex = vramBlock_Construct((uint8_t *)(uintptr_t)VRAM_A_ADDR,
+                                           (uint8_t *)(uintptr_t)VRAM_E_ADDR);
+    CHECK(tex != NULL, "vramBlock_Construct failed");
+    check_invariants(tex);
+    fuzz(tex, &locked_tex, 4, 3, iterations);
+    vramBlock_Deconstruct(tex);
+
+    // Palettes: VRAM E-G, aligned to 16 bytes
+    s_vramBlock *pal = vramBlock_Construct((uint8_t *)(uintptr_t)VRAM_E_ADDR,
+                                           (uint8_t *)(uintptr_t)VRAM_H_ADDR);
+    CHECK(pal != NULL, "vramBlock_Construct failed");
+    check_invariants(pal);
+    fuzz(pal, &locked_pal, 3, 4, iterations);
+    vramBlock_Deconstruct(pal);
+
+    printf("vram_block_test: %d iterations OK\n", iterations);
+
+    return 0;
+}
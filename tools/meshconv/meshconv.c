@@ -0,0 +1,812 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Converts Wavefront OBJ models to the mesh format loaded by glMeshLoadFile()
+// and glMeshLoadMem(). See include/nds/arm9/mesh.h for a description of the
+// format.
+//
+// Vertices are quantized to v16, normals to 10-bit values and texture
+// coordinates to t16, and they are packed as geometry commands (one display
+// list per material). Textures must be converted to the DS formats beforehand
+// (with grit, for example). They are passed as binary files with the -m
+// option, with the name of the material that uses them:
+//
+//     meshconv -o ship.bin -s 0.5 -m hull:rgb256:64:64:hull.img.bin:hull.pal.bin ship.obj
+//
+// Materials without a texture are drawn with the vertex normals (or in white if
+// the model doesn't have normals).
+
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Values of the libnds headers. This tool is built for the host, so they can't
+// be included directly.
+#define MESH_VERSION        1
+
+#define CMD_COLOR           0x20
+#define CMD_NORMAL          0x21
+#define CMD_TEXCOORD        0x22
+#define CMD_VTX_16          0x23
+#define CMD_BEGIN_VTXS      0x40
+#define CMD_END_VTXS        0x41
+
+#define GL_TRIANGLES        0
+
+#define POLY_FMT_DEFAULT    ((31 << 16) | (2 << 6) | (1 << 0)) // Alpha, cull back, light 0
+#define TEX_PARAM_DEFAULT   (1 << 30) // TEXGEN_TEXCOORD
+
+typedef struct
+{
+    const char *name;
+    int type;       // GL_TEXTURE_TYPE_ENUM
+    int pal_colors; // Maximum number of colors of the palette
+} tex_format;
+
+static const tex_format tex_formats[] = {
+    { "rgb32a3", 1, 32 },
+    { "rgb4", 2, 4 },
+    { "rgb16", 3, 16 },
+    { "rgb256", 4, 256 },
+    { "compressed", 5, 32768 },
+    { "rgb8a5", 6, 8 },
+    { "rgba", 7, 0 },
+    { "rgb", 8, 0 },
+};
+
+typedef struct
+{
+    const char *material;
+    const tex_format *format;
+    int size_x, size_y;     // TEXTURE_SIZE_ENUM
+    int width, height;      // Size in texels
+    uint8_t *data;
+    size_t data_size;
+    uint8_t *palette;
+    size_t palette_size;
+    bool used;
+} texture;
+
+typedef struct
+{
+    int v, vt, vn; // Indices to the arrays of the OBJ (-1 if not present)
+} face_vertex;
+
+typedef struct
+{
+    char *name;
+    face_vertex *vertices; // Three per triangle
+    size_t num_vertices;
+    size_t capacity;
+    int texture; // Index in the textures of the output file (-1 if none)
+    uint32_t *list; // Packed display list
+    size_t list_words;
+} material;
+
+typedef struct
+{
+    float *v;
+    size_t num_v, cap_v;
+    float *vt;
+    size_t num_vt, cap_vt;
+    float *vn;
+    size_t num_vn, cap_vn;
+
+    material *materials;
+    size_t num_materials;
+} model;
+
+static texture textures[64];
+static int num_textures;
+
+static void fatal(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stderr, "meshconv: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+
+    exit(1);
+}
+
+static void *xrealloc(void *ptr, size_t size)
+{
+    ptr = realloc(ptr, size);
+    if (ptr == NULL)
+        fatal("out of memory");
+    return ptr;
+}
+
+static void push_floats(float **array, size_t *num, size_t *cap,
+                        const float *values, int count)
+{
+    if (*num + count > *cap)
+    {
+        *cap = (*cap == 0) ? 256 : *cap * 2;
+        *array = xrealloc(*array, *cap * sizeof(float));
+    }
+
+    memcpy(*array + *num, values, count * sizeof(float));
+    *num += count;
+}
+
+static uint8_t *load_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        fatal("can't open %s: %s", path, strerror(errno));
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (len <= 0)
+        fatal("%s is empty", path);
+
+    uint8_t *data = xrealloc(NULL, len);
+    if (fread(data, 1, len, f) != (size_t)len)
+        fatal("can't read %s", path);
+
+    fclose(f);
+
+    *size = len;
+    return data;
+}
+
+// Converts a size in texels to TEXTURE_SIZE_ENUM
+static int texture_size_enum(int size)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        if ((8 << i) == size)
+            return i;
+    }
+
+    return -1;
+}
+
+// Same calculation as the loader. It includes the extra data of compressed
+// textures.
+static size_t texture_data_size(const texture *tex)
+{
+    size_t texels = (size_t)tex->width * tex->height;
+
+    switch (tex->format->type)
+    {
+        case 8: // GL_RGB
+        case 7: // GL_RGBA
+            return texels * 2;
+        case 2: // GL_RGB4
+            return texels / 4;
+        case 5: // GL_COMPRESSED
+            return (texels / 4) + (texels / 8);
+        case 3: // GL_RGB16
+            return texels / 2;
+        default:
+            return texels;
+    }
+}
+
+// Parses "material:format:width:height:texture[:palette]"
+static void parse_texture_option(char *arg)
+{
+    if (num_textures == sizeof(textures) / sizeof(textures[0]))
+        fatal("too many textures");
+
+    texture *tex = &textures[num_textures++];
+    char *fields[6] = { 0 };
+    int count = 0;
+
+    for (char *tok = strtok(arg, ":"); tok != NULL; tok = strtok(NULL, ":"))
+    {
+        if (count == 6)
+            fatal("too many fields in texture option");
+        fields[count++] = tok;
+    }
+
+    if (count < 5)
+        fatal("texture option must be material:format:width:height:file[:palette]");
+
+    tex->material = fields[0];
+
+    for (size_t i = 0; i < sizeof(tex_formats) / sizeof(tex_formats[0]); i++)
+    {
+        if (strcmp(fields[1], tex_formats[i].name) == 0)
+            tex->format = &tex_formats[i];
+    }
+    if (tex->format == NULL)
+        fatal("unknown texture format: %s", fields[1]);
+
+    tex->width = atoi(fields[2]);
+    tex->height = atoi(fields[3]);
+    tex->size_x = texture_size_enum(tex->width);
+    tex->size_y = texture_size_enum(tex->height);
+    if ((tex->size_x < 0) || (tex->size_y < 0))
+        fatal("invalid texture size: %sx%s", fields[2], fields[3]);
+
+    tex->data = load_file(fields[4], &tex->data_size);
+    if (tex->data_size != texture_data_size(tex))
+    {
+        fatal("%s: expected %zu bytes for a %dx%d %s texture, found %zu",
+              fields[4], texture_data_size(tex), tex->width, tex->height,
+              tex->format->name, tex->data_size);
+    }
+
+    if (fields[5] != NULL)
+    {
+        tex->palette = load_file(fields[5], &tex->palette_size);
+        if ((tex->palette_size & 1)
+            || (tex->palette_size / 2 > (size_t)tex->format->pal_colors))
+            fatal("%s: invalid palette size for a %s texture", fields[5],
+                  tex->format->name);
+    }
+    else if (tex->format->pal_colors > 0)
+    {
+        fatal("%s textures need a palette", tex->format->name);
+    }
+}
+
+static material *find_material(model *m, const char *name)
+{
+    for (size_t i = 0; i < m->num_materials; i++)
+    {
+        if (strcmp(m->materials[i].name, name) == 0)
+            return &m->materials[i];
+    }
+
+    m->materials = xrealloc(m->materials, (m->num_materials + 1) * sizeof(material));
+
+    material *mat = &m->materials[m->num_materials++];
+    memset(mat, 0, sizeof(material));
+    mat->name = strdup(name);
+    mat->texture = -1;
+
+    return mat;
+}
+
+static void push_vertex(material *mat, face_vertex fv)
+{
+    if (mat->num_vertices == mat->capacity)
+    {
+        mat->capacity = (mat->capacity == 0) ? 256 : mat->capacity * 2;
+        mat->vertices = xrealloc(mat->vertices, mat->capacity * sizeof(face_vertex));
+    }
+
+    mat->vertices[mat->num_vertices++] = fv;
+}
+
+// Converts an OBJ index (1-based, or negative to count from the end) to a
+// 0-based index.
+static int obj_index(const char *str, size_t count, const char *path, int line)
+{
+    long index = strtol(str, NULL, 10);
+
+    if (index < 0)
+        index += count;
+    else
+        index--;
+
+    if ((index < 0) || ((size_t)index >= count))
+        fatal("%s:%d: index out of range", path, line);
+
+    return index;
+}
+
+static void load_obj(const char *path, model *m)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        fatal("can't open %s: %s", path, strerror(errno));
+
+    material *mat = NULL;
+    char line[1024];
+    int line_num = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        line_num++;
+
+        char *tok = strtok(line, " \t\r\n");
+        if ((tok == NULL) || (tok[0] == '#'))
+            continue;
+
+        if (strcmp(tok, "v") == 0)
+        {
+            float v[3] = { 0 };
+            for (int i = 0; i < 3; i++)
+            {
+                char *arg = strtok(NULL, " \t\r\n");
+                if (arg == NULL)
+                    fatal("%s:%d: invalid vertex", path, line_num);
+                v[i] = strtof(arg, NULL);
+            }
+            push_floats(&m->v, &m->num_v, &m->cap_v, v, 3);
+        }
+        else if (strcmp(tok, "vt") == 0)
+        {
+            float vt[2] = { 0 };
+            for (int i = 0; i < 2; i++)
+            {
+                char *arg = strtok(NULL, " \t\r\n");
+                if (arg == NULL)
+                    fatal("%s:%d: invalid texture coordinate", path, line_num);
+                vt[i] = strtof(arg, NULL);
+            }
+            push_floats(&m->vt, &m->num_vt, &m->cap_vt, vt, 2);
+        }
+        else if (strcmp(tok, "vn") == 0)
+        {
+            float vn[3] = { 0 };
+            for (int i = 0; i < 3; i++)
+            {
+                char *arg = strtok(NULL, " \t\r\n");
+                if (arg == NULL)
+                    fatal("%s:%d: invalid normal", path, line_num);
+                vn[i] = strtof(arg, NULL);
+            }
+            push_floats(&m->vn, &m->num_vn, &m->cap_vn, vn, 3);
+        }
+        else if (strcmp(tok, "usemtl") == 0)
+        {
+            char *name = strtok(NULL, " \t\r\n");
+            if (name == NULL)
+                fatal("%s:%d: usemtl without a name", path, line_num);
+            mat = find_material(m, name);
+        }
+        else if (strcmp(tok, "f") == 0)
+        {
+            face_vertex fv[64];
+            int count = 0;
+
+            for (char *arg = strtok(NULL, " \t\r\n"); arg != NULL;
+                 arg = strtok(NULL, " \t\r\n"))
+            {
+                if (count == 64)
+                    fatal("%s:%d: face with too many vertices", path, line_num);
+
+                // v, v/vt, v//vn or v/vt/vn
+                char *slash1 = strchr(arg, '/');
+                char *slash2 = (slash1 != NULL) ? strchr(slash1 + 1, '/') : NULL;
+
+                fv[count].v = obj_index(arg, m->num_v / 3, path, line_num);
+                fv[count].vt = -1;
+                fv[count].vn = -1;
+
+                if ((slash1 != NULL) && (slash1[1] != '/') && (slash1[1] != '\0'))
+                    fv[count].vt = obj_index(slash1 + 1, m->num_vt / 2, path, line_num);
+                if ((slash2 != NULL) && (slash2[1] != '\0'))
+                    fv[count].vn = obj_index(slash2 + 1, m->num_vn / 3, path, line_num);
+
+                count++;
+            }
+
+            if (count < 3)
+                fatal("%s:%d: face with less than 3 vertices", path, line_num);
+
+            if (mat == NULL)
+                mat = find_material(m, "default");
+
+            // Split polygons in triangles as a fan
+            for (int i = 1; i < count - 1; i++)
+            {
+                push_vertex(mat, fv[0]);
+                push_vertex(mat, fv[i]);
+                push_vertex(mat, fv[i + 1]);
+            }
+        }
+
+        // Other statements (o, g, s, mtllib...) are ignored
+    }
+
+    fclose(f);
+}
+
+static int16_t to_v16(float value, float scale)
+{
+    long v = lroundf(value * scale * (1 << 12));
+
+    if ((v < INT16_MIN) || (v > INT16_MAX))
+        fatal("vertex out of range (%f), use a smaller scale with -s", value);
+
+    return v;
+}
+
+static uint32_t to_normal(const float *n)
+{
+    uint32_t packed = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        long v = lroundf(n[i] * (1 << 9));
+
+        if (v > 511)
+            v = 511;
+        if (v < -512)
+            v = -512;
+
+        packed |= ((uint32_t)v & 0x3FF) << (i * 10);
+    }
+
+    return packed;
+}
+
+static uint32_t to_texcoord(const float *vt, const texture *tex)
+{
+    // In OBJ files V goes up, in the DS T goes down
+    long u = lroundf(vt[0] * tex->width * 16);
+    long v = lroundf((1.0f - vt[1]) * tex->height * 16);
+
+    if ((u < INT16_MIN) || (u > INT16_MAX) || (v < INT16_MIN) || (v > INT16_MAX))
+        fatal("texture coordinate out of range");
+
+    return ((uint32_t)u & 0xFFFF) | ((uint32_t)v << 16);
+}
+
+typedef struct
+{
+    uint32_t *data;
+    size_t size;
+    size_t capacity;
+    size_t header;
+    int commands;
+} list_writer;
+
+static void list_push_word(list_writer *w, uint32_t word)
+{
+    if (w->size == w->capacity)
+    {
+        w->capacity = (w->capacity == 0) ? 256 : w->capacity * 2;
+        w->data = xrealloc(w->data, w->capacity * sizeof(uint32_t));
+    }
+
+    w->data[w->size++] = word;
+}
+
+// Packs commands like glListCommand(): up to 4 commands per header word,
+// followed by their parameters.
+static void list_command(list_writer *w, uint8_t command, const uint32_t *params,
+                         int num_params)
+{
+    if (w->commands == 4)
+    {
+        w->header = w->size;
+        list_push_word(w, 0);
+        w->commands = 0;
+    }
+
+    w->data[w->header] |= (uint32_t)command << (w->commands * 8);
+    w->commands++;
+
+    for (int i = 0; i < num_params; i++)
+        list_push_word(w, params[i]);
+}
+
+static void build_list(const model *m, material *mat, float scale)
+{
+    list_writer w = { .commands = 4 };
+    const texture *tex = (mat->texture >= 0) ? &textures[mat->texture] : NULL;
+
+    // Size word, filled at the end
+    list_push_word(&w, 0);
+
+    uint32_t param = GL_TRIANGLES;
+    list_command(&w, CMD_BEGIN_VTXS, &param, 1);
+
+    bool has_normals = (mat->num_vertices > 0) && (mat->vertices[0].vn >= 0);
+    if (!has_normals)
+    {
+        uint32_t white = 0x7FFF;
+        list_command(&w, CMD_COLOR, &white, 1);
+    }
+
+    uint32_t last_normal = 0, last_texcoord = 0;
+    bool first = true;
+
+    for (size_t i = 0; i < mat->num_vertices; i++)
+    {
+        const face_vertex *fv = &mat->vertices[i];
+
+        if ((tex != NULL) && (fv->vt >= 0))
+        {
+            uint32_t texcoord = to_texcoord(&m->vt[fv->vt * 2], tex);
+            if (first || (texcoord != last_texcoord))
+                list_command(&w, CMD_TEXCOORD, &texcoord, 1);
+            last_texcoord = texcoord;
+        }
+
+        if (has_normals && (fv->vn >= 0))
+        {
+            uint32_t normal = to_normal(&m->vn[fv->vn * 3]);
+            if (first || (normal != last_normal))
+                list_command(&w, CMD_NORMAL, &normal, 1);
+            last_normal = normal;
+        }
+
+        const float *v = &m->v[fv->v * 3];
+        uint16_t x = to_v16(v[0], scale);
+        uint16_t y = to_v16(v[1], scale);
+        uint16_t z = to_v16(v[2], scale);
+        uint32_t params[2] = { x | ((uint32_t)y << 16), z };
+        list_command(&w, CMD_VTX_16, params, 2);
+
+        first = false;
+    }
+
+    list_command(&w, CMD_END_VTXS, NULL, 0);
+
+    w.data[0] = w.size - 1;
+
+    mat->list = w.data;
+    mat->list_words = w.size;
+}
+
+static void write_u8(FILE *f, uint8_t value)
+{
+    fputc(value, f);
+}
+
+static void write_u16(FILE *f, uint16_t value)
+{
+    write_u8(f, value & 0xFF);
+    write_u8(f, value >> 8);
+}
+
+static void write_u32(FILE *f, uint32_t value)
+{
+    write_u16(f, value & 0xFFFF);
+    write_u16(f, value >> 16);
+}
+
+static void write_id(FILE *f, const char *id)
+{
+    fwrite(id, 1, 4, f);
+}
+
+static void write_padding(FILE *f, size_t size)
+{
+    for (; size & 3; size++)
+        write_u8(f, 0);
+}
+
+static size_t align4(size_t size)
+{
+    return (size + 3) & ~3;
+}
+
+static void usage(void)
+{
+    printf("Usage: meshconv [options] model.obj\n"
+           "\n"
+           "Options:\n"
+           "  -o FILE     Output file (default: mesh.bin)\n"
+           "  -s SCALE    Scale applied to the vertices (default: 1)\n"
+           "  -f POLYFMT  Polygon format of all materials (default: 0x%X)\n"
+           "  -p PARAM    Parameters of glTexImage2D() for all textures (default: 0x%X)\n"
+           "  -m MATERIAL:FORMAT:WIDTH:HEIGHT:TEXTURE[:PALETTE]\n"
+           "              Texture of a material. FORMAT is one of rgb32a3, rgb4,\n"
+           "              rgb16, rgb256, compressed, rgb8a5, rgba or rgb. TEXTURE\n"
+           "              and PALETTE are binary files in the format of the DS.\n"
+           "  -h          Show this message\n",
+           POLY_FMT_DEFAULT, TEX_PARAM_DEFAULT);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *in_path = NULL;
+    const char *out_path = "mesh.bin";
+    float scale = 1.0f;
+    uint32_t poly_fmt = POLY_FMT_DEFAULT;
+    uint32_t tex_param = TEX_PARAM_DEFAULT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "-h") == 0)
+        {
+            usage();
+            return 0;
+        }
+
+        if ((arg[0] == '-') && (arg[1] != '\0') && (arg[2] == '\0'))
+        {
+            if (i + 1 == argc)
+                fatal("missing argument of %s", arg);
+
+            char *value = argv[++i];
+
+            switch (arg[1])
+            {
+                case 'o':
+                    out_path = value;
+                    break;
+                case 's':
+                    scale = strtof(value, NULL);
+                    break;
+                case 'f':
+                    poly_fmt = strtoul(value, NULL, 0);
+                    break;
+                case 'p':
+                    tex_param = strtoul(value, NULL, 0);
+                    break;
+                case 'm':
+                    parse_texture_option(value);
+                    break;
+                default:
+                    fatal("unknown option: %s", arg);
+            }
+        }
+        else
+        {
+            if (in_path != NULL)
+                fatal("only one input file is supported");
+            in_path = arg;
+        }
+    }
+
+    if (in_path == NULL)
+    {
+        usage();
+        return 1;
+    }
+
+    model m = { 0 };
+    load_obj(in_path, &m);
+
+    if (m.num_materials == 0)
+        fatal("%s doesn't have any face", in_path);
+    if (m.num_materials > UINT16_MAX)
+        fatal("too many materials");
+
+    // Textures are stored in the order in which their materials are used
+    int out_textures[64];
+    int num_out_textures = 0;
+
+    for (size_t i = 0; i < m.num_materials; i++)
+    {
+        material *mat = &m.materials[i];
+
+        for (int t = 0; t < num_textures; t++)
+        {
+            if (strcmp(textures[t].material, mat->name) == 0)
+            {
+                mat->texture = num_out_textures;
+                out_textures[num_out_textures++] = t;
+                textures[t].used = true;
+                break;
+            }
+        }
+    }
+
+    for (int t = 0; t < num_textures; t++)
+    {
+        if (!textures[t].used)
+            fatal("material not found in the model: %s", textures[t].material);
+    }
+
+    // Material indices point to the textures of the output file, but the
+    // texture data is in the order of the command line.
+    for (size_t i = 0; i < m.num_materials; i++)
+    {
+        material *mat = &m.materials[i];
+        int index = mat->texture;
+
+        if (index >= 0)
+            mat->texture = out_textures[index];
+
+        build_list(&m, mat, scale);
+
+        mat->texture = index;
+    }
+
+    // Bounding box
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+    for (size_t i = 0; i < m.num_v; i++)
+    {
+        int axis = i % 3;
+        if (m.v[i] < min[axis])
+            min[axis] = m.v[i];
+        if (m.v[i] > max[axis])
+            max[axis] = m.v[i];
+    }
+
+    // Calculate the size of all chunks
+    size_t hdrx_size = 20;
+    size_t mtrl_size = m.num_materials * 12;
+    size_t dlst_size = 0;
+
+    for (size_t i = 0; i < m.num_materials; i++)
+        dlst_size += m.materials[i].list_words * 4;
+
+    size_t nmsh_size = 8 + hdrx_size + 8 + mtrl_size + 8 + dlst_size;
+
+    for (int i = 0; i < num_out_textures; i++)
+    {
+        const texture *tex = &textures[out_textures[i]];
+        nmsh_size += 8 + align4(16 + tex->data_size + tex->palette_size);
+    }
+
+    FILE *f = fopen(out_path, "wb");
+    if (f == NULL)
+        fatal("can't open %s: %s", out_path, strerror(errno));
+
+    write_id(f, "RIFF");
+    write_u32(f, nmsh_size + 8);
+    write_id(f, "NMSH");
+    write_u32(f, nmsh_size);
+
+    write_id(f, "HDRX");
+    write_u32(f, hdrx_size);
+    write_u16(f, MESH_VERSION);
+    write_u16(f, m.num_materials);
+    write_u16(f, num_out_textures);
+    write_u16(f, 0);
+    for (int i = 0; i < 3; i++)
+        write_u16(f, to_v16(min[i], scale));
+    for (int i = 0; i < 3; i++)
+        write_u16(f, to_v16(max[i] - min[i], scale));
+
+    for (int i = 0; i < num_out_textures; i++)
+    {
+        const texture *tex = &textures[out_textures[i]];
+        size_t size = 16 + tex->data_size + tex->palette_size;
+
+        write_id(f, "TEX ");
+        write_u32(f, align4(size));
+        write_u8(f, tex->format->type);
+        write_u8(f, tex->size_x);
+        write_u8(f, tex->size_y);
+        write_u8(f, 0);
+        write_u32(f, tex_param);
+        write_u32(f, tex->data_size);
+        write_u16(f, tex->palette_size / 2);
+        write_u16(f, 0);
+        fwrite(tex->data, 1, tex->data_size, f);
+        if (tex->palette_size > 0)
+            fwrite(tex->palette, 1, tex->palette_size, f);
+        write_padding(f, size);
+    }
+
+    write_id(f, "MTRL");
+    write_u32(f, mtrl_size);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < m.num_materials; i++)
+    {
+        const material *mat = &m.materials[i];
+
+        write_u32(f, poly_fmt);
+        write_u16(f, mat->texture);
+        write_u16(f, 0);
+        write_u32(f, offset);
+
+        offset += mat->list_words;
+    }
+
+    write_id(f, "DLST");
+    write_u32(f, dlst_size);
+
+    for (size_t i = 0; i < m.num_materials; i++)
+    {
+        const material *mat = &m.materials[i];
+
+        for (size_t w = 0; w < mat->list_words; w++)
+            write_u32(f, mat->list[w]);
+    }
+
+    if (fclose(f) != 0)
+        fatal("can't write %s", out_path);
+
+    return 0;
+}